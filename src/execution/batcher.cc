@@ -0,0 +1,169 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "batcher.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "thunk/ggutils.hh"
+#include "util/iterator.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg::thunk;
+
+/* the distinct inputs of a thunk, its executables included */
+static vector<string> input_hashes( const Thunk & thunk )
+{
+  vector<string> hashes;
+  unordered_set<string> seen;
+
+  for ( const auto & item : join_containers( thunk.values(), thunk.executables() ) ) {
+    if ( seen.insert( item.first ).second ) {
+      hashes.push_back( item.first );
+    }
+  }
+
+  return hashes;
+}
+
+size_t ThunkBatcher::Batch::added_bytes( const vector<string> & hashes ) const
+{
+  size_t total = 0;
+
+  for ( const string & hash : hashes ) {
+    if ( inputs.count( hash ) == 0 ) {
+      total += gg::hash::size( hash );
+    }
+  }
+
+  return total;
+}
+
+void ThunkBatcher::set_limits( const BatchLimits & limits )
+{
+  if ( limits.max_thunks == 0 ) {
+    throw runtime_error( "batch size cannot be zero" );
+  }
+
+  /* otherwise, a batch that doesn't fill up would wait forever */
+  if ( limits.max_thunks > 1 and limits.linger <= 0ms ) {
+    throw runtime_error( "batching needs a linger time" );
+  }
+
+  limits_ = limits;
+}
+
+void ThunkBatcher::send( const string & key, ExecutionLoop & exec_loop )
+{
+  auto batch = open_batches_.find( key );
+  vector<Thunk> thunks = move( batch->second.thunks );
+  open_batches_.erase( batch );
+
+  send_callback_( move( thunks ), exec_loop );
+}
+
+bool ThunkBatcher::fits( const Batch & batch, const Thunk & thunk ) const
+{
+  if ( not fits_callback_ ) {
+    return true;
+  }
+
+  vector<Thunk> thunks { batch.thunks };
+  thunks.push_back( thunk );
+  return fits_callback_( thunks );
+}
+
+void ThunkBatcher::add( const Thunk & thunk, ExecutionLoop & exec_loop )
+{
+  if ( limits_.max_thunks == 1 ) {
+    send_callback_( { thunk }, exec_loop );
+    return;
+  }
+
+  const string key = thunk.executable_hash();
+  const vector<string> inputs = input_hashes( thunk );
+
+  auto batch = open_batches_.find( key );
+
+  if ( batch != open_batches_.end() and
+       any_of( batch->second.thunks.begin(), batch->second.thunks.end(),
+               [&thunk] ( const Thunk & other ) { return other.hash() == thunk.hash(); } ) ) {
+    return; /* a duplicate of a thunk that wasn't even sent yet */
+  }
+
+  /* a thunk that doesn't fit in the open batch starts a new one */
+  if ( batch != open_batches_.end() and
+       ( ( limits_.max_bytes > 0 and
+           batch->second.bytes + batch->second.added_bytes( inputs ) > limits_.max_bytes )
+         or not fits( batch->second, thunk ) ) ) {
+    send( key, exec_loop );
+    batch = open_batches_.end();
+  }
+
+  if ( batch == open_batches_.end() ) {
+    const uint64_t batch_id = next_batch_id_++;
+    batch = open_batches_.emplace( key, Batch { batch_id } ).first;
+
+    exec_loop.add_timer( limits_.linger,
+      [this, key, batch_id, &exec_loop] ()
+      {
+        auto batch = open_batches_.find( key );
+
+        /* unless it was sent already */
+        if ( batch != open_batches_.end() and batch->second.id == batch_id ) {
+          send( key, exec_loop );
+        }
+      } );
+  }
+
+  batch->second.thunks.push_back( thunk );
+  batch->second.bytes += batch->second.added_bytes( inputs );
+
+  for ( const string & hash : inputs ) {
+    batch->second.inputs[ hash ]++;
+  }
+
+  if ( batch->second.thunks.size() >= limits_.max_thunks or
+       ( limits_.max_bytes > 0 and batch->second.bytes >= limits_.max_bytes ) ) {
+    send( key, exec_loop );
+  }
+}
+
+size_t ThunkBatcher::remove( const string & thunk_hash )
+{
+  size_t count = 0;
+
+  for ( auto it = open_batches_.begin(); it != open_batches_.end(); ) {
+    Batch & batch = it->second;
+
+    auto removed = remove_if( batch.thunks.begin(), batch.thunks.end(),
+                              [&thunk_hash] ( const Thunk & thunk )
+                              { return thunk.hash() == thunk_hash; } );
+
+    for ( auto thunk = removed; thunk != batch.thunks.end(); thunk++ ) {
+      for ( const string & hash : input_hashes( *thunk ) ) {
+        auto input = batch.inputs.find( hash );
+
+        if ( --input->second == 0 ) {
+          batch.bytes -= gg::hash::size( hash );
+          batch.inputs.erase( input );
+        }
+      }
+
+      count++;
+    }
+
+    batch.thunks.erase( removed, batch.thunks.end() );
+
+    if ( batch.thunks.empty() ) {
+      it = open_batches_.erase( it );
+    }
+    else {
+      it++;
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,80 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BATCHER_HH
+#define BATCHER_HH
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+
+#include "loop.hh"
+#include "thunk/thunk.hh"
+
+struct BatchLimits
+{
+  size_t max_thunks { 1 };
+  size_t max_bytes { 0 }; /* of the distinct inputs of the thunks; 0 means no limit */
+  std::chrono::milliseconds linger { 0 };
+};
+
+/* Groups the thunks forced on a remote engine into batches that share the
+   same executables, so that a single invocation can run all of them. A batch
+   is sent once it's full, or once its first thunk has waited for the linger
+   time, or once the next thunk wouldn't fit in it. With the default limits,
+   every thunk is sent right away. */
+class ThunkBatcher
+{
+public:
+  typedef std::function<void( std::vector<gg::thunk::Thunk> &&,
+                              ExecutionLoop & )> SendCallbackFunc;
+
+  /* whether the engine can run the thunks as one invocation */
+  typedef std::function<bool( const std::vector<gg::thunk::Thunk> & )> FitsCallbackFunc;
+
+private:
+  struct Batch
+  {
+    uint64_t id;
+    std::vector<gg::thunk::Thunk> thunks {};
+    size_t bytes { 0 };
+
+    /* the number of thunks that need each input; the thunks of a batch
+       share their executables, which are only sent once */
+    std::unordered_map<std::string, size_t> inputs {};
+
+    size_t added_bytes( const std::vector<std::string> & hashes ) const;
+
+    Batch( const uint64_t id ) : id( id ) {}
+  };
+
+  BatchLimits limits_ {};
+  SendCallbackFunc send_callback_;
+  FitsCallbackFunc fits_callback_;
+
+  uint64_t next_batch_id_ { 0 };
+
+  /* the batches that are still open, by the hash of their executables */
+  std::unordered_map<std::string, Batch> open_batches_ {};
+
+  void send( const std::string & key, ExecutionLoop & exec_loop );
+  bool fits( const Batch & batch, const gg::thunk::Thunk & thunk ) const;
+
+public:
+  ThunkBatcher( SendCallbackFunc send_callback,
+                FitsCallbackFunc fits_callback = {} )
+    : send_callback_( send_callback ), fits_callback_( fits_callback )
+  {}
+
+  void set_limits( const BatchLimits & limits );
+  const BatchLimits & limits() const { return limits_; }
+
+  void add( const gg::thunk::Thunk & thunk, ExecutionLoop & exec_loop );
+
+  /* takes the thunk out of the open batches; returns the number of copies
+     that were removed */
+  size_t remove( const std::string & thunk_hash );
+};
+
+#endif /* BATCHER_HH */
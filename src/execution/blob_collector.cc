@@ -0,0 +1,39 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "blob_collector.hh"
+
+#include <cstdlib>
+
+#include "thunk/blob_gc.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+BlobCollector::BlobCollector( ExecutionLoop & loop, const uint64_t budget,
+                              const milliseconds & interval )
+  : loop_( loop ), budget_( budget ), interval_( interval )
+{
+  schedule();
+}
+
+void BlobCollector::schedule()
+{
+  loop_.add_timer( interval_,
+    [this] ()
+    {
+      loop_.add_child_process( "blob-gc",
+        [this] ( const uint64_t, const string &, const int ) { schedule(); },
+        [budget=budget_] ()
+        {
+          gg::blobs::collect( budget, {}, gg::blobs::in_use_window );
+          return 0;
+        },
+        false );
+    } );
+}
+
+uint64_t BlobCollector::worker_budget()
+{
+  setenv( "GG_BLOB_BUDGET", DEFAULT_WORKER_BLOB_BUDGET, false );
+  return *gg::blobs::budget();
+}
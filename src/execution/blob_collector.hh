@@ -0,0 +1,40 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BLOB_COLLECTOR_HH
+#define BLOB_COLLECTOR_HH
+
+#include <chrono>
+#include <cstdint>
+
+#include "loop.hh"
+
+/* how often a worker's blobs are trimmed down to the budget */
+static constexpr std::chrono::milliseconds BLOB_COLLECTION_INTERVAL { 60 * 1000 };
+
+/* the budget that a worker uses if GG_BLOB_BUDGET isn't set */
+static constexpr const char * DEFAULT_WORKER_BLOB_BUDGET = "4G";
+
+/* Keeps the blobs of a long-running worker within a budget, so that the hot
+   ones (e.g. the toolchain) stay around between thunks, instead of being
+   fetched again for each one. Every so often, the least recently used blobs
+   are removed by a child process, which keeps the loop going in the meantime
+   and leaves the worker free to fork. */
+class BlobCollector
+{
+private:
+  ExecutionLoop & loop_;
+  const uint64_t budget_;
+  const std::chrono::milliseconds interval_;
+
+  void schedule();
+
+public:
+  BlobCollector( ExecutionLoop & loop, const uint64_t budget,
+                 const std::chrono::milliseconds & interval = BLOB_COLLECTION_INTERVAL );
+
+  /* GG_BLOB_BUDGET, after setting it to the default if it's not set, so that
+     the processes the worker starts use the same budget */
+  static uint64_t worker_budget();
+};
+
+#endif /* BLOB_COLLECTOR_HH */
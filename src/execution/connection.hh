@@ -9,6 +9,7 @@
 
 #include "net/socket.hh"
 #include "net/nb_secure_socket.hh"
+#include "util/file_descriptor.hh"
 
 class ExecutionLoop;
 
@@ -21,6 +22,9 @@ private:
   SocketType socket_ {};
   std::string write_buffer_ {};
 
+  /* set to close the connection on the next loop iteration */
+  bool cancelled_ { false };
+
 public:
   Connection() {}
 
@@ -43,5 +47,6 @@ public:
 
 using TCPConnection = Connection<TCPSocket>;
 using SSLConnection = Connection<NBSecureSocket>;
+using IPCConnection = Connection<FileDescriptor>;
 
 #endif /* CONNECTION_HH */
@@ -0,0 +1,139 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "downloader.hh"
+
+#include "thunk/ggutils.hh"
+#include "util/path.hh"
+#include "util/pipe.hh"
+
+using namespace std;
+
+OutputDownloader::OutputDownloader( StorageBackend & backend,
+                                    ExecutionLoop & exec_loop )
+  : OutputDownloader( backend, exec_loop, make_pipe() )
+{}
+
+OutputDownloader::OutputDownloader( StorageBackend & backend,
+                                    ExecutionLoop & exec_loop,
+                                    pair<FileDescriptor, FileDescriptor> && pipe )
+  : backend_( backend ), notify_fd_( move( pipe.second ) )
+{
+  exec_loop.add_connection<FileDescriptor>(
+    move( pipe.first ),
+    [this] ( shared_ptr<IPCConnection>, string && data )
+    {
+      process_notifications( move( data ) );
+      return true;
+    },
+    [] () { throw runtime_error( "error reading download notifications" ); } );
+
+  thread_ = thread( &OutputDownloader::download_loop, this );
+}
+
+OutputDownloader::~OutputDownloader()
+{
+  {
+    unique_lock<mutex> lock { mutex_ };
+    stopping_ = true;
+  }
+
+  queue_changed_.notify_all();
+
+  if ( thread_.joinable() ) {
+    thread_.join();
+  }
+}
+
+void OutputDownloader::add( const vector<string> & hashes,
+                            const DoneCallbackFunc & done_callback,
+                            const ErrorCallbackFunc & error_callback )
+{
+  const uint64_t id = next_id_++;
+  callbacks_.emplace( id, Callbacks { done_callback, error_callback } );
+
+  {
+    unique_lock<mutex> lock { mutex_ };
+    queue_.push_back( { id, hashes } );
+  }
+
+  queue_changed_.notify_all();
+}
+
+void OutputDownloader::download_loop()
+{
+  while ( true ) {
+    Download download;
+
+    {
+      unique_lock<mutex> lock { mutex_ };
+
+      queue_changed_.wait( lock,
+        [this] { return stopping_ or not queue_.empty(); } );
+
+      if ( stopping_ ) {
+        return;
+      }
+
+      download = move( queue_.front() );
+      queue_.pop_front();
+    }
+
+    vector<storage::GetRequest> requests;
+
+    for ( const string & hash : download.hashes ) {
+      if ( not roost::exists( gg::paths::blob( hash ) ) ) {
+        requests.push_back( { hash, gg::paths::blob( hash ) } );
+      }
+    }
+
+    try {
+      if ( not requests.empty() ) {
+        backend_.get( requests );
+      }
+    }
+    catch ( const exception & e ) {
+      unique_lock<mutex> lock { mutex_ };
+      errors_.emplace( download.id, e.what() );
+    }
+
+    notify_fd_.write( to_string( download.id ) + "\n" );
+  }
+}
+
+void OutputDownloader::process_notifications( string && data )
+{
+  notifications_.append( data );
+
+  size_t line_start = 0;
+  size_t line_end;
+
+  while ( ( line_end = notifications_.find( '\n', line_start ) ) != string::npos ) {
+    const uint64_t id = stoull( notifications_.substr( line_start, line_end - line_start ) );
+    line_start = line_end + 1;
+
+    auto callbacks = callbacks_.find( id );
+    const Callbacks current { move( callbacks->second ) };
+    callbacks_.erase( callbacks );
+
+    Optional<string> error;
+
+    {
+      unique_lock<mutex> lock { mutex_ };
+      auto entry = errors_.find( id );
+
+      if ( entry != errors_.end() ) {
+        error.reset( move( entry->second ) );
+        errors_.erase( entry );
+      }
+    }
+
+    if ( error.initialized() ) {
+      current.error( *error );
+    }
+    else {
+      current.done();
+    }
+  }
+
+  notifications_.erase( 0, line_start );
+}
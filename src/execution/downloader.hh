@@ -0,0 +1,86 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef DOWNLOADER_HH
+#define DOWNLOADER_HH
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "loop.hh"
+#include "storage/backend.hh"
+#include "util/file_descriptor.hh"
+#include "util/optional.hh"
+
+/* Downloads the outputs of finished requests from the storage backend on a
+   background thread, so the execution loop keeps dispatching jobs while
+   they come in. Each set of objects is reported through a pipe once all of
+   them are in the blobs directory, like for the DependencyUploader, so the
+   callbacks are always called on the loop's thread. */
+class OutputDownloader
+{
+public:
+  typedef std::function<void()> DoneCallbackFunc;
+  typedef std::function<void( const std::string & /* error */ )> ErrorCallbackFunc;
+
+private:
+  struct Download
+  {
+    uint64_t id { 0 };
+    std::vector<std::string> hashes {};
+  };
+
+  struct Callbacks
+  {
+    DoneCallbackFunc done;
+    ErrorCallbackFunc error;
+  };
+
+  StorageBackend & backend_;
+
+  /* touched only by the loop's thread */
+  uint64_t next_id_ { 0 };
+  std::unordered_map<uint64_t, Callbacks> callbacks_ {};
+  std::string notifications_ {};
+
+  /* shared with the download thread */
+  std::mutex mutex_ {};
+  std::condition_variable queue_changed_ {};
+  std::deque<Download> queue_ {};
+  std::unordered_map<uint64_t, std::string> errors_ {};
+  bool stopping_ { false };
+
+  FileDescriptor notify_fd_;
+
+  std::thread thread_ {};
+
+  OutputDownloader( StorageBackend & backend, ExecutionLoop & exec_loop,
+                    std::pair<FileDescriptor, FileDescriptor> && pipe );
+
+  void download_loop();
+  void process_notifications( std::string && data );
+
+public:
+  OutputDownloader( StorageBackend & backend, ExecutionLoop & exec_loop );
+  ~OutputDownloader();
+
+  /* downloads the objects that aren't in the blobs directory yet, and then
+     calls one of the callbacks */
+  void add( const std::vector<std::string> & hashes,
+            const DoneCallbackFunc & done_callback,
+            const ErrorCallbackFunc & error_callback );
+
+  size_t pending_count() const { return callbacks_.size(); }
+
+  /* forbid copying */
+  OutputDownloader( const OutputDownloader & other ) = delete;
+  OutputDownloader & operator=( const OutputDownloader & other ) = delete;
+};
+
+#endif /* DOWNLOADER_HH */
@@ -0,0 +1,108 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "engine.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+
+#include "thunk/ggutils.hh"
+#include "util/base64.hh"
+#include "util/path.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+void ExecutionEngine::report_response( const uint64_t id,
+                                       const vector<string> & thunk_hashes,
+                                       ExecutionResponse && response,
+                                       const float cost )
+{
+  /* print the output, if there's any */
+  if ( response.stdout.length() ) {
+    cerr << response.stdout << endl;
+  }
+
+  if ( response.status != JobStatus::Success ) {
+    report_failure( id, thunk_hashes, response.status );
+    return;
+  }
+
+  for ( auto & executed : response.executed_thunks ) {
+    if ( find( thunk_hashes.begin(), thunk_hashes.end(),
+               executed.thunk_hash ) == thunk_hashes.end() ) {
+      throw runtime_error( "got output for " + executed.thunk_hash +
+                           ", which was not sent" );
+    }
+  }
+
+  for ( auto & executed : response.executed_thunks ) {
+    if ( not copy_finished( executed.thunk_hash, id ) ) {
+      continue; /* cancelled, or reported already */
+    }
+
+    for ( const auto & output : executed.outputs ) {
+      gg::cache::insert( gg::hash::for_output( executed.thunk_hash, output.tag ), output.hash );
+
+      if ( output.data.length() ) {
+        roost::atomic_create( base64::decode( output.data ),
+                              gg::paths::blob( output.hash ) );
+      }
+    }
+
+    gg::cache::insert( executed.thunk_hash, executed.outputs.at( 0 ).hash );
+
+    vector<ThunkOutput> thunk_outputs;
+    for ( auto & output : executed.outputs ) {
+      thunk_outputs.emplace_back( move( output.hash ), move( output.tag ) );
+    }
+
+    /* the thunks in a batch share the cost of the invocation */
+    success_callback_( executed.thunk_hash, move( thunk_outputs ),
+                       cost / thunk_hashes.size() );
+  }
+
+  /* the ones that the response left out */
+  report_failure( id, thunk_hashes, JobStatus::OperationalFailure );
+}
+
+bool ExecutionEngine::can_execute_chain( const vector<Thunk> & chain ) const
+{
+  vector<Thunk::DataItem> values;
+  vector<Thunk::DataItem> executables;
+  unordered_set<string> seen;
+
+  for ( const Thunk & thunk : chain ) {
+    for ( const auto & item : thunk.values() ) {
+      if ( seen.insert( item.first ).second ) { values.push_back( item ); }
+    }
+
+    for ( const auto & item : thunk.executables() ) {
+      if ( seen.insert( item.first ).second ) { executables.push_back( item ); }
+    }
+  }
+
+  /* the engines' limits are on the inputs of a thunk, so the chain is
+     checked as one thunk with all of its inputs */
+  const Thunk & first = chain.front();
+
+  return can_execute( Thunk { Function { first.function() }, move( values ), {},
+                              move( executables ), vector<string> { first.outputs() } } );
+}
+
+void ExecutionEngine::force_chain( const vector<Thunk> &, ExecutionLoop & )
+{
+  throw runtime_error( "the " + label() + " engine cannot run chains" );
+}
+
+void ExecutionEngine::report_failure( const uint64_t id,
+                                      const vector<string> & thunk_hashes,
+                                      const JobStatus status )
+{
+  for ( const string & hash : thunk_hashes ) {
+    if ( copy_finished( hash, id ) ) {
+      failure_callback_( hash, status );
+    }
+  }
+}
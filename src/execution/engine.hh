@@ -6,6 +6,8 @@
 #include <string>
 #include <stdexcept>
 #include <functional>
+#include <vector>
+#include <unordered_map>
 
 #include "loop.hh"
 #include "response.hh"
@@ -29,6 +31,81 @@ protected:
 
   size_t max_jobs_ { 0 };
 
+  /* the loop ids of the running copies of each thunk, and the number of
+     copies that each id is running (more than one for a batch) */
+  std::unordered_multimap<std::string, uint64_t> running_copies_ {};
+  std::unordered_map<uint64_t, size_t> copies_per_id_ {};
+
+  void copy_started( const std::string & hash, const uint64_t id )
+  {
+    running_copies_.emplace( hash, id );
+    copies_per_id_[ id ]++;
+  }
+
+  /* returns true if the id has no running copies left */
+  bool release_copy( const uint64_t id )
+  {
+    auto count = copies_per_id_.find( id );
+
+    if ( count == copies_per_id_.end() or --count->second > 0 ) {
+      return false;
+    }
+
+    copies_per_id_.erase( count );
+    return true;
+  }
+
+  /* returns false if this copy was cancelled, and should be ignored */
+  bool copy_finished( const std::string & hash, const uint64_t id )
+  {
+    auto range = running_copies_.equal_range( hash );
+
+    for ( auto it = range.first; it != range.second; it++ ) {
+      if ( it->second == id ) {
+        running_copies_.erase( it );
+        release_copy( id );
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool is_running( const uint64_t id ) const { return copies_per_id_.count( id ) > 0; }
+
+  size_t running_copy_count( const std::string & hash ) const
+  {
+    return running_copies_.count( hash );
+  }
+
+  /* forgets the running copies of a thunk; returns the ids that are left
+     with nothing to run, and can be stopped */
+  std::vector<uint64_t> take_running_copies( const std::string & hash )
+  {
+    std::vector<uint64_t> ids;
+    auto range = running_copies_.equal_range( hash );
+
+    for ( auto it = range.first; it != range.second; it++ ) {
+      if ( release_copy( it->second ) ) {
+        ids.push_back( it->second );
+      }
+    }
+
+    running_copies_.erase( range.first, range.second );
+    return ids;
+  }
+
+  /* hands the results of a remote invocation that ran the given thunks to
+     the callbacks, skipping the copies that were cancelled */
+  void report_response( const uint64_t id,
+                        const std::vector<std::string> & thunk_hashes,
+                        ExecutionResponse && response,
+                        const float cost );
+
+  void report_failure( const uint64_t id,
+                       const std::vector<std::string> & thunk_hashes,
+                       const JobStatus status );
+
 public:
   ExecutionEngine( const size_t max_jobs = 1 )
     : max_jobs_( max_jobs )
@@ -43,8 +120,29 @@ public:
 
   virtual void init( ExecutionLoop & ) {}
   virtual void force_thunk( const gg::thunk::Thunk & thunk, ExecutionLoop & exec_loop ) = 0;
+
+  /* stops the running copies of a thunk on this engine, without calling any
+     of the callbacks; returns the number of copies that were stopped */
+  virtual size_t cancel( const std::string & thunk_hash, ExecutionLoop & exec_loop ) = 0;
   virtual bool is_remote() const = 0;
+
+  /* whether the jobs run on this machine, with the local blobs at hand */
+  virtual bool is_local() const { return false; }
   virtual bool can_execute( const gg::thunk::Thunk & thunk ) const = 0;
+
+  /* whether force_chain() can run a chain of thunks, where each thunk waits
+     only on the one before it, as a single job */
+  virtual bool can_run_chains() const { return false; }
+
+  /* the worker holds the inputs of every thunk in the chain at once */
+  bool can_execute_chain( const std::vector<gg::thunk::Thunk> & chain ) const;
+
+  /* runs the thunks in order in one job, passing the outputs of each thunk
+     to the next one on the worker. each thunk is reported on its own, and
+     the thunks that the job leaves out are reported as failures. */
+  virtual void force_chain( const std::vector<gg::thunk::Thunk> & chain,
+                            ExecutionLoop & exec_loop );
+
   virtual size_t job_count() const = 0;
   size_t max_jobs() const { return max_jobs_; }
   virtual std::string label() const = 0;
@@ -7,6 +7,7 @@
 #include <chrono>
 
 #include "engine.hh"
+#include "batcher.hh"
 #include "thunk/thunk.hh"
 #include "net/http_request.hh"
 #include "util/uri.hh"
@@ -22,22 +23,37 @@ private:
   size_t running_jobs_ { 0 };
   std::map<uint64_t, std::chrono::steady_clock::time_point> start_times_ {};
 
-  HTTPRequest generate_request( const gg::thunk::Thunk & thunk );
+  ThunkBatcher batcher_;
+
+  HTTPRequest generate_request( const std::vector<gg::thunk::Thunk> & thunks );
+  void send_batch( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & exec_loop );
 
   static float compute_cost( const std::chrono::steady_clock::time_point & begin,
                              const std::chrono::steady_clock::time_point & end = std::chrono::steady_clock::now() );
 
 public:
-  GCFExecutionEngine( const size_t max_jobs, const std::string & function_url )
+  GCFExecutionEngine( const size_t max_jobs, const std::string & function_url,
+                      const BatchLimits & batch_limits = {} )
     : ExecutionEngine( max_jobs ), parsed_url_( function_url ),
-      address_( parsed_url_.host, parsed_url_.protocol )
-  {}
+      address_( parsed_url_.host, parsed_url_.protocol ),
+      batcher_( [this] ( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & loop )
+                { send_batch( std::move( thunks ), loop ); },
+                [this] ( const std::vector<gg::thunk::Thunk> & thunks )
+                { return can_execute_chain( thunks ); } )
+  {
+    batcher_.set_limits( batch_limits );
+  }
 
   void force_thunk( const gg::thunk::Thunk & thunk,
                     ExecutionLoop & exec_loop ) override;
+  void force_chain( const std::vector<gg::thunk::Thunk> & chain,
+                    ExecutionLoop & exec_loop ) override;
+  size_t cancel( const std::string & thunk_hash,
+                 ExecutionLoop & exec_loop ) override;
 
   bool is_remote() const { return true; }
   bool can_execute( const gg::thunk::Thunk & thunk ) const override;
+  bool can_run_chains() const override { return true; }
   std::string label() const override { return "gcloud"; }
   size_t job_count() const override;
 };
@@ -10,15 +10,14 @@
 #include "util/optional.hh"
 #include "util/system_runner.hh"
 #include "util/units.hh"
-#include "util/base64.hh"
 
 using namespace std;
 using namespace gg;
 using namespace gg::thunk;
 
-HTTPRequest GGExecutionEngine::generate_request( const Thunk & thunk )
+HTTPRequest GGExecutionEngine::generate_request( const vector<Thunk> & thunks )
 {
-  string payload = Thunk::execution_payload( thunk );
+  string payload = Thunk::execution_payload( thunks );
   HTTPRequest request;
   request.set_first_line( "POST / HTTP/1.1" );
   request.add_header( HTTPHeader{ "Content-Length", to_string( payload.size() ) } );
@@ -34,73 +33,79 @@ HTTPRequest GGExecutionEngine::generate_request( const Thunk & thunk )
 void GGExecutionEngine::force_thunk( const Thunk & thunk,
                                      ExecutionLoop & exec_loop )
 {
-  HTTPRequest request = generate_request( thunk );
+  batcher_.add( thunk, exec_loop );
+}
 
-  exec_loop.make_http_request<TCPConnection>( thunk.hash(),
-    address_, request,
-    [this] ( const uint64_t, const string & thunk_hash,
-             const HTTPResponse & http_response ) -> bool
-    {
-      running_jobs_--;
+void GGExecutionEngine::force_chain( const vector<Thunk> & chain,
+                                     ExecutionLoop & exec_loop )
+{
+  /* the worker runs the thunks of a request in order */
+  send_batch( vector<Thunk>( chain ), exec_loop );
+}
 
-      if ( http_response.status_code() != "200" ) {
-        failure_callback_( thunk_hash, JobStatus::InvocationFailure );
-        return false;
-      }
+void GGExecutionEngine::send_batch( vector<Thunk> && thunks,
+                                    ExecutionLoop & exec_loop )
+{
+  HTTPRequest request = generate_request( thunks );
 
-      ExecutionResponse response = ExecutionResponse::parse_message( http_response.body() );
+  vector<string> thunk_hashes;
+  for ( const Thunk & thunk : thunks ) {
+    thunk_hashes.push_back( thunk.hash() );
+  }
 
-      /* print the output, if there's any */
-      if ( response.stdout.length() ) {
-        cerr << response.stdout << endl;
+  const uint64_t connection_id = exec_loop.make_http_request<TCPConnection>( thunk_hashes.front(),
+    address_, request,
+    [this, thunk_hashes] ( const uint64_t id, const string &,
+                           const HTTPResponse & http_response ) -> bool
+    {
+      if ( not is_running( id ) ) {
+        return false;
       }
 
-      switch ( response.status ) {
-      case JobStatus::Success:
-      {
-        if ( response.thunk_hash != thunk_hash ) {
-          cerr << http_response.str() << endl;
-          throw runtime_error( "expected output for " +
-                               thunk_hash + ", got output for " +
-                               response.thunk_hash );
-        }
-
-        for ( const auto & output : response.outputs ) {
-          gg::cache::insert( gg::hash::for_output( response.thunk_hash, output.tag ), output.hash );
-
-          if ( output.data.length() ) {
-            roost::atomic_create( base64::decode( output.data ),
-                                  gg::paths::blob( output.hash ) );
-          }
-        }
-
-        gg::cache::insert( response.thunk_hash, response.outputs.at( 0 ).hash );
-
-        vector<ThunkOutput> thunk_outputs;
-        for ( auto & output : response.outputs ) {
-          thunk_outputs.emplace_back( move( output.hash ), move( output.tag ) );
-        }
-
-        success_callback_( response.thunk_hash, move( thunk_outputs ), 0 );
-
-        break;
-      }
+      running_jobs_--;
 
-      default: /* in case of any other failure */
-        failure_callback_( thunk_hash, response.status );
+      if ( http_response.status_code() != "200" ) {
+        report_failure( id, thunk_hashes, JobStatus::InvocationFailure );
+        return false;
       }
 
+      report_response( id, thunk_hashes,
+                       ExecutionResponse::parse_message( http_response.body() ),
+                       0 );
       return false;
     },
-    [this] ( const uint64_t, const string & thunk_hash )
+    [this, thunk_hashes] ( const uint64_t id, const string & )
     {
-      failure_callback_( thunk_hash, JobStatus::SocketFailure );
+      if ( not is_running( id ) ) {
+        return;
+      }
+
+      running_jobs_--;
+      report_failure( id, thunk_hashes, JobStatus::SocketFailure );
     }
   );
 
+  for ( const string & hash : thunk_hashes ) {
+    copy_started( hash, connection_id );
+  }
+
   running_jobs_++;
 }
 
+size_t GGExecutionEngine::cancel( const string & thunk_hash,
+                                  ExecutionLoop & exec_loop )
+{
+  const size_t count = batcher_.remove( thunk_hash ) + running_copy_count( thunk_hash );
+
+  /* an invocation is stopped once none of its thunks are wanted */
+  for ( const uint64_t id : take_running_copies( thunk_hash ) ) {
+    exec_loop.cancel_http_request( id );
+    running_jobs_--;
+  }
+
+  return count;
+}
+
 size_t GGExecutionEngine::job_count() const
 {
   return running_jobs_;
@@ -4,6 +4,7 @@
 #define ENGINE_GG_HH
 
 #include "engine.hh"
+#include "batcher.hh"
 #include "net/http_request.hh"
 #include "thunk/thunk.hh"
 
@@ -14,20 +15,33 @@ private:
 
   size_t running_jobs_ { 0 };
 
-  HTTPRequest generate_request( const gg::thunk::Thunk & thunk );
+  ThunkBatcher batcher_;
+
+  HTTPRequest generate_request( const std::vector<gg::thunk::Thunk> & thunks );
+  void send_batch( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & exec_loop );
 
 public:
-  GGExecutionEngine( const size_t max_jobs, const Address & address )
-    : ExecutionEngine( max_jobs ), address_( address )
-  {}
+  GGExecutionEngine( const size_t max_jobs, const Address & address,
+                     const BatchLimits & batch_limits = {} )
+    : ExecutionEngine( max_jobs ), address_( address ),
+      batcher_( [this] ( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & loop )
+                { send_batch( std::move( thunks ), loop ); } )
+  {
+    batcher_.set_limits( batch_limits );
+  }
 
   void force_thunk( const gg::thunk::Thunk & thunk,
                     ExecutionLoop & exec_loop ) override;
+  void force_chain( const std::vector<gg::thunk::Thunk> & chain,
+                    ExecutionLoop & exec_loop ) override;
+  size_t cancel( const std::string & thunk_hash,
+                 ExecutionLoop & exec_loop ) override;
   size_t job_count() const override;
 
   bool is_remote() const { return true; }
   std::string label() const override { return "remote"; }
   bool can_execute( const gg::thunk::Thunk & ) const { return true; }
+  bool can_run_chains() const override { return true; }
 };
 
 #endif /* ENGINE_GG_HH */
@@ -9,7 +9,6 @@
 #include "thunk/ggutils.hh"
 #include "net/http_response.hh"
 #include "net/nb_secure_socket.hh"
-#include "util/base64.hh"
 #include "util/optional.hh"
 #include "util/system_runner.hh"
 #include "util/units.hh"
@@ -18,7 +17,7 @@ using namespace std;
 using namespace gg;
 using namespace gg::thunk;
 
-HTTPRequest AWSLambdaExecutionEngine::generate_request( const Thunk & thunk )
+HTTPRequest AWSLambdaExecutionEngine::generate_request( const vector<Thunk> & thunks )
 {
   string function_name;
 
@@ -26,12 +25,13 @@ HTTPRequest AWSLambdaExecutionEngine::generate_request( const Thunk & thunk )
     function_name = "gg-lambda-function";
   }
   else {
-    function_name = "gg-" + thunk.executable_hash();
+    /* the thunks in a batch share their executables */
+    function_name = "gg-" + thunks.front().executable_hash();
   }
 
   return LambdaInvocationRequest(
     credentials_, region_, function_name,
-    Thunk::execution_payload( thunk ),
+    Thunk::execution_payload( thunks ),
     LambdaInvocationRequest::InvocationType::REQUEST_RESPONSE,
     LambdaInvocationRequest::LogType::NONE
   ).to_http_request();
@@ -40,87 +40,96 @@ HTTPRequest AWSLambdaExecutionEngine::generate_request( const Thunk & thunk )
 void AWSLambdaExecutionEngine::force_thunk( const Thunk & thunk,
                                             ExecutionLoop & exec_loop )
 {
-  HTTPRequest request = generate_request( thunk );
+  batcher_.add( thunk, exec_loop );
+}
+
+void AWSLambdaExecutionEngine::force_chain( const vector<Thunk> & chain,
+                                            ExecutionLoop & exec_loop )
+{
+  /* the worker runs the thunks of a request in order */
+  send_batch( vector<Thunk>( chain ), exec_loop );
+}
 
-  uint64_t connection_id = exec_loop.make_http_request<SSLConnection>( thunk.hash(),
+void AWSLambdaExecutionEngine::send_batch( vector<Thunk> && thunks,
+                                           ExecutionLoop & exec_loop )
+{
+  HTTPRequest request = generate_request( thunks );
+
+  vector<string> thunk_hashes;
+  for ( const Thunk & thunk : thunks ) {
+    thunk_hashes.push_back( thunk.hash() );
+  }
+
+  uint64_t connection_id = exec_loop.make_http_request<SSLConnection>( thunk_hashes.front(),
     address_, request,
-    [this] ( const uint64_t id, const string & thunk_hash,
-             const HTTPResponse & http_response ) -> bool
+    [this, thunk_hashes] ( const uint64_t id, const string &,
+                           const HTTPResponse & http_response ) -> bool
     {
+      if ( not is_running( id ) ) {
+        return false;
+      }
+
       running_jobs_--;
 
+      const float cost = compute_cost( start_times_.at( id ) );
+      start_times_.erase( id );
+
       if ( http_response.status_code() != "200" ) {
         if ( http_response.status_code() == "429" or
              ( http_response.status_code() == "500" and
                http_response.has_header( "x-amzn-ErrorType" ) and
                http_response.get_header_value( "x-amzn-ErrorType" ) == "ServiceException" ) ) {
-          failure_callback_( thunk_hash, JobStatus::RateLimit );
+          report_failure( id, thunk_hashes, JobStatus::RateLimit );
           return false;
         }
         else {
-          failure_callback_( thunk_hash, JobStatus::InvocationFailure );
+          report_failure( id, thunk_hashes, JobStatus::InvocationFailure );
           return false;
         }
       }
 
-      ExecutionResponse response = ExecutionResponse::parse_message( http_response.body() );
-
-      /* print the output, if there's any */
-      if ( response.stdout.length() ) {
-        cerr << response.stdout << endl;
-      }
-
-      switch ( response.status ) {
-      case JobStatus::Success:
-      {
-        if ( response.thunk_hash != thunk_hash ) {
-          cerr << http_response.str() << endl;
-          throw runtime_error( "expected output for " +
-                               thunk_hash + ", got output for " +
-                               response.thunk_hash );
-        }
-
-        for ( const auto & output : response.outputs ) {
-          gg::cache::insert( gg::hash::for_output( response.thunk_hash, output.tag ), output.hash );
-
-          if ( output.data.length() ) {
-            roost::atomic_create( base64::decode( output.data ),
-                                  gg::paths::blob( output.hash ) );
-          }
-        }
-
-        gg::cache::insert( response.thunk_hash, response.outputs.at( 0 ).hash );
-
-        vector<ThunkOutput> thunk_outputs;
-        for ( auto & output : response.outputs ) {
-          thunk_outputs.emplace_back( move( output.hash ), move( output.tag ) );
-        }
-
-        success_callback_( response.thunk_hash, move( thunk_outputs ),
-                           compute_cost( start_times_.at( id ) ) );
-
-        start_times_.erase( id );
-        break;
-      }
-
-      default: /* in case of any other failure */
-        failure_callback_( thunk_hash, response.status );
-      }
-
+      report_response( id, thunk_hashes,
+                       ExecutionResponse::parse_message( http_response.body() ),
+                       cost );
       return false;
     },
-    [this] ( const uint64_t id, const string & thunk_hash )
+    [this, thunk_hashes] ( const uint64_t id, const string & )
     {
+      if ( not is_running( id ) ) {
+        return;
+      }
+
+      running_jobs_--;
       start_times_.erase( id );
-      failure_callback_( thunk_hash, JobStatus::SocketFailure );
+      report_failure( id, thunk_hashes, JobStatus::SocketFailure );
     }
   );
 
+  for ( const string & hash : thunk_hashes ) {
+    copy_started( hash, connection_id );
+  }
+
   start_times_.insert( { connection_id, chrono::steady_clock::now() } );
 
   running_jobs_++;
 }
 
+size_t AWSLambdaExecutionEngine::cancel( const string & thunk_hash,
+                                         ExecutionLoop & exec_loop )
+{
+  const size_t count = batcher_.remove( thunk_hash ) + running_copy_count( thunk_hash );
+
+  /* an invocation is stopped once none of its thunks are wanted. the function
+     keeps running (and billing) until it's done; only the slot is reclaimed */
+  for ( const uint64_t id : take_running_copies( thunk_hash ) ) {
+    exec_loop.cancel_http_request( id );
+    start_times_.erase( id );
+    running_jobs_--;
+  }
+
+  return count;
+}
+
 size_t AWSLambdaExecutionEngine::job_count() const
 {
   return running_jobs_;
@@ -131,6 +140,12 @@ bool AWSLambdaExecutionEngine::can_execute( const gg::thunk::Thunk & thunk ) con
   return thunk.infiles_size() < 230_MiB;
 }
 
+bool AWSLambdaExecutionEngine::can_run_chains() const
+{
+  /* a specialized function only has the executables of one thunk */
+  return getenv( "GG_SPECIALIZED_FUNCTION" ) == nullptr;
+}
+
 float AWSLambdaExecutionEngine::compute_cost( const chrono::steady_clock::time_point & begin,
                                               const chrono::steady_clock::time_point & end )
 {
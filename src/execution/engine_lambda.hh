@@ -7,6 +7,7 @@
 #include <chrono>
 
 #include "engine.hh"
+#include "batcher.hh"
 #include "thunk/thunk.hh"
 #include "net/aws.hh"
 #include "net/lambda.hh"
@@ -23,7 +24,10 @@ private:
   size_t running_jobs_ { 0 };
   std::map<uint64_t, std::chrono::steady_clock::time_point> start_times_ {};
 
-  HTTPRequest generate_request( const gg::thunk::Thunk & thunk );
+  ThunkBatcher batcher_;
+
+  HTTPRequest generate_request( const std::vector<gg::thunk::Thunk> & thunks );
+  void send_batch( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & exec_loop );
 
   static float compute_cost( const std::chrono::steady_clock::time_point & begin,
                              const std::chrono::steady_clock::time_point & end = std::chrono::steady_clock::now() );
@@ -31,16 +35,28 @@ private:
 public:
   AWSLambdaExecutionEngine( const size_t max_jobs,
                             const AWSCredentials & credentials,
-                            const std::string & region )
+                            const std::string & region,
+                            const BatchLimits & batch_limits = {} )
     : ExecutionEngine( max_jobs ), credentials_( credentials ), region_( region ),
-      address_( LambdaInvocationRequest::endpoint( region_ ), "https" )
-  {}
+      address_( LambdaInvocationRequest::endpoint( region_ ), "https" ),
+      batcher_( [this] ( std::vector<gg::thunk::Thunk> && thunks, ExecutionLoop & loop )
+                { send_batch( std::move( thunks ), loop ); },
+                [this] ( const std::vector<gg::thunk::Thunk> & thunks )
+                { return can_execute_chain( thunks ); } )
+  {
+    batcher_.set_limits( batch_limits );
+  }
 
   void force_thunk( const gg::thunk::Thunk & thunk,
                     ExecutionLoop & exec_loop ) override;
+  void force_chain( const std::vector<gg::thunk::Thunk> & chain,
+                    ExecutionLoop & exec_loop ) override;
+  size_t cancel( const std::string & thunk_hash,
+                 ExecutionLoop & exec_loop ) override;
 
   bool is_remote() const { return true; }
   bool can_execute( const gg::thunk::Thunk & thunk ) const override;
+  bool can_run_chains() const override;
   std::string label() const override { return "\u03bb"; }
   size_t job_count() const override;
 };
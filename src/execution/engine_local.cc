@@ -15,45 +15,97 @@ using namespace gg::thunk;
 void LocalExecutionEngine::force_thunk( const Thunk & thunk,
                                         ExecutionLoop & exec_loop )
 {
-  exec_loop.add_child_process( thunk.hash(),
-    [this, outputs=thunk.outputs()] ( const uint64_t, const string & hash, const int )
+  execute( { { thunk.hash(), thunk.outputs() } }, exec_loop );
+}
+
+void LocalExecutionEngine::force_chain( const vector<Thunk> & chain,
+                                        ExecutionLoop & exec_loop )
+{
+  vector<pair<string, vector<string>>> thunks;
+
+  for ( const Thunk & thunk : chain ) {
+    thunks.emplace_back( thunk.hash(), thunk.outputs() );
+  }
+
+  execute( move( thunks ), exec_loop );
+}
+
+void LocalExecutionEngine::execute( vector<pair<string, vector<string>>> && thunks,
+                                    ExecutionLoop & exec_loop )
+{
+  vector<string> command { "gg-execute" };
+
+  if ( mixed_ ) {
+    command.insert( command.end(), { "--get-dependencies", "--put-output" } );
+  }
+
+  for ( const auto & thunk : thunks ) {
+    command.push_back( thunk.first );
+  }
+
+  const string first_hash = thunks.front().first;
+
+  const uint64_t id = exec_loop.add_child_process( first_hash,
+    [this, thunks] ( const uint64_t id, const string &, const int )
     {
       running_jobs_--; /* XXX not thread-safe */
 
-      vector<ThunkOutput> thunk_outputs;
+      for ( size_t i = 0; i < thunks.size(); i++ ) {
+        const string & hash = thunks[ i ].first;
+        copy_finished( hash, id );
+
+        vector<ThunkOutput> thunk_outputs;
+
+        for ( const auto & tag : thunks[ i ].second ) {
+          Optional<cache::ReductionResult> result = cache::check( gg::hash::for_output( hash, tag ) );
 
-      for ( const auto & tag : outputs ) {
-        Optional<cache::ReductionResult> result = cache::check( gg::hash::for_output( hash, tag ) );
+          if ( not result.initialized() ) {
+            break;
+          }
 
-        if ( not result.initialized() ) {
-          throw runtime_error( "could not find the reduction entry" );
+          thunk_outputs.emplace_back( move( result->hash ), tag );
         }
 
-        thunk_outputs.emplace_back( move( result->hash ), tag );
-      }
+        if ( thunk_outputs.size() < thunks[ i ].second.size() ) {
+          if ( i == 0 ) {
+            throw runtime_error( "could not find the reduction entry" );
+          }
 
-      success_callback_( hash, move( thunk_outputs ), 0 );
-    },
-    [mixed=this->mixed_, &thunk]()
-    {
-      vector<string> command;
+          /* gg-execute stops at the first thunk of a chain that it can't run */
+          failure_callback_( hash, JobStatus::OperationalFailure );
+          continue;
+        }
 
-      if ( mixed ) {
-          command = { "gg-execute", "--get-dependencies", "--put-output",
-                      thunk.hash() };
+        success_callback_( hash, move( thunk_outputs ), 0 );
       }
-      else {
-          command = { "gg-execute", thunk.hash() };
-      }
-
+    },
+    [&command]()
+    {
       return ezexec( command[ 0 ], command, {}, true, true );
     },
     true
   );
 
+  for ( const auto & thunk : thunks ) {
+    copy_started( thunk.first, id );
+  }
+
   running_jobs_++;
 }
 
+size_t LocalExecutionEngine::cancel( const string & thunk_hash,
+                                     ExecutionLoop & exec_loop )
+{
+  const vector<uint64_t> ids = take_running_copies( thunk_hash );
+
+  for ( const uint64_t id : ids ) {
+    exec_loop.cancel_child_process( id );
+    running_jobs_--;
+  }
+
+  return ids.size();
+}
+
 size_t LocalExecutionEngine::job_count() const
 {
   return running_jobs_;
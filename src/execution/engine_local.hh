@@ -13,6 +13,10 @@ private:
   bool mixed_ { false };
   size_t running_jobs_ { 0 };
 
+  /* runs gg-execute on the thunks, given by their hashes and output tags */
+  void execute( std::vector<std::pair<std::string, std::vector<std::string>>> && thunks,
+                ExecutionLoop & exec_loop );
+
 public:
   LocalExecutionEngine( const bool mixed = false,
                         const size_t max_jobs = std::thread::hardware_concurrency() )
@@ -21,11 +25,17 @@ public:
 
   void force_thunk( const gg::thunk::Thunk & thunk,
                     ExecutionLoop & exec_loop ) override;
+  void force_chain( const std::vector<gg::thunk::Thunk> & chain,
+                    ExecutionLoop & exec_loop ) override;
+  size_t cancel( const std::string & thunk_hash,
+                 ExecutionLoop & exec_loop ) override;
   size_t job_count() const override;
 
   bool is_remote() const override { return mixed_; }
+  bool is_local() const override { return true; }
   std::string label() const override { return "local"; }
   bool can_execute( const gg::thunk::Thunk & ) const override { return true; }
+  bool can_run_chains() const override { return true; }
 };
 
 #endif /* ENGINE_LOCAL_HH */
@@ -85,6 +85,14 @@ void MeowExecutionEngine::init( ExecutionLoop & exec_loop )
               const string & thunk_hash = execution_response.thunk_hash();
               // cerr << "[meow:worker@" << id << ":executed] " << thunk_hash << endl;
 
+              Lambda & lambda = lambdas_.at( id );
+
+              /* the result of a job that was cancelled */
+              if ( not lambda.executing_thunk.initialized() or
+                   lambda.executing_thunk->hash() != thunk_hash ) {
+                break;
+              }
+
               for ( const auto & output : execution_response.outputs() ) {
                 gg::cache::insert( gg::hash::for_output( thunk_hash, output.tag() ), output.hash() );
                 // XXX gg::remote::set_available( output.hash() );
@@ -96,7 +104,8 @@ void MeowExecutionEngine::init( ExecutionLoop & exec_loop )
               }
 
               gg::cache::insert( thunk_hash, execution_response.outputs( 0 ).hash() );
-              lambdas_.at( id ).state = Lambda::State::Idle;
+              lambda.state = Lambda::State::Idle;
+              lambda.executing_thunk.clear();
               free_lambdas_.insert( id );
               running_jobs_--;
 
@@ -277,6 +286,48 @@ void MeowExecutionEngine::force_thunk( const Thunk & thunk, ExecutionLoop & loop
   );
 }
 
+size_t MeowExecutionEngine::cancel( const string & thunk_hash, ExecutionLoop & )
+{
+  size_t cancelled = 0;
+
+  for ( auto & item : lambdas_ ) {
+    Lambda & lambda = item.second;
+
+    if ( lambda.state != Lambda::State::Busy or
+         not lambda.executing_thunk.initialized() or
+         lambda.executing_thunk->hash() != thunk_hash ) {
+      continue;
+    }
+
+    /* the worker handles the messages in order, so this lambda is free for
+       the next thunk right away */
+    lambda.connection->enqueue_write( Message( Message::OpCode::Cancel,
+                                               string( thunk_hash ) ).str() );
+    lambda.state = Lambda::State::Idle;
+    lambda.executing_thunk.clear();
+    free_lambdas_.insert( lambda.id );
+    cancelled++;
+  }
+
+  /* and the copies that are still waiting for a lambda */
+  queue<Thunk> remaining_thunks;
+
+  while ( not thunks_queue_.empty() ) {
+    if ( thunks_queue_.front().hash() == thunk_hash ) {
+      cancelled++;
+    }
+    else {
+      remaining_thunks.push( move( thunks_queue_.front() ) );
+    }
+
+    thunks_queue_.pop();
+  }
+
+  thunks_queue_.swap( remaining_thunks );
+  running_jobs_ -= cancelled;
+  return cancelled;
+}
+
 bool MeowExecutionEngine::can_execute( const gg::thunk::Thunk & thunk ) const
 {
   return thunk.infiles_size() < 200_MiB;
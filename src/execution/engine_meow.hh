@@ -65,6 +65,8 @@ public:
 
   void force_thunk( const gg::thunk::Thunk & thunk,
                     ExecutionLoop & exec_loop ) override;
+  size_t cancel( const std::string & thunk_hash,
+                 ExecutionLoop & exec_loop ) override;
 
   bool is_remote() const { return true; }
   bool can_execute( const gg::thunk::Thunk & thunk ) const override;
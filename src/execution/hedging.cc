@@ -0,0 +1,64 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "hedging.hh"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t HedgingPolicy::WINDOW_SIZE;
+constexpr size_t HedgingPolicy::MIN_SAMPLES;
+
+HedgingPolicy::HedgingPolicy( const double percentile, const double budget )
+  : percentile_( percentile ), budget_( budget )
+{
+  if ( percentile_ <= 0 or percentile_ > 100 ) {
+    throw runtime_error( "hedging percentile must be in (0, 100]" );
+  }
+
+  if ( budget_ < 0 ) {
+    throw runtime_error( "hedging budget cannot be negative" );
+  }
+}
+
+void HedgingPolicy::job_finished( const string & function_hash,
+                                  const milliseconds & runtime )
+{
+  RuntimeWindow & window = runtimes_[ function_hash ];
+
+  if ( window.samples.size() < WINDOW_SIZE ) {
+    window.samples.push_back( runtime );
+  }
+  else {
+    window.samples[ window.next ] = runtime;
+    window.next = ( window.next + 1 ) % WINDOW_SIZE;
+  }
+}
+
+Optional<milliseconds> HedgingPolicy::threshold( const string & function_hash ) const
+{
+  auto window = runtimes_.find( function_hash );
+
+  if ( window == runtimes_.end() or window->second.samples.size() < MIN_SAMPLES ) {
+    return {};
+  }
+
+  vector<milliseconds> samples { window->second.samples };
+  const size_t rank = static_cast<size_t>( ceil( percentile_ / 100 * samples.size() ) ) - 1;
+
+  nth_element( samples.begin(), samples.begin() + rank, samples.end() );
+  return { true, max( 1ms, samples[ rank ] ) };
+}
+
+bool HedgingPolicy::try_duplicate()
+{
+  if ( duplicated_jobs_ + 1 > budget_ * launched_jobs_ ) {
+    return false;
+  }
+
+  duplicated_jobs_++;
+  return true;
+}
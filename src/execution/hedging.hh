@@ -0,0 +1,63 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef HEDGING_HH
+#define HEDGING_HH
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+
+#include "util/optional.hh"
+
+/* how often the running jobs are checked against the thresholds */
+static constexpr std::chrono::milliseconds HEDGING_CHECK_INTERVAL { 100 };
+
+/* Decides when a running job should be duplicated. The runtimes of the
+   finished jobs are kept per function, and a job is duplicated once it has
+   been running for longer than the given percentile of the runtimes of its
+   function. The number of duplicates is capped to a fraction of the number of
+   jobs launched. */
+class HedgingPolicy
+{
+private:
+  /* the most recent runtimes of a function */
+  struct RuntimeWindow
+  {
+    std::vector<std::chrono::milliseconds> samples {};
+    size_t next { 0 };
+  };
+
+  static constexpr size_t WINDOW_SIZE = 256;
+  static constexpr size_t MIN_SAMPLES = 8;
+
+  const double percentile_;
+  const double budget_;
+
+  std::unordered_map<std::string, RuntimeWindow> runtimes_ {};
+
+  size_t launched_jobs_ { 0 };
+  size_t duplicated_jobs_ { 0 };
+
+public:
+  /* percentile is in (0, 100]; budget is the largest allowed ratio of
+     duplicates to launched jobs */
+  HedgingPolicy( const double percentile, const double budget );
+
+  void job_finished( const std::string & function_hash,
+                     const std::chrono::milliseconds & runtime );
+
+  /* how long a job of this function can run before it's duplicated, if
+     enough of its jobs have finished to tell */
+  Optional<std::chrono::milliseconds>
+  threshold( const std::string & function_hash ) const;
+
+  void job_launched() { launched_jobs_++; }
+
+  /* returns true, and counts the duplicate, if the budget allows for one */
+  bool try_duplicate();
+
+  size_t duplicated_jobs() const { return duplicated_jobs_; }
+};
+
+#endif /* HEDGING_HH */
@@ -0,0 +1,153 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "loader.hh"
+
+#include "util/pipe.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+ThunkLoader::ThunkLoader( ExecutionLoop & exec_loop, const size_t thread_count,
+                          const ReadFunc & read,
+                          const LoadedCallbackFunc & loaded_callback )
+  : ThunkLoader( exec_loop, thread_count, read, loaded_callback, make_pipe() )
+{}
+
+ThunkLoader::ThunkLoader( ExecutionLoop & exec_loop, const size_t thread_count,
+                          const ReadFunc & read,
+                          const LoadedCallbackFunc & loaded_callback,
+                          pair<FileDescriptor, FileDescriptor> && pipe )
+  : read_( read ), loaded_callback_( loaded_callback ),
+    notify_fd_( move( pipe.second ) )
+{
+  exec_loop.add_connection<FileDescriptor>(
+    move( pipe.first ),
+    [this] ( shared_ptr<IPCConnection>, string && )
+    {
+      process_loaded();
+      return true;
+    },
+    [] () { throw runtime_error( "error reading loader notifications" ); } );
+
+  for ( size_t i = 0; i < thread_count; i++ ) {
+    threads_.emplace_back( &ThunkLoader::load_loop, this );
+  }
+}
+
+ThunkLoader::~ThunkLoader()
+{
+  {
+    unique_lock<mutex> lock { mutex_ };
+    stopping_ = true;
+  }
+
+  queue_changed_.notify_all();
+
+  for ( auto & thread : threads_ ) {
+    thread.join();
+  }
+}
+
+void ThunkLoader::add( const vector<Hash> & hashes )
+{
+  if ( hashes.empty() ) {
+    return;
+  }
+
+  {
+    unique_lock<mutex> lock { mutex_ };
+    queue_.insert( queue_.end(), hashes.begin(), hashes.end() );
+  }
+
+  pending_count_ += hashes.size();
+
+  if ( threads_.empty() ) {
+    wake_up();
+  }
+  else {
+    queue_changed_.notify_all();
+  }
+}
+
+void ThunkLoader::wake_up()
+{
+  if ( not queue_.empty() and not wakeup_pending_ ) {
+    notify_fd_.write( "\n" );
+    wakeup_pending_ = true;
+  }
+}
+
+void ThunkLoader::load_inline()
+{
+  wakeup_pending_ = false;
+
+  for ( size_t i = 0; i < INLINE_BATCH_SIZE and not queue_.empty(); i++ ) {
+    const Hash hash = queue_.front();
+    queue_.pop_front();
+    pending_count_--;
+
+    loaded_callback_( hash, read_( hash ) );
+  }
+
+  /* the rest waits for the next turn of the loop */
+  wake_up();
+}
+
+void ThunkLoader::load_loop()
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  while ( true ) {
+    queue_changed_.wait( lock, [this] { return stopping_ or not queue_.empty(); } );
+
+    if ( stopping_ or error_ ) {
+      return;
+    }
+
+    const Hash hash = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+
+    try {
+      Thunk thunk = read_( hash );
+      lock.lock();
+      loaded_.emplace_back( hash, move( thunk ) );
+    }
+    catch ( ... ) {
+      lock.lock();
+      error_ = current_exception();
+    }
+
+    /* the loop only needs to be woken up once for what has piled up */
+    if ( loaded_.size() == 1 or error_ ) {
+      notify_fd_.write( "\n" );
+    }
+  }
+}
+
+void ThunkLoader::process_loaded()
+{
+  if ( threads_.empty() ) {
+    load_inline();
+    return;
+  }
+
+  vector<pair<Hash, Thunk>> loaded;
+
+  {
+    unique_lock<mutex> lock { mutex_ };
+
+    if ( error_ ) {
+      rethrow_exception( error_ );
+    }
+
+    loaded.swap( loaded_ );
+  }
+
+  pending_count_ -= loaded.size();
+
+  for ( auto & item : loaded ) {
+    loaded_callback_( item.first, move( item.second ) );
+  }
+}
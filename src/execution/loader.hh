@@ -0,0 +1,84 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "loop.hh"
+#include "thunk/hash.hh"
+#include "thunk/thunk.hh"
+#include "util/file_descriptor.hh"
+
+/* Reads and parses thunks on background threads, for the subgraphs that
+   executions return. Each thunk is handed to the callback on the loop's
+   thread as soon as it's read, in no particular order; the loop is woken up
+   through a pipe, like for the DependencyUploader.
+
+   A process can't fork once it has other threads, so with no threads, the
+   thunks are read on the loop's thread instead, a few at a time: the loader
+   wakes the loop up through the same pipe until its queue is empty, and the
+   jobs that became ready are dispatched in between. */
+class ThunkLoader
+{
+public:
+  typedef std::function<gg::thunk::Thunk( const gg::Hash & )> ReadFunc;
+  typedef std::function<void( const gg::Hash &, gg::thunk::Thunk && )> LoadedCallbackFunc;
+
+private:
+  static constexpr size_t INLINE_BATCH_SIZE = 16;
+
+  ReadFunc read_;
+  LoadedCallbackFunc loaded_callback_;
+
+  /* touched only by the loop's thread */
+  size_t pending_count_ { 0 };
+  bool wakeup_pending_ { false };
+
+  /* shared with the loader threads, if there are any */
+  std::mutex mutex_ {};
+  std::condition_variable queue_changed_ {};
+  std::deque<gg::Hash> queue_ {};
+  std::vector<std::pair<gg::Hash, gg::thunk::Thunk>> loaded_ {};
+  std::exception_ptr error_ {};
+  bool stopping_ { false };
+
+  FileDescriptor notify_fd_;
+
+  std::vector<std::thread> threads_ {};
+
+  ThunkLoader( ExecutionLoop & exec_loop, const size_t thread_count,
+               const ReadFunc & read, const LoadedCallbackFunc & loaded_callback,
+               std::pair<FileDescriptor, FileDescriptor> && pipe );
+
+  void load_loop();
+  void process_loaded();
+
+  /* without threads */
+  void load_inline();
+  void wake_up();
+
+public:
+  ThunkLoader( ExecutionLoop & exec_loop, const size_t thread_count,
+               const ReadFunc & read, const LoadedCallbackFunc & loaded_callback );
+  ~ThunkLoader();
+
+  void add( const std::vector<gg::Hash> & hashes );
+
+  /* the thunks that were added, and haven't been handed to the callback */
+  size_t pending_count() const { return pending_count_; }
+
+  /* forbid copying */
+  ThunkLoader( const ThunkLoader & other ) = delete;
+  ThunkLoader & operator=( const ThunkLoader & other ) = delete;
+};
+
+#endif /* LOADER_HH */
@@ -10,6 +10,7 @@
 #include "util/optional.hh"
 
 using namespace std;
+using namespace std::chrono;
 using namespace PollerShortNames;
 
 using ReductionResult = gg::cache::ReductionResult;
@@ -26,14 +27,46 @@ ExecutionLoop::ExecutionLoop()
       [&]() { return handle_signal( signal_fd_.read_signal() ); },
       [&]() { return ( child_processes_.size() > 0 or
                        connections_.size() > 0 or
-                       ssl_connections_.size() > 0 ); }
+                       ssl_connections_.size() > 0 or
+                       ipc_connections_.size() > 0 or
+                       ipc_listeners_.size() > 0 or
+                       timers_.size() > 0 ); }
     )
   );
 }
 
+void ExecutionLoop::add_timer( const milliseconds & delay,
+                               const function<void()> & callback )
+{
+  timers_.emplace( steady_clock::now() + delay, callback );
+}
+
 Poller::Result ExecutionLoop::loop_once( const int timeout_ms )
 {
-  return poller_.poll( timeout_ms );
+  int poll_timeout = timeout_ms;
+
+  if ( not timers_.empty() ) {
+    const auto until_next = duration_cast<milliseconds>( timers_.begin()->first
+                                                         - steady_clock::now() ) + 1ms;
+    const int timer_timeout = static_cast<int>( max( 1ms, until_next ).count() );
+
+    if ( poll_timeout < 0 or timer_timeout < poll_timeout ) {
+      poll_timeout = timer_timeout;
+    }
+  }
+
+  const Poller::Result result = poller_.poll( poll_timeout );
+
+  /* a timer's callback can add new timers */
+  const auto now = steady_clock::now();
+
+  while ( not timers_.empty() and timers_.begin()->first <= now ) {
+    function<void()> callback = move( timers_.begin()->second );
+    timers_.erase( timers_.begin() );
+    callback();
+  }
+
+  return result;
 }
 
 template<>
@@ -52,6 +85,14 @@ ExecutionLoop::create_connection( NBSecureSocket && socket )
                                    make_shared<SSLConnection>( move( socket ) ) );
 }
 
+template<>
+typename list<shared_ptr<IPCConnection>>::iterator
+ExecutionLoop::create_connection( FileDescriptor && socket )
+{
+  return ipc_connections_.emplace( ipc_connections_.end(),
+                                   make_shared<IPCConnection>( move( socket ) ) );
+}
+
 template<>
 void ExecutionLoop::remove_connection<TCPConnection>( const list<shared_ptr<TCPConnection>>::iterator & it )
 {
@@ -65,20 +106,26 @@ void ExecutionLoop::remove_connection<SSLConnection>( const list<shared_ptr<SSLC
 }
 
 template<>
-shared_ptr<TCPConnection>
-ExecutionLoop::add_connection( TCPSocket && socket,
-                               const function<bool(shared_ptr<TCPConnection>, string &&)> & data_callback,
-                               const function<void()> & error_callback,
-                               const function<void()> & close_callback )
+void ExecutionLoop::remove_connection<IPCConnection>( const list<shared_ptr<IPCConnection>>::iterator & it )
 {
-  auto connection_it = create_connection<TCPSocket>( move( socket ) );
-  shared_ptr<TCPConnection> & connection = *connection_it;
+  ipc_connections_.erase( it );
+}
+
+template<class SocketType>
+shared_ptr<Connection<SocketType>>
+ExecutionLoop::add_plain_connection( SocketType && socket,
+                                     const function<bool(shared_ptr<Connection<SocketType>>, string &&)> & data_callback,
+                                     const function<void()> & error_callback,
+                                     const function<void()> & close_callback )
+{
+  auto connection_it = create_connection<SocketType>( move( socket ) );
+  shared_ptr<Connection<SocketType>> & connection = *connection_it;
 
   auto real_close_callback =
     [connection_it, cc=move( close_callback ), this] ()
     {
       cc();
-      remove_connection<TCPConnection>( connection_it );
+      remove_connection<Connection<SocketType>>( connection_it );
     };
 
   auto fderror_callback =
@@ -91,8 +138,13 @@ ExecutionLoop::add_connection( TCPSocket && socket,
   poller_.add_action(
     Poller::Action(
       connection->socket_, Direction::Out,
-      [connection] ()
+      [connection, real_close_callback] ()
       {
+        if ( connection->cancelled_ ) {
+          real_close_callback();
+          return ResultType::CancelAll;
+        }
+
         string::const_iterator last_write =
           connection->socket_.write( connection->write_buffer_.begin(),
                                      connection->write_buffer_.cend() );
@@ -100,7 +152,7 @@ ExecutionLoop::add_connection( TCPSocket && socket,
         connection->write_buffer_.erase( 0, last_write - connection->write_buffer_.cbegin() );
         return ResultType::Continue;
       },
-      [connection] { return connection->write_buffer_.size(); },
+      [connection] { return connection->write_buffer_.size() or connection->cancelled_; },
       fderror_callback
     )
   );
@@ -112,6 +164,10 @@ ExecutionLoop::add_connection( TCPSocket && socket,
        data_callback  { move( data_callback ) },
        close_callback { move( real_close_callback ) }] ()
       {
+        if ( connection->cancelled_ ) {
+          return ResultType::CancelAll;
+        }
+
         string data { move( connection->socket_.read() ) };
 
         if ( data.empty() or not data_callback( connection, move( data ) ) ) {
@@ -129,6 +185,28 @@ ExecutionLoop::add_connection( TCPSocket && socket,
   return *connection_it;
 }
 
+template<>
+shared_ptr<TCPConnection>
+ExecutionLoop::add_connection( TCPSocket && socket,
+                               const function<bool(shared_ptr<TCPConnection>, string &&)> & data_callback,
+                               const function<void()> & error_callback,
+                               const function<void()> & close_callback )
+{
+  return add_plain_connection<TCPSocket>( move( socket ), data_callback,
+                                          error_callback, close_callback );
+}
+
+template<>
+shared_ptr<IPCConnection>
+ExecutionLoop::add_connection( FileDescriptor && socket,
+                               const function<bool(shared_ptr<IPCConnection>, string &&)> & data_callback,
+                               const function<void()> & error_callback,
+                               const function<void()> & close_callback )
+{
+  return add_plain_connection<FileDescriptor>( move( socket ), data_callback,
+                                               error_callback, close_callback );
+}
+
 template<>
 shared_ptr<SSLConnection>
 ExecutionLoop::add_connection( NBSecureSocket && socket,
@@ -157,13 +235,18 @@ ExecutionLoop::add_connection( NBSecureSocket && socket,
   poller_.add_action(
     Poller::Action(
       connection->socket_, Direction::Out,
-      [connection] ()
+      [connection, real_close_callback] ()
       {
+        if ( connection->cancelled_ ) {
+          real_close_callback();
+          return ResultType::CancelAll;
+        }
+
         connection->socket_.ezwrite( move( connection->write_buffer_ ) );
         connection->write_buffer_ = string {};
         return ResultType::Continue;
       },
-      [connection] { return connection->write_buffer_.size(); },
+      [connection] { return connection->write_buffer_.size() or connection->cancelled_; },
       fderror_callback
     )
   );
@@ -175,6 +258,10 @@ ExecutionLoop::add_connection( NBSecureSocket && socket,
        data_callback=move( data_callback ),
        close_callback=move( real_close_callback )] ()
       {
+        if ( connection->cancelled_ ) {
+          return ResultType::CancelAll;
+        }
+
         string data { move( connection->socket_.ezread() ) };
 
         if ( data.empty() or not data_callback( connection, move( data ) ) ) {
@@ -251,12 +338,22 @@ uint64_t ExecutionLoop::make_http_request( const string & tag,
     [connection_id, tag, failure_callback]
     { failure_callback( connection_id, tag ); };
 
-  auto close_callback = [] {};
+  auto close_callback =
+    [connection_id, this]
+    { http_request_cancellers_.erase( connection_id ); };
 
   auto connection = make_connection<ConnectionType>( address, data_callback, error_callback, close_callback );
 
   connection->write_buffer_ = move( request.str() );
 
+  http_request_cancellers_.emplace( connection_id,
+    [weak_connection=weak_ptr<ConnectionType>( connection )]
+    {
+      if ( auto connection = weak_connection.lock() ) {
+        connection->cancelled_ = true;
+      }
+    } );
+
   return connection_id;
 }
 
@@ -288,6 +385,29 @@ uint64_t ExecutionLoop::make_listener( const Address & address,
   return current_id_++;
 }
 
+uint64_t ExecutionLoop::make_ipc_listener( const string & path,
+                                           const function<bool(ExecutionLoop &,
+                                                               FileDescriptor &&)> & connection_callback )
+{
+  auto listener_it = ipc_listeners_.emplace( ipc_listeners_.end() );
+  listener_it->bind( path );
+  listener_it->listen();
+
+  poller_.add_action( Poller::Action( *listener_it,
+    Direction::In,
+    [listener_it, connection_callback, this] () -> ResultType
+    {
+      if ( not connection_callback( *this, listener_it->accept() ) ) {
+        ipc_listeners_.erase( listener_it );
+        return ResultType::CancelAll;
+      }
+
+      return ResultType::Continue;
+    } ) );
+
+  return current_id_++;
+}
+
 uint64_t ExecutionLoop::add_child_process( const string & tag,
                                            LocalCallbackFunc callback,
                                            function<int()> && child_procedure,
@@ -298,6 +418,33 @@ uint64_t ExecutionLoop::add_child_process( const string & tag,
   return current_id_++;
 }
 
+void ExecutionLoop::cancel_child_process( const uint64_t id )
+{
+  for ( auto & child : child_processes_ ) {
+    if ( get<0>( child ) != id ) {
+      continue;
+    }
+
+    if ( not get<3>( child ).terminated() ) {
+      /* the process is reaped as usual, but nobody hears about it */
+      get<1>( child ) = false;
+      get<2>( child ) = [] ( const uint64_t, const string &, const int ) {};
+      get<3>( child ).signal( SIGKILL );
+    }
+
+    return;
+  }
+}
+
+void ExecutionLoop::cancel_http_request( const uint64_t id )
+{
+  auto canceller = http_request_cancellers_.find( id );
+
+  if ( canceller != http_request_cancellers_.end() ) {
+    canceller->second();
+  }
+}
+
 Poller::Action::Result ExecutionLoop::handle_signal( const signalfd_siginfo & sig )
 {
   switch ( sig.ssi_signo ) {
@@ -308,8 +455,11 @@ Poller::Action::Result ExecutionLoop::handle_signal( const signalfd_siginfo & si
     break;
 
   case SIGCHLD:
+    /* every child that has exited is reaped below, so a child that exits
+       while the previous signal is handled leaves a signal with nothing to
+       do, possibly after the last child is gone */
     if ( child_processes_.empty() ) {
-      throw runtime_error( "received SIGCHLD without any managed children" );
+      break;
     }
 
     for ( auto it = child_processes_.begin(); it != child_processes_.end(); it++ ) {
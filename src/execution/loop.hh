@@ -4,7 +4,9 @@
 #define LOOP_HH
 
 #include <list>
+#include <map>
 #include <vector>
+#include <chrono>
 #include <functional>
 #include <unordered_map>
 #include <type_traits>
@@ -16,6 +18,7 @@
 #include "net/nb_secure_socket.hh"
 #include "util/signalfd.hh"
 #include "util/child_process.hh"
+#include "util/ipc_socket.hh"
 #include "util/poller.hh"
 
 class ExecutionLoop
@@ -40,9 +43,18 @@ private:
   std::list<std::tuple<uint64_t, bool, LocalCallbackFunc, ChildProcess>> child_processes_ {};
   std::list<std::shared_ptr<TCPConnection>> connections_ {};
   std::list<std::shared_ptr<SSLConnection>> ssl_connections_ {};
+  std::list<std::shared_ptr<IPCConnection>> ipc_connections_ {};
+  std::list<IPCSocket> ipc_listeners_ {};
 
   SSLContext ssl_context_ {};
 
+  /* the callbacks that are waiting for a deadline */
+  std::multimap<std::chrono::steady_clock::time_point,
+                std::function<void()>> timers_ {};
+
+  /* the ongoing http requests, by id */
+  std::unordered_map<uint64_t, std::function<void()>> http_request_cancellers_ {};
+
   Poller::Action::Result handle_signal( const signalfd_siginfo & );
 
   template<typename SocketType>
@@ -51,6 +63,15 @@ private:
   template<typename ConnectionType>
   void remove_connection( const typename std::list<std::shared_ptr<ConnectionType>>::iterator & it );
 
+  /* for the connections that read and write the file descriptor directly */
+  template<class SocketType>
+  std::shared_ptr<Connection<SocketType>>
+  add_plain_connection( SocketType && socket,
+                        const std::function<bool(std::shared_ptr<Connection<SocketType>>,
+                                                 std::string &&)> & data_callback,
+                        const std::function<void()> & error_callback,
+                        const std::function<void()> & close_callback );
+
 public:
   ExecutionLoop();
 
@@ -86,6 +107,20 @@ public:
                           const std::function<bool(ExecutionLoop &,
                                                    TCPSocket &&)> & connection_callback );
 
+  /* listens on a unix domain socket at the given path */
+  uint64_t make_ipc_listener( const std::string & path,
+                              const std::function<bool(ExecutionLoop &,
+                                                       FileDescriptor &&)> & connection_callback );
+
+  /* the callbacks of a cancelled child process or http request are never
+     called; the child is killed and the connection is closed. */
+  void cancel_child_process( const uint64_t id );
+  void cancel_http_request( const uint64_t id );
+
+  /* calls back once, after the delay; loop_once() doesn't wait past it */
+  void add_timer( const std::chrono::milliseconds & delay,
+                  const std::function<void()> & callback );
+
   Poller::Result loop_once( const int timeout_ms = -1 );
 };
 
@@ -24,6 +24,7 @@ namespace meow {
       Executed,
       ExecutionFailed,
       Bye,
+      Cancel,
     };
 
   private:
@@ -0,0 +1,232 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "placement.hh"
+
+#include <cstdlib>
+#include <tuple>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "util/iterator.hh"
+#include "util/path.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+/* bytes per millisecond, between this machine and the storage backend */
+static constexpr size_t TRANSFER_RATE = 50'000;
+
+/* bytes per millisecond, from the storage backend to a remote worker */
+static constexpr size_t REMOTE_FETCH_RATE = 100'000;
+
+/* weight of a new sample in the moving average of an engine's latency */
+static constexpr milliseconds::rep LATENCY_SMOOTHING = 5; /* i.e. 1/5 */
+
+EnginePlacement::EnginePlacement( const PlacementPolicy policy,
+                                  StorageBackend * storage_backend )
+  : policy_( policy ), storage_backend_( storage_backend )
+{
+  const char * log_path = getenv( "GG_PLACEMENT_LOG" );
+
+  if ( log_path != nullptr ) {
+    log_ = make_unique<ofstream>( log_path );
+
+    if ( not log_->good() ) {
+      throw runtime_error( "could not open placement log: " + string( log_path ) );
+    }
+  }
+}
+
+bool EnginePlacement::has_locally( const string & hash ) const
+{
+  auto known = local_objects_.find( hash );
+
+  if ( known == local_objects_.end() ) {
+    known = local_objects_.emplace( hash, roost::exists( gg::paths::blob( hash ) ) ).first;
+  }
+
+  return known->second;
+}
+
+bool EnginePlacement::has_remotely( const string & hash ) const
+{
+  auto known = remote_objects_.find( hash );
+
+  if ( known == remote_objects_.end() ) {
+    known = remote_objects_.emplace( hash, storage_backend_ != nullptr and
+                                           storage_backend_->is_available( hash ) ).first;
+  }
+
+  return known->second;
+}
+
+milliseconds EnginePlacement::fetch_time( const ExecutionEngine & engine,
+                                          const Thunk & thunk ) const
+{
+  if ( engine.is_local() ) {
+    return 0ms;
+  }
+
+  return milliseconds { thunk.infiles_size() / REMOTE_FETCH_RATE };
+}
+
+milliseconds EnginePlacement::transfer_time( const ExecutionEngine & engine,
+                                             const Thunk & thunk ) const
+{
+  size_t missing_bytes = 0;
+
+  for ( const auto & item : join_containers( thunk.values(), thunk.executables() ) ) {
+    const bool present = engine.is_local() ? has_locally( item.first )
+                                           : has_remotely( item.first );
+
+    if ( not present ) {
+      missing_bytes += gg::hash::size( item.first );
+    }
+  }
+
+  return milliseconds { missing_bytes / TRANSFER_RATE } + fetch_time( engine, thunk );
+}
+
+milliseconds EnginePlacement::expected_time( const ExecutionEngine & engine,
+                                             const Thunk & thunk ) const
+{
+  milliseconds latency = 0ms;
+
+  auto stats = stats_.find( &engine );
+  if ( stats != stats_.end() ) {
+    latency = stats->second.latency;
+  }
+
+  milliseconds wait = 0ms;
+
+  if ( engine.job_count() >= engine.max_jobs() ) {
+    wait = latency * static_cast<milliseconds::rep>( engine.job_count() + 1 - engine.max_jobs() )
+                   / static_cast<milliseconds::rep>( engine.max_jobs() );
+  }
+
+  return wait + transfer_time( engine, thunk ) + latency;
+}
+
+ExecutionEngine *
+EnginePlacement::place( const Thunk & thunk,
+                        const vector<unique_ptr<ExecutionEngine>> & engines )
+{
+  ExecutionEngine * selected = nullptr;
+  tuple<bool, milliseconds> selected_key;
+  string log_line;
+
+  vector<ExecutionEngine *> candidates;
+
+  for ( const auto & engine : engines ) {
+    if ( engine->can_execute( thunk ) ) {
+      candidates.push_back( engine.get() );
+    }
+  }
+
+  /* with a single engine to pick from, there is nothing to estimate */
+  const bool estimate = policy_ == PlacementPolicy::CompletionTime and candidates.size() > 1;
+
+  for ( ExecutionEngine * engine : candidates ) {
+    const bool full = engine->job_count() >= engine->max_jobs();
+
+    if ( not estimate ) {
+      /* the first engine with a free slot, or the first one that's full */
+      if ( selected == nullptr or not full ) {
+        selected = engine;
+      }
+
+      if ( not full ) {
+        break;
+      }
+
+      continue;
+    }
+
+    /* a full engine is only picked if all of them are full; otherwise the
+       job would hold up the queue while another engine has room for it */
+    const tuple<bool, milliseconds> key { full, expected_time( *engine, thunk ) };
+
+    if ( log_ ) {
+      log_line += " " + engine->label() + "=" + to_string( get<1>( key ).count() )
+                  + ( full ? "ms(full)" : "ms" );
+    }
+
+    if ( selected == nullptr or key < selected_key ) {
+      selected = engine;
+      selected_key = key;
+    }
+  }
+
+  if ( selected != nullptr and selected->job_count() < selected->max_jobs() ) {
+    stats_[ selected ].placed++;
+
+    if ( log_ ) {
+      *log_ << thunk.hash() << " " << selected->label() << log_line << endl;
+    }
+  }
+
+  return selected;
+}
+
+void EnginePlacement::job_deferred( const ExecutionEngine & engine )
+{
+  EngineStats & stats = stats_[ &engine ];
+
+  if ( stats.placed > 0 ) {
+    stats.placed--;
+  }
+}
+
+void EnginePlacement::job_finished( const ExecutionEngine & engine,
+                                    const Thunk & thunk,
+                                    const vector<ThunkOutput> & outputs,
+                                    const milliseconds & runtime )
+{
+  for ( const auto & output : outputs ) {
+    if ( engine.is_remote() ) {
+      remote_objects_[ output.hash ] = true;
+    }
+
+    if ( engine.is_local() ) {
+      local_objects_[ output.hash ] = true;
+    }
+  }
+
+  EngineStats & stats = stats_[ &engine ];
+  const milliseconds latency = max( 0ms, runtime - fetch_time( engine, thunk ) );
+
+  if ( stats.samples == 0 ) {
+    stats.latency = latency;
+  }
+  else {
+    stats.latency += ( latency - stats.latency ) / LATENCY_SMOOTHING;
+  }
+
+  stats.samples++;
+}
+
+void EnginePlacement::object_uploaded( const string & hash )
+{
+  remote_objects_[ hash ] = true;
+}
+
+size_t EnginePlacement::placed_jobs( const ExecutionEngine & engine ) const
+{
+  auto stats = stats_.find( &engine );
+  return ( stats == stats_.end() ) ? 0 : stats->second.placed;
+}
+
+PlacementPolicy EnginePlacement::parse_policy( const string & name )
+{
+  if ( name == "first-fit" ) {
+    return PlacementPolicy::FirstFit;
+  }
+  else if ( name == "completion-time" ) {
+    return PlacementPolicy::CompletionTime;
+  }
+  else {
+    throw runtime_error( "unknown placement policy: " + name );
+  }
+}
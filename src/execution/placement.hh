@@ -0,0 +1,103 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef PLACEMENT_HH
+#define PLACEMENT_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+
+#include "engine.hh"
+#include "storage/backend.hh"
+#include "thunk/thunk.hh"
+
+enum class PlacementPolicy
+{
+  FirstFit,       /* the first engine with a free slot */
+  CompletionTime, /* the engine with the lowest expected completion time */
+};
+
+/* Decides which engine runs a job. The expected completion time of a job on
+   an engine is the sum of:
+
+   - the time to wait for a free slot, if the engine is full,
+   - the time to move the inputs that the engine doesn't have yet: the blobs
+     missing from this machine for a local engine, and, for a remote engine,
+     the inputs that the storage backend doesn't hold, plus fetching all of
+     the inputs from the storage backend, and
+   - the observed latency of the engine, i.e. the average time it has taken
+     to run a job, not counting the fetching of its inputs.
+
+   If the environment variable GG_PLACEMENT_LOG is set, every decision is
+   written to the file it names. */
+class EnginePlacement
+{
+private:
+  struct EngineStats
+  {
+    std::chrono::milliseconds latency { 0 };
+    size_t samples { 0 };
+    size_t placed { 0 };
+  };
+
+  const PlacementPolicy policy_;
+  StorageBackend * storage_backend_;
+
+  std::unordered_map<const ExecutionEngine *, EngineStats> stats_ {};
+
+  /* whether each input is on this machine, or in the storage backend, so
+     it's only looked up once; after that, the objects that show up are
+     learned from job_finished() and object_uploaded() */
+  mutable std::unordered_map<std::string, bool> local_objects_ {};
+  mutable std::unordered_map<std::string, bool> remote_objects_ {};
+
+  std::unique_ptr<std::ofstream> log_ {};
+
+  bool has_locally( const std::string & hash ) const;
+  bool has_remotely( const std::string & hash ) const;
+
+  std::chrono::milliseconds fetch_time( const ExecutionEngine & engine,
+                                        const gg::thunk::Thunk & thunk ) const;
+  std::chrono::milliseconds transfer_time( const ExecutionEngine & engine,
+                                           const gg::thunk::Thunk & thunk ) const;
+  std::chrono::milliseconds expected_time( const ExecutionEngine & engine,
+                                           const gg::thunk::Thunk & thunk ) const;
+
+public:
+  EnginePlacement( const PlacementPolicy policy,
+                   StorageBackend * storage_backend );
+
+  /* picks one of the engines that can execute the thunk, or returns nullptr
+     if there's none; the engine that is picked is full only if all of them
+     are, in which case the job should wait for it. nothing is estimated if
+     only one engine can execute the thunk. */
+  ExecutionEngine *
+  place( const gg::thunk::Thunk & thunk,
+         const std::vector<std::unique_ptr<ExecutionEngine>> & engines );
+
+  /* the job that was just placed on the engine will wait before it runs,
+     and will be placed again */
+  void job_deferred( const ExecutionEngine & engine );
+
+  /* called for every job that ran on a single engine and finished */
+  void job_finished( const ExecutionEngine & engine,
+                     const gg::thunk::Thunk & thunk,
+                     const std::vector<gg::ThunkOutput> & outputs,
+                     const std::chrono::milliseconds & runtime );
+
+  /* the object is in the storage backend now */
+  void object_uploaded( const std::string & hash );
+
+  size_t placed_jobs( const ExecutionEngine & engine ) const;
+
+  static PlacementPolicy parse_policy( const std::string & name );
+
+  /* forbid copying */
+  EnginePlacement( const EnginePlacement & other ) = delete;
+  EnginePlacement & operator=( const EnginePlacement & other ) = delete;
+};
+
+#endif /* PLACEMENT_HH */
@@ -7,10 +7,13 @@
 #include <iostream>
 #include <cmath>
 #include <numeric>
+#include <algorithm>
 #include <chrono>
+#include <csignal>
 
 #include "thunk/ggutils.hh"
 #include "thunk/thunk_reader.hh"
+#include "thunk/thunk_writer.hh"
 #include "net/s3.hh"
 #include "tui/status_bar.hh"
 #include "util/optional.hh"
@@ -18,6 +21,7 @@
 #include "util/timeit.hh"
 #include "util/path.hh"
 #include "util/digest.hh"
+#include "util/iterator.hh"
 
 using namespace std;
 using namespace gg;
@@ -53,7 +57,7 @@ void Reductor::print_status() const
 
     data << color_reset
          << "in queue: " << BOLD << COLOR_YELLOW  << setw( 5 ) << left
-         << job_queue_.size() << color_reset;
+         << job_queue_->size() << color_reset;
 
     for ( auto & ee : exec_engines_ ) {
       data << " " << ee->label() << " (" << ee->max_jobs() << "): "
@@ -61,6 +65,11 @@ void Reductor::print_status() const
            << color_reset;
     }
 
+    if ( uploader_ ) {
+      data << " uploading: " << BOLD << COLOR_YELLOW << setw( 5 ) << left
+           << uploader_->pending_count() << color_reset;
+    }
+
     data << " done: "  << BOLD << COLOR_GREEN << setw( 5 ) << left
          << finished_jobs_ << color_reset
          << " remaining: " << BOLD << COLOR_DEFAULT << dep_graph_.size();
@@ -83,43 +92,63 @@ Reductor::Reductor( const vector<string> & target_hashes,
                     std::unique_ptr<StorageBackend> && storage_backend,
                     const std::chrono::milliseconds default_timeout,
                     const size_t timeout_multiplier,
-                    const bool status_bar )
+                    const bool status_bar,
+                    const SchedulingPolicy scheduling_policy,
+                    const size_t loader_threads,
+                    const double hedging_percentile,
+                    const double hedging_budget,
+                    const PlacementPolicy placement_policy,
+                    const bool streaming_upload,
+                    const shared_ptr<const GraphSnapshot> & snapshot,
+                    const size_t graph_memory_limit,
+                    const bool fuse_chains )
   : target_hashes_( target_hashes ),
-    remaining_targets_(),
-    status_bar_( status_bar ), default_timeout_( default_timeout ),
+    status_bar_( status_bar ),
+    loader_threads_( loader_threads ),
+    fuse_chains_( fuse_chains ),
+    job_queue_( JobScheduler::create( scheduling_policy, dep_graph_ ) ),
+    hedging_( ( hedging_percentile > 0 )
+              ? make_unique<HedgingPolicy>( hedging_percentile, hedging_budget )
+              : nullptr ),
+    default_timeout_( default_timeout ),
     timeout_multiplier_( timeout_multiplier ),
     exec_engines_( move( execution_engines ) ),
     fallback_engines_( move( fallback_engines ) ),
-    storage_backend_( move( storage_backend ) )
+    storage_backend_( move( storage_backend ) ),
+    placement_( placement_policy, storage_backend_.get() )
 {
-  cerr << "\u2192 Loading the thunks... ";
-  auto graph_load_time = time_it<milliseconds>(
-    [this] ()
-    {
-      for ( const string & hash : target_hashes_ ) {
-        string inserted_hash = dep_graph_.add_thunk( hash );
-
-        if ( remaining_targets_.count( inserted_hash ) == 0) {
-          remaining_targets_.insert( move ( inserted_hash ) );
-          unordered_set<string> thunk_o1_deps = dep_graph_.order_one_dependencies( hash );
-          job_queue_.insert( job_queue_.end(), thunk_o1_deps.begin(), thunk_o1_deps.end() );
-        }
-      }
-    } ).count();
-
-  cerr << " done (" << graph_load_time << " ms)." << endl;
+  dep_graph_.set_snapshot( snapshot );
+  dep_graph_.set_memory_limit( graph_memory_limit, gg::paths::root().string() );
+
+  /* the reductions are looked up in memory, writing them out can wait */
+  gg::cache::set_batch_size( 128 );
+
+  /* the hedging thresholds are learned, and can be much shorter than the
+     default timeout */
+  if ( hedging_ and ( timeout_check_interval_ == 0s or
+                      timeout_check_interval_ > HEDGING_CHECK_INTERVAL ) ) {
+    timeout_check_interval_ = HEDGING_CHECK_INTERVAL;
+    next_timeout_check_ = Clock::now() + timeout_check_interval_;
+  }
 
   auto success_callback =
     [this] ( const string & old_hash, vector<ThunkOutput> && outputs, const float cost )
-    { finalize_execution( old_hash, move( outputs ), cost ); };
+    { finalize_execution( Hash( old_hash ), move( outputs ), cost ); };
 
   auto failure_callback =
     [this] ( const string & old_hash, const JobStatus failure_reason )
     {
+      /* the rest of a fused chain is retried with its first thunk, or on its
+         own if the first thunk is done */
+      if ( fused_thunks_.erase( Hash( old_hash ) ) ) {
+        return;
+      }
+
       switch ( failure_reason ) {
-      /* this is the only fatal failure */
+      /* this is the only failure that isn't retried */
       case JobStatus::ExecutionFailure:
-        throw runtime_error( "execution failed: " + old_hash );
+        thunk_failed( Hash( old_hash ) );
+        return;
 
       /* for all of the following cases, except default, we will push the failed
       job back into the queue */
@@ -156,7 +185,7 @@ Reductor::Reductor( const vector<string> & target_hashes,
       }
 
       /* let's retry */
-      job_queue_.push_back( old_hash );
+      job_queue_->push( Hash( old_hash ) );
     };
 
 
@@ -175,204 +204,915 @@ Reductor::Reductor( const vector<string> & target_hashes,
     fe->set_failure_callback( failure_callback );
     fe->init( exec_loop_ );
   }
+
+  /* the executions that return thunks don't wait for their subgraphs to be
+     read; the new thunks are scheduled as they come in. the local engine
+     forks, so with it, the thunks are read on this thread. */
+  forks_jobs_ = any_of( exec_engines_.begin(), exec_engines_.end(),
+                                  [] ( const unique_ptr<ExecutionEngine> & e ) { return e->is_local(); } )
+                          or any_of( fallback_engines_.begin(), fallback_engines_.end(),
+                                     [] ( const unique_ptr<ExecutionEngine> & e ) { return e->is_local(); } );
+
+  thunk_loader_ = make_unique<ThunkLoader>(
+    exec_loop_, forks_jobs_ ? 0 : loader_threads_,
+    [this] ( const Hash & hash ) { return dep_graph_.read_thunk( hash ); },
+    [this] ( const Hash & hash, Thunk && thunk ) { thunk_loaded( hash, move( thunk ) ); } );
+
+  dep_graph_.set_deferred_loading( true );
+
+  /* the uploader runs on a thread of its own, and the local engine can't
+     fork once there is more than one */
+  if ( streaming_upload and storage_backend_ and forks_jobs_ ) {
+    print_gg_message( "warning", "the local engine forks its jobs; "
+                                 "uploading the dependencies before the execution" );
+  }
+  else if ( streaming_upload and storage_backend_ ) {
+    uploader_ = make_unique<DependencyUploader>(
+      *storage_backend_, exec_loop_,
+      [this] ( const string & hash ) { dependency_uploaded( hash ); } );
+  }
+
+  if ( target_hashes_.empty() ) {
+    return;
+  }
+
+  cerr << "\u2192 Loading the thunks... ";
+  auto graph_load_time = time_it<milliseconds>(
+    [this] ()
+    {
+      add_request( target_hashes_,
+                   [this] ( vector<string> && final_hashes )
+                   { final_hashes_ = move( final_hashes ); },
+                   [] ( const string & error )
+                   { throw runtime_error( error ); } );
+    } ).count();
+
+  cerr << " done (" << graph_load_time << " ms)." << endl;
+}
+
+uint64_t Reductor::add_request( const vector<string> & target_hashes,
+                                const RequestSuccessCallbackFunc & success_callback,
+                                const RequestFailureCallbackFunc & failure_callback )
+{
+  const vector<Hash> added =
+    dep_graph_.add_thunks( vector<Hash>( target_hashes.begin(), target_hashes.end() ),
+                           loader_threads_ );
+
+  const uint64_t request_id = next_request_id_++;
+  Request request { {}, {}, {}, success_callback, failure_callback };
+
+  /* a target might be on its way already, for another request */
+  for ( const Hash & hash : added ) {
+    const Hash original = dep_graph_.original_hash( hash );
+    request.targets.push_back( original );
+
+    if ( request.remaining.insert( original ).second ) {
+      waiting_requests_[ original ].insert( request_id );
+    }
+  }
+
+  /* the whole graph must be loaded before the scheduler ranks anything */
+  job_queue_->push_all( dep_graph_.take_ready_thunks() );
+
+  if ( request.remaining.empty() ) {
+    success_callback( {} );
+  }
+  else {
+    requests_.emplace( request_id, move( request ) );
+  }
+
+  return request_id;
+}
+
+void Reductor::remove_request( const uint64_t request_id )
+{
+  requests_.erase( request_id );
+}
+
+string Reductor::final_hash( const Hash & original_hash ) const
+{
+  const Optional<Hash> answer = gg::cache::check( dep_graph_.updated_hash( original_hash ) );
+
+  if ( not answer.initialized() ) {
+    throw runtime_error( "internal error: final answer not found for "
+                         + original_hash.str() );
+  }
+
+  return answer->str();
+}
+
+void Reductor::target_merged( const Hash & old_hash, const Hash & new_hash )
+{
+  auto waiting = waiting_requests_.find( old_hash );
+
+  if ( waiting == waiting_requests_.end() ) {
+    return;
+  }
+
+  const unordered_set<uint64_t> request_ids { move( waiting->second ) };
+  waiting_requests_.erase( waiting );
+
+  for ( const uint64_t request_id : request_ids ) {
+    auto request = requests_.find( request_id );
+
+    if ( request == requests_.end() ) {
+      continue;
+    }
+
+    request->second.remaining.erase( old_hash );
+    replace( request->second.targets.begin(), request->second.targets.end(),
+             old_hash, new_hash );
+
+    if ( request->second.remaining.insert( new_hash ).second ) {
+      waiting_requests_[ new_hash ].insert( request_id );
+    }
+  }
+}
+
+void Reductor::target_reduced( const Hash & original_hash )
+{
+  auto waiting = waiting_requests_.find( original_hash );
+
+  if ( waiting == waiting_requests_.end() ) {
+    return;
+  }
+
+  const unordered_set<uint64_t> request_ids { move( waiting->second ) };
+  waiting_requests_.erase( waiting );
+
+  /* the graph forgets how the target got here once it's done */
+  const string answer = final_hash( original_hash );
+
+  for ( const uint64_t request_id : request_ids ) {
+    auto request = requests_.find( request_id );
+
+    /* it was removed, or one of its other targets failed */
+    if ( request == requests_.end() ) {
+      continue;
+    }
+
+    request->second.remaining.erase( original_hash );
+    request->second.answers[ original_hash ] = answer;
+
+    if ( request->second.remaining.empty() ) {
+      vector<string> final_hashes;
+
+      for ( const Hash & target : request->second.targets ) {
+        final_hashes.emplace_back( request->second.answers.at( target ) );
+      }
+
+      const RequestSuccessCallbackFunc callback = move( request->second.success_callback );
+      requests_.erase( request );
+      callback( move( final_hashes ) );
+    }
+  }
+}
+
+void Reductor::thunk_failed( const Hash & hash )
+{
+  auto job = running_jobs_.find( hash );
+
+  if ( job != running_jobs_.end() ) {
+    if ( job->second.launches.size() > 1 ) {
+      cancel_copies( hash, job->second );
+    }
+
+    running_jobs_.erase( job );
+  }
+
+  /* every request that is waiting on this thunk, or on a thunk that depends
+     on it, fails; then none of them is needed anymore, and a later request
+     that needs them loads them again */
+  vector<uint64_t> failed_requests;
+  unordered_set<Hash> visited { hash };
+  vector<Hash> to_visit { hash };
+
+  while ( not to_visit.empty() ) {
+    const Hash current { to_visit.back() };
+    to_visit.pop_back();
+
+    auto waiting = waiting_requests_.find( dep_graph_.original_hash( current ) );
+
+    if ( waiting != waiting_requests_.end() ) {
+      failed_requests.insert( failed_requests.end(), waiting->second.begin(),
+                              waiting->second.end() );
+      waiting_requests_.erase( waiting );
+    }
+
+    for ( const Hash & referencing : dep_graph_.referencing_thunks( current ) ) {
+      if ( visited.insert( referencing ).second ) {
+        to_visit.push_back( referencing );
+      }
+    }
+  }
+
+  for ( const uint64_t request_id : failed_requests ) {
+    auto request = requests_.find( request_id );
+
+    if ( request == requests_.end() ) {
+      continue;
+    }
+
+    const RequestFailureCallbackFunc callback = move( request->second.failure_callback );
+    requests_.erase( request );
+    callback( "execution failed: " + hash.str() );
+  }
+
+  dep_graph_.remove_thunks( visited );
+}
+
+void Reductor::cancel_copies( const Hash & hash, const JobInfo & job )
+{
+  const string hash_str = hash.str();
+  size_t count = 0;
+
+  for ( auto & engine : exec_engines_ ) {
+    count += engine->cancel( hash_str, exec_loop_ );
+  }
+
+  for ( auto & engine : fallback_engines_ ) {
+    count += engine->cancel( hash_str, exec_loop_ );
+  }
+
+  if ( count == 0 ) {
+    return;
+  }
+
+  /* we can't tell which copy finished. assuming that every copy needs as
+     long as the finished one did, a copy launched d after the first one would
+     have held its slot for another d; crediting the smallest offsets gives a
+     lower bound. */
+  vector<milliseconds> offsets;
+
+  for ( const auto & launch : job.launches ) {
+    offsets.push_back( duration_cast<milliseconds>( launch - job.launches.front() ) );
+  }
+
+  sort( offsets.begin(), offsets.end() );
+
+  for ( size_t i = 0; i < min( count, offsets.size() ); i++ ) {
+    reclaimed_slot_time_ += offsets[ i ];
+  }
+
+  cancelled_jobs_ += count;
 }
 
-void Reductor::finalize_execution( const string & old_hash,
+void Reductor::finalize_execution( const Hash & old_hash,
                                    vector<ThunkOutput> && outputs,
                                    const float cost )
 {
-  running_jobs_.erase( old_hash );
-  const string main_output_hash = outputs.at( 0 ).hash;
+  auto fused = fused_thunks_.find( old_hash );
 
-  Optional<unordered_set<string>> new_o1s = dep_graph_.force_thunk( old_hash, move ( outputs ) );
+  if ( fused != fused_thunks_.end() ) {
+    /* the graph has updated the thunk with the outputs of the thunk before
+       it, which the worker did too, and it's been queued under its new hash */
+    const Hash updated = dep_graph_.updated_hash( fused->second );
+    fused_thunks_.erase( fused );
+
+    if ( updated != old_hash ) {
+      for ( const auto & output : outputs ) {
+        gg::cache::insert( updated.with_tag( output.tag ), Hash( output.hash ) );
+      }
+
+      gg::cache::insert( updated, Hash( outputs.at( 0 ).hash ) );
+      finalize_execution( updated, move( outputs ), cost );
+      return;
+    }
+  }
+
+  auto job = running_jobs_.find( old_hash );
+
+  if ( job != running_jobs_.end() ) {
+    /* a fused job took as long as all of its thunks */
+    if ( dep_graph_.has_thunk( old_hash ) and job->second.chain_length == 1 ) {
+      const Thunk & thunk = dep_graph_.get_thunk( old_hash );
+      const auto now = Clock::now();
+
+      job_queue_->job_finished( thunk, duration_cast<milliseconds>( now - job->second.start ) );
+
+      /* only when there's no doubt about which engine ran it */
+      if ( job->second.launches.size() == 1 and job->second.engine != nullptr ) {
+        placement_.job_finished( *job->second.engine, thunk, outputs,
+                                 duration_cast<milliseconds>( now - job->second.start ) );
+      }
+
+      /* for a duplicated job, we can't tell which copy finished; counting from
+         the first launch errs on the side of fewer duplicates */
+      if ( hedging_ ) {
+        hedging_->job_finished( thunk.function().hash(),
+                                duration_cast<milliseconds>( now - job->second.launches.front() ) );
+      }
+    }
+
+    if ( job->second.launches.size() > 1 ) {
+      cancel_copies( old_hash, job->second );
+    }
+
+    running_jobs_.erase( job );
+  }
+
+  const Hash main_output_hash { outputs.at( 0 ).hash };
+  const Hash original_hash = dep_graph_.original_hash( old_hash );
+
+  /* when a thunk is reduced to a thunk that is already in the graph, the
+     graph only remembers the original hash of one of them */
+  Optional<Hash> merged_original_hash;
+
+  if ( main_output_hash.is_thunk() ) {
+    const Hash new_hash = main_output_hash.base();
+    Hash existing_hash = dep_graph_.updated_hash( new_hash );
+
+    /* the thunk might still be on its way in, for another execution */
+    auto known =
+      [this] ( const Hash & hash )
+      { return dep_graph_.has_thunk( hash ) or dep_graph_.is_reading( hash ); };
+
+    if ( not known( existing_hash ) ) {
+      existing_hash = new_hash;
+    }
+
+    if ( known( existing_hash ) ) {
+      merged_original_hash.reset( dep_graph_.original_hash( existing_hash ) );
+    }
+  }
+
+  Optional<unordered_set<Hash>> new_o1s = dep_graph_.force_thunk( old_hash, move ( outputs ) );
+  thunk_loader_->add( dep_graph_.take_thunks_to_read() );
   estimated_cost_ += cost;
 
   if ( new_o1s.initialized() ) {
-    job_queue_.insert( job_queue_.end(), new_o1s->begin(), new_o1s->end() );
+    job_queue_->push_all( *new_o1s );
 
-    if ( gg::hash::type( main_output_hash ) == gg::ObjectType::Value ) {
-      remaining_targets_.erase( dep_graph_.original_hash( old_hash ) );
+    finished_jobs_++;
+
+    if ( not main_output_hash.is_thunk() ) {
+      target_reduced( original_hash );
+      dep_graph_.forget_original( original_hash );
+    }
+    else if ( merged_original_hash.initialized() and
+              *merged_original_hash != original_hash ) {
+      target_merged( *merged_original_hash, original_hash );
     }
+  }
 
-    finished_jobs_++;
+  /* the thunks that were released might have ended up the same as others */
+  for ( const auto & merged : dep_graph_.take_merged_originals() ) {
+    target_merged( merged.first, merged.second );
   }
 }
 
-vector<string> Reductor::reduce()
+Poller::Result Reductor::step()
 {
-  while ( true ) {
-    while ( not job_queue_.empty() ) {
-      print_status();
+  while ( not job_queue_->empty() ) {
+    print_status();
 
-      const string thunk_hash { move( job_queue_.front() ) };
-      job_queue_.pop_front();
+    const Hash thunk_hash { job_queue_->pop() };
+
+    /* it'll be pushed again once its inputs are uploaded */
+    if ( parked_thunks_.count( thunk_hash ) ) {
+      continue;
+    }
 
-      /* don't bother executing gg-execute if it's in the cache */
-      Optional<ReductionResult> cache_entry;
+    /* don't bother executing gg-execute if it's in the cache */
+    Optional<Hash> cache_entry;
 
-      while ( true ) {
-        auto temp_cache_entry = gg::cache::check( cache_entry.initialized() ? cache_entry->hash
-                                                                            : thunk_hash );
+    while ( true ) {
+      auto temp_cache_entry = gg::cache::check( cache_entry.initialized() ? *cache_entry
+                                                                          : thunk_hash );
 
-        if ( temp_cache_entry.initialized() ) {
-          cache_entry = move( temp_cache_entry );
-        }
-        else {
-          break;
+      if ( temp_cache_entry.initialized() ) {
+        cache_entry = move( temp_cache_entry );
+      }
+      else {
+        break;
+      }
+    }
+
+    if ( cache_entry.initialized() ) {
+      const string thunk_hash_str = thunk_hash.str();
+      Thunk thunk { ThunkReader::read( gg::paths::blob( thunk_hash_str ), thunk_hash_str ) };
+      vector<ThunkOutput> new_outputs;
+
+      for ( const auto & tag : thunk.outputs() ) {
+        Optional<Hash> result = cache::check( thunk_hash.with_tag( tag ) );
+
+        if ( not result.initialized() ) {
+          throw runtime_error( "inconsistent cache entries" );
         }
+
+        new_outputs.emplace_back( result->str(), tag );
       }
 
-      if ( cache_entry.initialized() ) {
-        Thunk thunk { ThunkReader::read( gg::paths::blob( thunk_hash ), thunk_hash ) };
-        vector<ThunkOutput> new_outputs;
+      finalize_execution( thunk_hash, move( new_outputs ), 0 );
+    }
+    else {
+      const Thunk & thunk = dep_graph_.get_thunk( thunk_hash );
 
-        for ( const auto & tag : thunk.outputs() ) {
-          Optional<cache::ReductionResult> result = cache::check( gg::hash::for_output( thunk_hash, tag ) );
+      enum { CANNOT_BE_EXECUTED,
+             FULL_CAPACITY,
+             WAITING_FOR_UPLOAD,
+             EXECUTING } exec_state = CANNOT_BE_EXECUTED;
 
-          if ( not result.initialized() ) {
-            throw runtime_error( "inconsistent cache entries" );
-          }
+      ExecutionEngine * engine = placement_.place( thunk, exec_engines_ );
+      vector<Thunk> chain;
+
+      /* the job cannot be executed on any of the execution engines */
+      if ( engine == nullptr ) {
+        engine = placement_.place( thunk, fallback_engines_ );
+      }
 
-          new_outputs.emplace_back( result->hash, tag );
+      if ( engine != nullptr ) {
+        if ( engine->job_count() >= engine->max_jobs() ) {
+          exec_state = FULL_CAPACITY;
         }
+        else if ( engine->is_remote() and wait_for_inputs( thunk_hash, thunk ) ) {
+          placement_.job_deferred( *engine );
+          exec_state = WAITING_FOR_UPLOAD;
+        }
+        else {
+          if ( fuse_chains_ and engine->can_run_chains() ) {
+            chain = fuse_chain( thunk_hash, *engine );
+          }
 
-        finalize_execution( thunk_hash, move( new_outputs ), 0 );
-      }
-      else {
-        const Thunk & thunk = dep_graph_.get_thunk( thunk_hash );
-
-        enum { CANNOT_BE_EXECUTED,
-               FULL_CAPACITY,
-               FULL_FALLBACK_CAPACITY,
-               EXECUTING } exec_state = CANNOT_BE_EXECUTED;
-
-        for ( auto & exec_engine : exec_engines_ ) {
-          if ( exec_engine->can_execute( thunk ) ) {
-            if ( exec_engine->job_count() >= exec_engine->max_jobs() ) {
-              exec_state = FULL_CAPACITY;
-              continue;
-            }
-
-            exec_engine->force_thunk( thunk, exec_loop_ );
-            exec_state = EXECUTING;
-            break;
+          if ( chain.size() > 1 ) {
+            engine->force_chain( chain, exec_loop_ );
           }
+          else {
+            engine->force_thunk( thunk, exec_loop_ );
+          }
+
+          exec_state = EXECUTING;
         }
+      }
 
-        /* the job cannot be executed on any of the execution engines */
-        if ( exec_state == CANNOT_BE_EXECUTED ) {
-          for ( auto & fallback_engine : fallback_engines_ ) {
-            if ( fallback_engine->can_execute( thunk ) ) {
-              if ( fallback_engine->job_count() >= fallback_engine->max_jobs() ) {
-                exec_state = FULL_FALLBACK_CAPACITY;
-                continue;
-              }
+      if ( exec_state == EXECUTING ) {
+        JobInfo & job_info = running_jobs_[ thunk_hash ];
+        job_info.start = Clock::now();
+        job_info.chain_length = max<size_t>( chain.size(), 1 );
+        job_info.timeout = thunk.timeout() * timeout_multiplier_;
+        job_info.launches.push_back( job_info.start );
 
-              fallback_engine->force_thunk( thunk, exec_loop_ );
-              exec_state = EXECUTING;
-              break;
-            }
-          }
+        if ( job_info.launches.size() == 1 ) {
+          job_info.engine = engine;
         }
 
-        if ( exec_state == EXECUTING ) {
-          JobInfo & job_info = running_jobs_[ thunk_hash ];
-          job_info.start = Clock::now();
-          job_info.timeout = thunk.timeout() * timeout_multiplier_;
-          job_info.restarts++;
+        job_info.restarts++;
 
-          if ( job_info.timeout == 0s ) {
-            job_info.timeout = default_timeout_;
-          }
+        if ( job_info.timeout == 0s ) {
+          job_info.timeout = default_timeout_;
         }
-        else if ( exec_state == FULL_CAPACITY or exec_state == FULL_FALLBACK_CAPACITY ) {
-          job_queue_.push_front( thunk_hash );
-          break;
+
+        job_info.timeout *= job_info.chain_length;
+        job_info.hedged = false;
+
+        if ( hedging_ ) {
+          if ( job_info.launches.size() == 1 ) {
+            hedging_->job_launched();
+          }
+
+          const Optional<milliseconds> threshold =
+            hedging_->threshold( thunk.function().hash() );
+
+          if ( threshold.initialized() and job_info.chain_length == 1 ) {
+            job_info.timeout = *threshold;
+            job_info.hedged = true;
+          }
         }
-        else { /* CANNOT_BE_EXECUTED */
-          throw runtime_error( "no execution engine could execute " + thunk_hash );
+      }
+      else if ( exec_state == FULL_CAPACITY ) {
+        job_queue_->put_back( thunk_hash );
+        break;
+      }
+      else if ( exec_state == WAITING_FOR_UPLOAD ) {
+        /* the next jobs might have all of their inputs already */
+        continue;
+      }
+      else { /* CANNOT_BE_EXECUTED */
+        throw runtime_error( "no execution engine could execute " + thunk_hash.str() );
+      }
+    }
+  } /* while(Q is not empty) */
+
+  print_status();
+
+  const auto poll_result = exec_loop_.loop_once( timeout_check_interval_ == 0s
+                                                 ? -1
+                                                 : timeout_check_interval_.count() );
+  const auto clock_now = Clock::now();
+
+  if ( timeout_check_interval_ != 0s and clock_now >= next_timeout_check_ ) {
+    size_t count = 0;
+
+    for ( auto & job : running_jobs_ ) {
+      if ( job.second.timeout != 0ms and
+           ( clock_now - job.second.start ) > job.second.timeout ) {
+        /* a duplicate shouldn't hold up the jobs that are waiting for
+           their first run; the jobs that ran past their own timeout are
+           restarted regardless */
+        if ( job.second.hedged and ( not job_queue_->empty()
+                                     or not hedging_->try_duplicate() ) ) {
+          continue;
         }
+
+        job_queue_->push( job.first );
+        job.second.start = clock_now;
+        job.second.timeout += job.second.restarts * job.second.timeout;
+        job.second.restarts++;
+
+        count ++;
       }
-    } /* while(Q is not empty) */
+    }
 
-    print_status();
+    next_timeout_check_ += timeout_check_interval_;
+
+    if ( count > 0 ) {
+      print_gg_message( "info", "duplicating " + to_string( count ) +
+                                " job" + ( ( count == 1 ) ? "" : "s" ) );
+    }
+  }
+
+  return poll_result;
+}
 
-    const auto poll_result = exec_loop_.loop_once( timeout_check_interval_ == 0s
-                                                   ? -1
-                                                   : timeout_check_interval_.count() );
-    const auto clock_now = Clock::now();
+vector<string> Reductor::reduce()
+{
+  if ( target_hashes_.empty() ) {
+    return {};
+  }
 
-    if ( timeout_check_interval_ != 0s and clock_now >= next_timeout_check_ ) {
-      size_t count = 0;
+  while ( not final_hashes_.initialized() ) {
+    const auto poll_result = step();
 
-      for ( auto & job : running_jobs_ ) {
-        if ( job.second.timeout != 0ms and
-             ( clock_now - job.second.start ) > job.second.timeout ) {
-          job_queue_.push_back( job.first );
-          job.second.start = clock_now;
-          job.second.timeout += job.second.restarts * job.second.timeout;
-          job.second.restarts++;
+    if ( not final_hashes_.initialized() and
+         poll_result.result == Poller::Result::Type::Exit ) {
+      throw runtime_error( "unhandled poller failure happened, job is not finished" );
+    }
+  }
 
-          count ++;
-        }
+  if ( exec_engines_.size() + fallback_engines_.size() > 1 ) {
+    string message = "placed";
+
+    for ( const auto & engines : { &exec_engines_, &fallback_engines_ } ) {
+      for ( const auto & engine : *engines ) {
+        message += ( message.length() > 6 ? ", " : " " )
+                   + to_string( placement_.placed_jobs( *engine ) )
+                   + " on " + engine->label();
       }
+    }
 
-      next_timeout_check_ += timeout_check_interval_;
+    print_gg_message( "info", message );
+  }
 
-      if ( count > 0 ) {
-        print_gg_message( "info", "duplicating " + to_string( count ) +
-                                  " job" + ( ( count == 1 ) ? "" : "s" ) );
-      }
+  if ( cancelled_jobs_ > 0 ) {
+    ostringstream message;
+    message << "cancelled " << cancelled_jobs_ << " job cop"
+            << ( ( cancelled_jobs_ == 1 ) ? "y" : "ies" )
+            << ", reclaiming at least " << fixed << setprecision( 1 )
+            << ( reclaimed_slot_time_.count() / 1000.0 ) << " slot-seconds";
+    print_gg_message( "info", message.str() );
+  }
+
+  gg::cache::flush();
+  return move( *final_hashes_ );
+}
+
+
+void Reductor::serve( const string & socket_path )
+{
+  /* the socket might have been left behind by a daemon that is gone */
+  if ( roost::exists( socket_path ) ) {
+    bool in_use = true;
+
+    try {
+      IPCSocket {}.connect( socket_path );
+    }
+    catch ( const unix_error & ) {
+      in_use = false;
+    }
+
+    if ( in_use ) {
+      throw runtime_error( "another daemon is listening on " + socket_path );
     }
 
-    if ( is_finished() or poll_result.result == Poller::Result::Type::Exit ) {
-      if ( not is_finished() ) {
-        throw runtime_error( "unhandled poller failure happened, job is not finished" );
+    roost::remove( socket_path );
+  }
+
+  /* a client can hang up before its answer is written */
+  signal( SIGPIPE, SIG_IGN );
+
+  /* the transfers of one request shouldn't hold up the jobs of the others */
+  if ( storage_backend_ and not forks_jobs_ ) {
+    if ( not uploader_ ) {
+      uploader_ = make_unique<DependencyUploader>(
+        *storage_backend_, exec_loop_,
+        [this] ( const string & hash ) { dependency_uploaded( hash ); } );
+    }
+
+    downloader_ = make_unique<OutputDownloader>( *storage_backend_, exec_loop_ );
+  }
+
+  exec_loop_.make_ipc_listener( socket_path,
+    [this] ( ExecutionLoop & loop, FileDescriptor && socket )
+    {
+      auto buffer = make_shared<string>();
+      auto request_id = make_shared<Optional<uint64_t>>();
+
+      auto data_callback =
+        [this, buffer, request_id] ( shared_ptr<IPCConnection> connection, string && data )
+        {
+          buffer->append( data );
+          const size_t newline = buffer->find( '\n' );
+
+          /* one request per connection */
+          if ( newline == string::npos or request_id->initialized() ) {
+            return newline == string::npos;
+          }
+
+          vector<string> target_hashes;
+          istringstream line { buffer->substr( 0, newline ) };
+
+          for ( string hash; line >> hash; ) {
+            target_hashes.emplace_back( move( hash ) );
+          }
+
+          weak_ptr<IPCConnection> weak_connection { connection };
+
+          auto failure_callback =
+            [weak_connection] ( const string & error )
+            {
+              if ( auto connection = weak_connection.lock() ) {
+                connection->enqueue_write( "error " + error + "\n" );
+              }
+            };
+
+          auto success_callback =
+            [this, weak_connection, failure_callback] ( vector<string> && final_hashes )
+            {
+              string answer = "ok";
+
+              for ( const string & hash : final_hashes ) {
+                answer += " " + hash;
+              }
+
+              auto reply =
+                [weak_connection, answer] ()
+                {
+                  gg::cache::flush();
+
+                  if ( auto connection = weak_connection.lock() ) {
+                    connection->enqueue_write( answer + "\n" );
+                  }
+                };
+
+              if ( downloader_ ) {
+                downloader_->add( final_hashes, reply, failure_callback );
+              }
+              else {
+                download_targets( final_hashes );
+                reply();
+              }
+            };
+
+          try {
+            request_id->reset( add_request( target_hashes, success_callback,
+                                            failure_callback ) );
+            upload_dependencies( target_hashes );
+          }
+          catch ( const exception & e ) {
+            failure_callback( e.what() );
+          }
+
+          return true;
+        };
+
+      /* the jobs of a client that hangs up are left running for the others */
+      auto close_callback =
+        [this, request_id] ()
+        {
+          if ( request_id->initialized() ) {
+            remove_request( **request_id );
+          }
+        };
+
+      loop.add_connection<FileDescriptor>( move( socket ), data_callback,
+                                           [] () {}, close_callback );
+      return true;
+    } );
+
+  cerr << "Listening on " << socket_path << "." << endl;
+
+  while ( true ) {
+    const auto poll_result = step();
+
+    /* the loop has nothing left to listen on, not even the socket */
+    if ( poll_result.result == Poller::Result::Type::Exit ) {
+      if ( not requests_.empty() ) {
+        throw runtime_error( "unhandled poller failure happened, requests are not finished" );
       }
 
-      vector<string> final_hashes;
+      cerr << "Stopped listening on " << socket_path << "." << endl;
+      return;
+    }
+  }
+}
 
-      for ( const string & target_hash : target_hashes_ ) {
-        const string final_hash = dep_graph_.updated_hash( target_hash );
-        const Optional<ReductionResult> answer = gg::cache::check( final_hash );
-        if ( not answer.initialized() ) {
-          throw runtime_error( "internal error: final answer not found for " + target_hash );
-        }
-        final_hashes.emplace_back( answer->hash );
+vector<Thunk> Reductor::fuse_chain( const Hash & hash, const ExecutionEngine & engine )
+{
+  vector<Thunk> chain { dep_graph_.get_thunk( hash ) };
+  vector<Hash> originals;
+
+  auto uploading =
+    [this] ( const Thunk::DataItem & item )
+    { return uploader_ and uploader_->pending( item.first ); };
+
+  for ( Hash current = hash; chain.size() < MAX_CHAIN_LENGTH; ) {
+    const unordered_set<Hash> & consumers = dep_graph_.referencing_thunks( current );
+
+    if ( consumers.size() != 1 ) {
+      break;
+    }
+
+    const Hash next = *consumers.begin();
+    const Thunk & next_thunk = dep_graph_.get_thunk( next );
+
+    const bool waits_on_current_only =
+      all_of( next_thunk.thunks().begin(), next_thunk.thunks().end(),
+              [&current] ( const Thunk::DataItem & item )
+              { return Hash( item.first ).base() == current; } );
+
+    if ( not waits_on_current_only or
+         any_of( next_thunk.values().begin(), next_thunk.values().end(), uploading ) or
+         any_of( next_thunk.executables().begin(), next_thunk.executables().end(), uploading ) ) {
+      break;
+    }
+
+    /* the worker knows the thunk before it by the hash it's sent under,
+       which is different if the graph has updated that thunk */
+    const string previous_hash = ThunkWriter::write( chain.back() );
+    chain.push_back( next_thunk );
+
+    if ( previous_hash != current.str() ) {
+      vector<ThunkOutput> outputs;
+
+      for ( const auto & tag : chain[ chain.size() - 2 ].outputs() ) {
+        outputs.emplace_back( previous_hash, tag );
       }
 
-      return final_hashes;
+      chain.back().update_data( current.str(), outputs );
+    }
+
+    if ( not engine.can_execute_chain( chain ) ) {
+      chain.pop_back();
+      break;
+    }
+
+    originals.push_back( dep_graph_.original_hash( next ) );
+    current = next;
+  }
+
+  for ( size_t i = 1; i < chain.size(); i++ ) {
+    fused_thunks_[ Hash( ThunkWriter::write( chain[ i ] ) ) ] = originals[ i - 1 ];
+  }
+
+  return chain;
+}
+
+bool Reductor::wait_for_inputs( const Hash & hash, const Thunk & thunk )
+{
+  if ( not uploader_ ) {
+    return false;
+  }
+
+  size_t missing = 0;
+
+  for ( const auto & item : join_containers( thunk.values(), thunk.executables() ) ) {
+    if ( uploader_->pending( item.first ) ) {
+      upload_waiters_[ item.first ].push_back( hash );
+      uploader_->prioritize( item.first );
+      missing++;
     }
   }
+
+  if ( missing > 0 ) {
+    parked_thunks_[ hash ] = missing;
+  }
+
+  return missing > 0;
 }
 
-void Reductor::upload_dependencies() const
+void Reductor::dependency_uploaded( const string & hash )
+{
+  placement_.object_uploaded( hash );
+
+  auto waiters = upload_waiters_.find( hash );
+
+  if ( waiters == upload_waiters_.end() ) {
+    return;
+  }
+
+  for ( const Hash & thunk_hash : waiters->second ) {
+    auto parked = parked_thunks_.find( thunk_hash );
+
+    if ( --parked->second == 0 ) {
+      parked_thunks_.erase( parked );
+      job_queue_->push( thunk_hash );
+    }
+  }
+
+  upload_waiters_.erase( waiters );
+}
+
+void Reductor::thunk_loaded( const Hash & hash, Thunk && thunk )
+{
+  dep_graph_.add_loaded_thunk( hash, move( thunk ) );
+  thunk_loader_->add( dep_graph_.take_thunks_to_read() );
+  job_queue_->push_all( dep_graph_.take_ready_thunks() );
+}
+
+void Reductor::upload_dependencies( const vector<string> & target_hashes )
 {
   if ( storage_backend_ == nullptr ) {
     return;
   }
 
+  const unordered_set<string> value_dependencies = dep_graph_.take_value_dependencies();
+  const unordered_set<string> executable_dependencies =
+    dep_graph_.take_executable_dependencies();
+
+  if ( uploader_ ) {
+    /* the inputs of the thunks that can run right away go first */
+    vector<string> hashes;
+    unordered_set<string> seen;
+    size_t total_size = 0;
+
+    auto add_dependency =
+      [&] ( const string & dep )
+      {
+        if ( seen.insert( dep ).second and
+             not storage_backend_->is_available( dep ) ) {
+          total_size += gg::hash::size( dep );
+          hashes.push_back( dep );
+        }
+      };
+
+    for ( const string & target : target_hashes ) {
+      const Hash hash = dep_graph_.updated_hash( Hash( target ).base() );
+
+      if ( not dep_graph_.has_thunk( hash ) ) {
+        continue;
+      }
+
+      for ( const Hash & ready_hash : dep_graph_.order_one_dependencies( hash ) ) {
+        const Thunk & thunk = dep_graph_.get_thunk( ready_hash );
+
+        for ( const auto & item : join_containers( thunk.values(), thunk.executables() ) ) {
+          add_dependency( item.first );
+        }
+      }
+    }
+
+    for ( const string & dep : value_dependencies ) {
+      add_dependency( dep );
+    }
+
+    for ( const string & dep : executable_dependencies ) {
+      add_dependency( dep );
+    }
+
+    if ( hashes.size() == 0 ) {
+      cerr << "No files to upload." << endl;
+      return;
+    }
+
+    uploader_->add( hashes );
+
+    const string plural = hashes.size() == 1 ? "" : "s";
+    cerr << "\u2197 Uploading " << hashes.size() << " file" << plural
+         << " (" << format_bytes( total_size ) << ") in the background." << endl;
+    return;
+  }
+
   vector<storage::PutRequest> upload_requests;
   size_t total_size = 0;
 
-  for ( const string & dep : dep_graph_.value_dependencies() ) {
+  for ( const string & dep : value_dependencies ) {
     if ( storage_backend_->is_available( dep ) ) {
       continue;
     }
 
     total_size += gg::hash::size( dep );
     upload_requests.push_back( { gg::paths::blob( dep ), dep,
-                                 gg::hash::to_hex( dep ) } );
+                                 gg::hash::content_sha256( dep, gg::paths::blob( dep ) ) } );
   }
 
-  for ( const string & dep : dep_graph_.executable_dependencies() ) {
+  for ( const string & dep : executable_dependencies ) {
     if ( storage_backend_->is_available( dep ) ) {
       continue;
     }
 
     total_size += gg::hash::size( dep );
     upload_requests.push_back( { gg::paths::blob( dep ), dep,
-                                 gg::hash::to_hex( dep ) } );
+                                 gg::hash::content_sha256( dep, gg::paths::blob( dep ) ) } );
   }
 
   if ( upload_requests.size() == 0 ) {
@@ -395,6 +1135,10 @@ void Reductor::upload_dependencies() const
     }
   );
 
+  for ( const auto & request : upload_requests ) {
+    placement_.object_uploaded( request.object_key );
+  }
+
   cerr << "done (" << upload_time.count() << " ms)." << endl;
 }
 
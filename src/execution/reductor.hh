@@ -5,38 +5,85 @@
 
 #include <string>
 #include <vector>
-#include <deque>
 #include <memory>
 #include <chrono>
 #include <unordered_set>
 #include <unordered_map>
+#include <functional>
 
 #include "loop.hh"
 #include "engine.hh"
+#include "scheduler.hh"
+#include "hedging.hh"
+#include "placement.hh"
+#include "uploader.hh"
+#include "downloader.hh"
+#include "loader.hh"
 #include "thunk/graph.hh"
 #include "storage/backend.hh"
+#include "util/optional.hh"
 
 class Reductor
 {
+public:
+  typedef std::function<void( std::vector<std::string> && /* final hashes */ )> RequestSuccessCallbackFunc;
+  typedef std::function<void( const std::string & /* error */ )> RequestFailureCallbackFunc;
+
 private:
   using Clock = std::chrono::steady_clock;
 
+  /* a set of targets that someone is waiting on */
+  struct Request
+  {
+    /* by their original hashes */
+    std::vector<gg::Hash> targets;
+    std::unordered_set<gg::Hash> remaining {};
+
+    /* the final hashes of the targets that are done */
+    std::unordered_map<gg::Hash, std::string> answers {};
+    RequestSuccessCallbackFunc success_callback;
+    RequestFailureCallbackFunc failure_callback;
+  };
+
   struct JobInfo
   {
     Clock::time_point start {};
+    std::vector<Clock::time_point> launches {};
     std::chrono::milliseconds timeout { 0 };
     uint8_t restarts { std::numeric_limits<uint8_t>::max() };
+    ExecutionEngine * engine { nullptr }; /* of the first launch */
+    size_t chain_length { 1 }; /* of the last launch, if it was fused */
+    bool hedged { false }; /* the timeout is the hedging threshold */
   };
 
+  /* the longest chain of thunks that is fused into one job */
+  static constexpr size_t MAX_CHAIN_LENGTH = 16;
+
   const std::vector<std::string> target_hashes_;
-  std::unordered_set<std::string> remaining_targets_;
+  Optional<std::vector<std::string>> final_hashes_ {};
   bool status_bar_;
+  size_t loader_threads_;
+  bool fuse_chains_;
+
+  uint64_t next_request_id_ { 0 };
+  std::unordered_map<uint64_t, Request> requests_ {};
+
+  /* the requests that are waiting on each target, by its original hash */
+  std::unordered_map<gg::Hash, std::unordered_set<uint64_t>> waiting_requests_ {};
 
   ExecutionGraph dep_graph_ {};
 
-  std::deque<std::string> job_queue_ {};
-  std::unordered_map<std::string, JobInfo> running_jobs_ {};
+  std::unique_ptr<JobScheduler> job_queue_;
+  std::unique_ptr<HedgingPolicy> hedging_;
+  std::unordered_map<gg::Hash, JobInfo> running_jobs_ {};
+
+  /* the thunks that were sent after the first thunk of a fused chain, by
+     the hash they were sent with, with their original hashes. they are
+     updated in the graph once the thunk before them is done. */
+  std::unordered_map<gg::Hash, gg::Hash> fused_thunks_ {};
   size_t finished_jobs_ { 0 };
+  size_t cancelled_jobs_ { 0 };
+  std::chrono::milliseconds reclaimed_slot_time_ { 0 };
   float estimated_cost_ { 0.0 };
 
   std::chrono::milliseconds default_timeout_;
@@ -49,12 +96,53 @@ private:
   std::vector<std::unique_ptr<ExecutionEngine>> fallback_engines_;
 
   std::unique_ptr<StorageBackend> storage_backend_;
+  EnginePlacement placement_;
+
+  /* with streaming uploads, the jobs for remote engines wait for their
+     inputs here, with the number of inputs that are still being uploaded */
+  std::unique_ptr<DependencyUploader> uploader_ {};
+  std::unordered_map<gg::Hash, size_t> parked_thunks_ {};
+  std::unordered_map<std::string, std::vector<gg::Hash>> upload_waiters_ {};
+
+  /* the daemon downloads the outputs of the requests in the background */
+  std::unique_ptr<OutputDownloader> downloader_ {};
 
-  void finalize_execution( const std::string & old_hash,
+  /* reads the thunks that executions return, and what they depend on */
+  std::unique_ptr<ThunkLoader> thunk_loader_ {};
+
+  /* a process can't fork once it has other threads */
+  bool forks_jobs_ { false };
+
+  void finalize_execution( const gg::Hash & old_hash,
                            std::vector<gg::ThunkOutput> && outputs,
                            const float cost = 0.0 );
 
-  bool is_finished() const { return ( remaining_targets_.size() == 0 ); }
+  void cancel_copies( const gg::Hash & hash, const JobInfo & job );
+
+  void target_reduced( const gg::Hash & original_hash );
+
+  /* the requests that were waiting on the first target now wait on the
+     second one, which was reduced to the same thunk, and get its answer */
+  void target_merged( const gg::Hash & old_hash, const gg::Hash & new_hash );
+  void thunk_failed( const gg::Hash & hash );
+  std::string final_hash( const gg::Hash & original_hash ) const;
+
+  /* the ready thunk, followed by the thunks that only wait on the one
+     before them, and are the only ones that do, as far as the engine can
+     run them in one job; the ones after the first are written out, as the
+     graph might have updated them since they were read, and are recorded
+     in fused_thunks_ if there's more than one */
+  std::vector<gg::thunk::Thunk> fuse_chain( const gg::Hash & hash,
+                                            const ExecutionEngine & engine );
+
+  /* parks the thunk if some of its inputs are still being uploaded */
+  bool wait_for_inputs( const gg::Hash & hash, const gg::thunk::Thunk & thunk );
+  void dependency_uploaded( const std::string & hash );
+
+  void thunk_loaded( const gg::Hash & hash, gg::thunk::Thunk && thunk );
+
+  /* dispatches the ready jobs and waits for something to happen */
+  Poller::Result step();
 
 public:
   Reductor( const std::vector<std::string> & target_hashes,
@@ -63,10 +151,44 @@ public:
             std::unique_ptr<StorageBackend> && storage_backend,
             const std::chrono::milliseconds default_timeout = std::chrono::milliseconds { 0 },
             const size_t timeout_multiplier = 1,
-            const bool status_bar = false );
-
+            const bool status_bar = false,
+            const SchedulingPolicy scheduling_policy = SchedulingPolicy::FIFO,
+            const size_t loader_threads = 1,
+            const double hedging_percentile = 0,
+            const double hedging_budget = 0.1,
+            const PlacementPolicy placement_policy = PlacementPolicy::CompletionTime,
+            const bool streaming_upload = false,
+            const std::shared_ptr<const gg::thunk::GraphSnapshot> & snapshot = nullptr,
+            const size_t graph_memory_limit = 0,
+            const bool fuse_chains = false );
+
+  /* forces the targets given to the constructor */
   std::vector<std::string> reduce();
-  void upload_dependencies() const;
+
+  /* adds more targets to the graph, for the callback to be called once all
+     of them are reduced to values, or once one of them fails. returns the id
+     of the request. */
+  uint64_t add_request( const std::vector<std::string> & target_hashes,
+                        const RequestSuccessCallbackFunc & success_callback,
+                        const RequestFailureCallbackFunc & failure_callback );
+
+  /* the callbacks won't be called, but the jobs keep running */
+  void remove_request( const uint64_t request_id );
+
+  /* forces the requests that come through the unix domain socket at the
+     given path, until the process is killed or the socket is closed. a
+     request is a line with the hashes of the targets, separated by spaces;
+     the answer is a line with "ok" followed by the hashes of the outputs, or
+     "error" followed by the reason. */
+  void serve( const std::string & socket_path );
+
+  /* uploads the inputs of the thunks that were added since the last call.
+     with streaming uploads, this returns right away: the inputs of the
+     thunks that the given targets are waiting on, and that are ready, go
+     first, and each job is dispatched as soon as its own inputs are in the
+     storage backend */
+  void upload_dependencies() { upload_dependencies( target_hashes_ ); }
+  void upload_dependencies( const std::vector<std::string> & target_hashes );
   void download_targets( const std::vector<std::string> & hashes ) const;
   void print_status() const;
 };
@@ -32,19 +32,19 @@ ExecutionResponse ExecutionResponse::parse_message( const std::string & message
     return response;
   }
 
-  if ( response_proto.executed_thunks_size() != 1 ) {
-    throw runtime_error( "current implementation only supports one thunk execution per response" );
+  for ( const auto & executed_proto : response_proto.executed_thunks() ) {
+    ExecutedThunk executed { executed_proto.thunk_hash(), {} };
+
+    for ( const auto & output_proto : executed_proto.outputs() ) {
+      executed.outputs.push_back( { output_proto.tag(),
+                                    output_proto.hash(),
+                                    output_proto.size(),
+                                    output_proto.executable(),
+                                    output_proto.data() } );
+    }
+
+    response.executed_thunks.push_back( move( executed ) );
   }
 
-  for ( const auto & output_proto : response_proto.executed_thunks( 0 ).outputs() ) {
-    response.outputs.push_back( { output_proto.tag(),
-                                  output_proto.hash(),
-                                  output_proto.size(),
-                                  output_proto.executable(),
-                                  output_proto.data() } );
-  }
-
-  response.thunk_hash = response_proto.executed_thunks( 0 ).thunk_hash();
-
   return response;
 }
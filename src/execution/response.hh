@@ -40,14 +40,19 @@ public:
     std::string data;
   };
 
+  struct ExecutedThunk
+  {
+    std::string thunk_hash;
+    std::vector<Output> outputs;
+  };
+
 private:
   ExecutionResponse() {}
 
 public:
   JobStatus status {};
 
-  std::string thunk_hash {};
-  std::vector<Output> outputs {};
+  std::vector<ExecutedThunk> executed_thunks {};
 
   std::string stdout {};
 
@@ -0,0 +1,197 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "scheduler.hh"
+
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+unique_ptr<JobScheduler> JobScheduler::create( const SchedulingPolicy policy,
+                                               const ExecutionGraph & graph )
+{
+  switch ( policy ) {
+  case SchedulingPolicy::FIFO:
+    return make_unique<FIFOScheduler>();
+
+  case SchedulingPolicy::CriticalPath:
+    return make_unique<CriticalPathScheduler>( graph, false );
+
+  case SchedulingPolicy::MeasuredCriticalPath:
+    return make_unique<CriticalPathScheduler>( graph, true );
+
+  default:
+    throw runtime_error( "invalid scheduling policy" );
+  }
+}
+
+SchedulingPolicy JobScheduler::parse_policy( const string & name )
+{
+  if ( name == "fifo" ) {
+    return SchedulingPolicy::FIFO;
+  }
+  else if ( name == "critical-path" ) {
+    return SchedulingPolicy::CriticalPath;
+  }
+  else if ( name == "critical-path-measured" ) {
+    return SchedulingPolicy::MeasuredCriticalPath;
+  }
+  else {
+    throw runtime_error( "unknown scheduling policy: " + name );
+  }
+}
+
+Hash FIFOScheduler::pop()
+{
+  const Hash hash { queue_.front() };
+  queue_.pop_front();
+  return hash;
+}
+
+milliseconds CriticalPathScheduler::weight( const Hash & hash ) const
+{
+  const ExecutionGraph::Cost cost = graph_.cost( hash );
+
+  if ( use_measured_runtimes_ ) {
+    auto runtime = runtimes_.find( cost.function_hash );
+
+    if ( runtime != runtimes_.end() and runtime->second.ranked_average > 0ms ) {
+      return runtime->second.ranked_average;
+    }
+  }
+
+  /* thunks without a timeout count as one unit of work */
+  return max( 1ms, cost.timeout );
+}
+
+milliseconds CriticalPathScheduler::rank( const Hash & hash )
+{
+  if ( not graph_.has_thunk( hash ) ) {
+    return 0ms;
+  }
+
+  /* a thunk's rank needs the ranks of the thunks waiting on it, which are
+     computed first. the graph can be arbitrarily deep, so this keeps its
+     own stack; the second item says whether the thunk's parents have been
+     pushed already. */
+  vector<pair<Hash, bool>> stack { { hash, false } };
+
+  while ( not stack.empty() ) {
+    const Hash current = stack.back().first;
+
+    if ( ranks_.count( current ) ) {
+      stack.pop_back();
+      continue;
+    }
+
+    if ( not stack.back().second ) {
+      stack.back().second = true;
+
+      for ( const Hash & parent : graph_.referencing_thunks( current ) ) {
+        if ( graph_.has_thunk( parent ) and not ranks_.count( parent ) ) {
+          stack.emplace_back( parent, false );
+        }
+      }
+
+      continue;
+    }
+
+    stack.pop_back();
+    milliseconds max_parent_rank = 0ms;
+
+    for ( const Hash & parent : graph_.referencing_thunks( current ) ) {
+      auto parent_rank = ranks_.find( parent );
+
+      if ( parent_rank != ranks_.end() ) {
+        max_parent_rank = max( max_parent_rank, parent_rank->second );
+      }
+    }
+
+    ranks_.emplace( current, weight( current ) + max_parent_rank );
+  }
+
+  return ranks_.at( hash );
+}
+
+void CriticalPathScheduler::rerank()
+{
+  for ( auto & runtime : runtimes_ ) {
+    runtime.second.ranked_average = max( 1ms, runtime.second.average() );
+  }
+
+  ranks_.clear();
+
+  vector<Entry> entries;
+  entries.reserve( queue_.size() );
+
+  while ( not queue_.empty() ) {
+    entries.push_back( queue_.top() );
+    queue_.pop();
+  }
+
+  for ( Entry & entry : entries ) {
+    entry.rank = rank( entry.hash );
+    queue_.push( entry );
+  }
+
+  ranks_stale_ = false;
+}
+
+void CriticalPathScheduler::prune()
+{
+  for ( auto it = ranks_.begin(); it != ranks_.end(); ) {
+    if ( graph_.has_thunk( it->first ) ) {
+      it++;
+    }
+    else {
+      it = ranks_.erase( it );
+    }
+  }
+}
+
+void CriticalPathScheduler::push( const Hash & hash )
+{
+  /* a thunk that's done leaves the graph, and so do the old hashes of the
+     thunks that were reduced to other thunks */
+  if ( ranks_.size() > 2 * graph_.size() + 1024 ) {
+    prune();
+  }
+
+  queue_.push( { rank( hash ), next_order_++, hash } );
+}
+
+Hash CriticalPathScheduler::pop()
+{
+  if ( ranks_stale_ ) {
+    rerank();
+  }
+
+  const Hash hash { queue_.top().hash };
+  queue_.pop();
+  return hash;
+}
+
+void CriticalPathScheduler::job_finished( const Thunk & thunk,
+                                          const milliseconds & runtime )
+{
+  Runtime & entry = runtimes_[ thunk.function().hash() ];
+  entry.total += runtime;
+  entry.count++;
+
+  if ( not use_measured_runtimes_ ) {
+    return;
+  }
+
+  /* the first measurement of a function, and then a change of more than a
+     quarter, is worth putting the queue back in order for; the averages
+     settle quickly, so that doesn't happen often */
+  const milliseconds average = max( 1ms, entry.average() );
+  const milliseconds ranked = entry.ranked_average;
+
+  if ( ranked == 0ms or 4 * average > 5 * ranked or 4 * average < 3 * ranked ) {
+    ranks_stale_ = true;
+  }
+}
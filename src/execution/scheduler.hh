@@ -0,0 +1,142 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SCHEDULER_HH
+#define SCHEDULER_HH
+
+#include <string>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+
+#include "thunk/graph.hh"
+#include "thunk/hash.hh"
+#include "thunk/thunk.hh"
+
+enum class SchedulingPolicy
+{
+  FIFO,                 /* in the order the thunks became ready */
+  CriticalPath,         /* longest path to a target, weighted by timeouts */
+  MeasuredCriticalPath, /* same, but weighted by the observed runtimes */
+};
+
+/* decides the order in which the ready thunks are dispatched */
+class JobScheduler
+{
+public:
+  virtual void push( const gg::Hash & hash ) = 0;
+  virtual gg::Hash pop() = 0;
+
+  /* puts back a job that was popped, but couldn't be dispatched */
+  virtual void put_back( const gg::Hash & hash ) { push( hash ); }
+
+  virtual bool empty() const = 0;
+  virtual size_t size() const = 0;
+
+  /* called for every job that finished executing on an engine */
+  virtual void job_finished( const gg::thunk::Thunk &,
+                             const std::chrono::milliseconds & ) {}
+
+  template<class Container>
+  void push_all( const Container & hashes )
+  {
+    for ( const gg::Hash & hash : hashes ) { push( hash ); }
+  }
+
+  static std::unique_ptr<JobScheduler> create( const SchedulingPolicy policy,
+                                               const ExecutionGraph & graph );
+
+  static SchedulingPolicy parse_policy( const std::string & name );
+
+  virtual ~JobScheduler() {}
+};
+
+class FIFOScheduler : public JobScheduler
+{
+private:
+  std::deque<gg::Hash> queue_ {};
+
+public:
+  void push( const gg::Hash & hash ) override { queue_.push_back( hash ); }
+  void put_back( const gg::Hash & hash ) override { queue_.push_front( hash ); }
+  gg::Hash pop() override;
+
+  bool empty() const override { return queue_.empty(); }
+  size_t size() const override { return queue_.size(); }
+};
+
+/* Orders the ready thunks by the length of the longest path from them to any
+   of the targets. The length of a path is the sum of the weights of the thunks
+   on it; a thunk weighs as much as its timeout, or, when measured runtimes are
+   used, as much as the average runtime of the jobs that ran its function.
+
+   The ranks are memoized. With measured runtimes, once the average of some
+   function has moved far enough from the one the ranks were computed with,
+   they're all computed again, and the queue is put back in order. */
+class CriticalPathScheduler : public JobScheduler
+{
+private:
+  struct Entry
+  {
+    std::chrono::milliseconds rank;
+    uint64_t order;
+    gg::Hash hash;
+
+    /* higher rank first, then first come, first served */
+    bool operator<( const Entry & other ) const
+    {
+      return ( rank != other.rank ) ? ( rank < other.rank )
+                                    : ( order > other.order );
+    }
+  };
+
+  struct Runtime
+  {
+    std::chrono::milliseconds total { 0 };
+    size_t count { 0 };
+
+    /* the average that the ranks were computed with; 0 if there was none */
+    std::chrono::milliseconds ranked_average { 0 };
+
+    std::chrono::milliseconds average() const
+    { return total / static_cast<std::chrono::milliseconds::rep>( count ); }
+  };
+
+  const ExecutionGraph & graph_;
+  const bool use_measured_runtimes_;
+
+  std::priority_queue<Entry> queue_ {};
+  uint64_t next_order_ { 0 };
+
+  std::unordered_map<gg::Hash, std::chrono::milliseconds> ranks_ {};
+  std::unordered_map<std::string, Runtime> runtimes_ {};
+  bool ranks_stale_ { false };
+
+  std::chrono::milliseconds weight( const gg::Hash & hash ) const;
+  std::chrono::milliseconds rank( const gg::Hash & hash );
+
+  /* computes the ranks again, with the current averages */
+  void rerank();
+
+  /* forgets the ranks of the thunks that have left the graph */
+  void prune();
+
+public:
+  CriticalPathScheduler( const ExecutionGraph & graph,
+                         const bool use_measured_runtimes )
+    : graph_( graph ), use_measured_runtimes_( use_measured_runtimes )
+  {}
+
+  void push( const gg::Hash & hash ) override;
+  gg::Hash pop() override;
+
+  bool empty() const override { return queue_.empty(); }
+  size_t size() const override { return queue_.size(); }
+
+  void job_finished( const gg::thunk::Thunk & thunk,
+                     const std::chrono::milliseconds & runtime ) override;
+};
+
+#endif /* SCHEDULER_HH */
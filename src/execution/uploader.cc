@@ -0,0 +1,177 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "uploader.hh"
+
+#include "thunk/ggutils.hh"
+#include "util/pipe.hh"
+
+using namespace std;
+
+DependencyUploader::DependencyUploader( StorageBackend & backend,
+                                        ExecutionLoop & exec_loop,
+                                        const UploadedCallbackFunc & uploaded_callback )
+  : DependencyUploader( backend, exec_loop, uploaded_callback, make_pipe() )
+{}
+
+DependencyUploader::DependencyUploader( StorageBackend & backend,
+                                        ExecutionLoop & exec_loop,
+                                        const UploadedCallbackFunc & uploaded_callback,
+                                        pair<FileDescriptor, FileDescriptor> && pipe )
+  : backend_( backend ), uploaded_callback_( uploaded_callback ),
+    notify_fd_( move( pipe.second ) )
+{
+  exec_loop.add_connection<FileDescriptor>(
+    move( pipe.first ),
+    [this] ( shared_ptr<IPCConnection>, string && data )
+    {
+      process_notifications( move( data ) );
+      return true;
+    },
+    [] () { throw runtime_error( "error reading upload notifications" ); } );
+
+  thread_ = thread( &DependencyUploader::upload_loop, this );
+}
+
+DependencyUploader::~DependencyUploader()
+{
+  {
+    unique_lock<mutex> lock { mutex_ };
+    stopping_ = true;
+  }
+
+  queue_changed_.notify_all();
+
+  /* the batch that is being uploaded is allowed to finish */
+  if ( thread_.joinable() ) {
+    thread_.join();
+  }
+}
+
+void DependencyUploader::add( const vector<string> & hashes )
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  for ( const string & hash : hashes ) {
+    if ( pending_.insert( hash ).second ) {
+      queue_.push_back( hash );
+      queued_.insert( hash );
+    }
+  }
+
+  lock.unlock();
+  queue_changed_.notify_all();
+}
+
+void DependencyUploader::prioritize( const string & hash )
+{
+  if ( not pending( hash ) ) {
+    return;
+  }
+
+  unique_lock<mutex> lock { mutex_ };
+
+  /* the copy left in the normal queue is skipped once it's taken */
+  if ( queued_.count( hash ) ) {
+    urgent_queue_.push_back( hash );
+  }
+}
+
+vector<string> DependencyUploader::next_batch()
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  queue_changed_.wait( lock,
+    [this] { return stopping_ or not queued_.empty(); } );
+
+  vector<string> batch;
+  size_t batch_bytes = 0;
+
+  if ( stopping_ ) {
+    return batch;
+  }
+
+  for ( deque<string> * queue : { &urgent_queue_, &queue_ } ) {
+    while ( not queue->empty() and batch.size() < MAX_BATCH_OBJECTS
+            and batch_bytes < MAX_BATCH_BYTES ) {
+      const string hash = move( queue->front() );
+      queue->pop_front();
+
+      if ( queued_.erase( hash ) == 0 ) {
+        continue; /* it was prioritized and has already been taken */
+      }
+
+      batch_bytes += gg::hash::size( hash );
+      batch.push_back( hash );
+    }
+  }
+
+  return batch;
+}
+
+void DependencyUploader::upload_loop()
+{
+  while ( true ) {
+    const vector<string> batch = next_batch();
+
+    if ( batch.empty() ) {
+      return;
+    }
+
+    vector<storage::PutRequest> requests;
+
+    for ( const string & hash : batch ) {
+      requests.push_back( { gg::paths::blob( hash ), hash,
+                            gg::hash::content_sha256( hash, gg::paths::blob( hash ) ) } );
+    }
+
+    try {
+      backend_.put(
+        requests,
+        [this] ( const storage::PutRequest & request )
+        {
+          backend_.set_available( request.object_key );
+          notify( "+" + request.object_key );
+        }
+      );
+    }
+    catch ( ... ) {
+      {
+        unique_lock<mutex> lock { mutex_ };
+        error_ = current_exception();
+      }
+
+      notify( "!" );
+      return;
+    }
+  }
+}
+
+void DependencyUploader::notify( const string & line )
+{
+  unique_lock<mutex> lock { notify_mutex_ };
+  notify_fd_.write( line + "\n" );
+}
+
+void DependencyUploader::process_notifications( string && data )
+{
+  notifications_.append( data );
+
+  size_t line_start = 0;
+  size_t line_end;
+
+  while ( ( line_end = notifications_.find( '\n', line_start ) ) != string::npos ) {
+    const string line = notifications_.substr( line_start, line_end - line_start );
+    line_start = line_end + 1;
+
+    if ( line == "!" ) {
+      unique_lock<mutex> lock { mutex_ };
+      rethrow_exception( error_ );
+    }
+
+    const string hash = line.substr( 1 );
+    pending_.erase( hash );
+    uploaded_callback_( hash );
+  }
+
+  notifications_.erase( 0, line_start );
+}
@@ -0,0 +1,86 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef UPLOADER_HH
+#define UPLOADER_HH
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "loop.hh"
+#include "storage/backend.hh"
+#include "util/file_descriptor.hh"
+
+/* Uploads the dependencies to the storage backend on a background thread,
+   while the jobs that already have their inputs run. The objects that are
+   prioritized go before the rest. Every object that lands in the storage
+   backend is reported through a pipe that the execution loop reads, so the
+   callback is always called on the loop's thread. */
+class DependencyUploader
+{
+public:
+  typedef std::function<void( const std::string & )> UploadedCallbackFunc;
+
+private:
+  static constexpr size_t MAX_BATCH_OBJECTS = 32;
+  static constexpr size_t MAX_BATCH_BYTES = 16 * 1024 * 1024;
+
+  StorageBackend & backend_;
+  UploadedCallbackFunc uploaded_callback_;
+
+  /* touched only by the loop's thread */
+  std::unordered_set<std::string> pending_ {};
+  std::string notifications_ {};
+
+  /* shared with the upload thread */
+  std::mutex mutex_ {};
+  std::condition_variable queue_changed_ {};
+  std::deque<std::string> urgent_queue_ {};
+  std::deque<std::string> queue_ {};
+  std::unordered_set<std::string> queued_ {};
+  std::exception_ptr error_ {};
+  bool stopping_ { false };
+
+  /* the write end of the pipe, shared by the threads of the backend */
+  std::mutex notify_mutex_ {};
+  FileDescriptor notify_fd_;
+
+  std::thread thread_ {};
+
+  DependencyUploader( StorageBackend & backend, ExecutionLoop & exec_loop,
+                      const UploadedCallbackFunc & uploaded_callback,
+                      std::pair<FileDescriptor, FileDescriptor> && pipe );
+
+  std::vector<std::string> next_batch();
+  void upload_loop();
+  void notify( const std::string & line );
+  void process_notifications( std::string && data );
+
+public:
+  DependencyUploader( StorageBackend & backend, ExecutionLoop & exec_loop,
+                      const UploadedCallbackFunc & uploaded_callback );
+  ~DependencyUploader();
+
+  /* queues the objects, in order, unless they are already queued */
+  void add( const std::vector<std::string> & hashes );
+
+  /* moves the object to the front of the queue */
+  void prioritize( const std::string & hash );
+
+  /* true if the object is queued or being uploaded */
+  bool pending( const std::string & hash ) const { return pending_.count( hash ) > 0; }
+  size_t pending_count() const { return pending_.size(); }
+
+  /* forbid copying */
+  DependencyUploader( const DependencyUploader & other ) = delete;
+  DependencyUploader & operator=( const DependencyUploader & other ) = delete;
+};
+
+#endif /* UPLOADER_HH */
@@ -1,9 +1,11 @@
 /* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
 
 #include <iostream>
+#include <vector>
 
 #include "thunk/ggutils.hh"
 #include "util/exception.hh"
+#include "util/parallel.hh"
 #include "util/path.hh"
 
 using namespace std;
@@ -28,16 +30,21 @@ int main( int argc, char * argv[] )
 
     gg::paths::blobs(); // Trigger the exception if GG_DIR is not set.
 
-    for ( int i = 1; i < argc; i++ ) {
-      roost::path src { argv[ i ] };
-      string hash = gg::hash::file( src );
-      roost::path dst = gg::paths::blob( hash );
+    const vector<roost::path> sources { argv + 1, argv + argc };
+    const vector<string> hashes = gg::hash::files( sources );
 
-      if ( not roost::exists( dst ) ) {
-        const mode_t permission = roost::is_executable( src ) ? 0500 : 0400;
-        roost::copy_then_rename( src, dst, true, permission );
-      }
+    parallel_for( sources.size(), io_thread_count(),
+      [&] ( const size_t i )
+      {
+        const roost::path dst = gg::paths::blob( hashes[ i ] );
 
+        if ( not roost::exists( dst ) ) {
+          const mode_t permission = roost::is_executable( sources[ i ] ) ? 0500 : 0400;
+          roost::copy_then_rename( sources[ i ], dst, true, permission );
+        }
+      } );
+
+    for ( const string & hash : hashes ) {
       cout << hash << endl;
     }
 
@@ -12,6 +12,7 @@
 #include "net/http_request.hh"
 #include "net/http_response.hh"
 #include "net/http_request_parser.hh"
+#include "execution/blob_collector.hh"
 #include "execution/loop.hh"
 #include "thunk/ggutils.hh"
 #include "thunk/thunk.hh"
@@ -72,6 +73,7 @@ int main( int argc, char * argv[] )
     Address listen_addr { argv[ 1 ], static_cast<uint16_t>( port_argv ) };
 
     ExecutionLoop loop;
+    BlobCollector blob_collector { loop, BlobCollector::worker_budget() };
 
     loop.make_listener( listen_addr,
       [] ( ExecutionLoop & loop, TCPSocket && socket ) {
@@ -92,7 +94,7 @@ int main( int argc, char * argv[] )
               if ( http_request.first_line().compare( 0, reset_line.length(), reset_line ) == 0 ) {
                 /* the user wants us to clean up the .gg directory */
                 roost::empty_directory( gg::paths::blobs() );
-                roost::empty_directory( gg::paths::reductions() );
+                gg::cache::clear();
                 // XXX roost::empty_directory( gg::paths::remotes() );
                 cerr << "cleared" << endl;
 
@@ -4,13 +4,17 @@
 #include <string>
 #include <memory>
 #include <sys/fcntl.h>
+#include <sys/prctl.h>
+#include <csignal>
 #include <getopt.h>
 #include <vector>
 #include <unordered_set>
+#include <algorithm>
 
 #include "execution/response.hh"
 #include "net/requests.hh"
 #include "storage/backend.hh"
+#include "thunk/blob_gc.hh"
 #include "thunk/ggutils.hh"
 #include "thunk/factory.hh"
 #include "thunk/thunk_reader.hh"
@@ -34,34 +38,51 @@ const bool sandboxed = ( getenv( "GG_SANDBOXED" ) != NULL );
 const string temp_dir_template = "/tmp/thunk-execute";
 const string temp_file_template = "/tmp/thunk-file";
 
-vector<string> execute_thunk( const Thunk & original_thunk )
+/* a thunk that comes after the thunks it depends on, in a chain, is reduced
+   to an executable thunk using their reductions. returns false if one of them
+   wasn't reduced to a value, e.g. if it returned a thunk. */
+bool reduce_from_cache( Thunk & thunk )
 {
-  Thunk thunk = original_thunk;
-
-  // if ( not thunk.can_be_executed() ) {
-  //   /* Let's see if we can redudce this thunk to an order one thunk by updating
-  //   the infiles */
-  //   for ( const Thunk::DataItem & dep_item : thunk.thunks() ) {
-  //     /* let's check if we have a reduction of this infile */
-  //     vector<ThunkOutput> new_outputs;
-  //
-  //     auto result = gg::cache::check( dep_item.first );
-  //
-  //     if ( not result.initialized() or
-  //          gg::hash::type( result->hash ) == gg::ObjectType::Thunk ) {
-  //       throw runtime_error( "thunk is not executable and cannot be "
-  //                            "reduced to an executable thunk" );
-  //     }
-  //
-  //     thunk.update_data( dep_item.first, result->hash );
-  //   }
-  //
-  //   thunk.set_hash( ThunkWriter::write( thunk ) );
-  //
-  //   cerr << "thunk:" << original_thunk.hash() << " reduced to "
-  //        << "thunk:" << thunk.hash() << "." << endl;
-  // }
+  vector<string> dependencies;
 
+  for ( const Thunk::DataItem & item : thunk.thunks() ) {
+    const string base = gg::hash::base( item.first );
+
+    if ( find( dependencies.begin(), dependencies.end(), base ) == dependencies.end() ) {
+      dependencies.push_back( base );
+    }
+  }
+
+  for ( const string & dependency : dependencies ) {
+    const roost::path dependency_path = gg::paths::blob( dependency );
+
+    if ( not roost::exists( dependency_path ) ) {
+      return false;
+    }
+
+    const Thunk dependency_thunk = ThunkReader::read( dependency_path, dependency );
+    vector<ThunkOutput> outputs;
+
+    for ( const string & tag : dependency_thunk.outputs() ) {
+      auto result = gg::cache::check( gg::hash::for_output( dependency, tag ) );
+
+      if ( not result.initialized() or
+           gg::hash::type( result->hash ) == gg::ObjectType::Thunk ) {
+        return false;
+      }
+
+      outputs.emplace_back( result->hash, tag );
+    }
+
+    thunk.update_data( dependency, outputs );
+  }
+
+  ThunkWriter::write( thunk );
+  return thunk.can_be_executed();
+}
+
+vector<string> execute_thunk( const Thunk & original_thunk, const Thunk & thunk )
+{
   /* when executing the thunk, we create a temp directory, and execute the thunk
      in that directory. then we take the outfile, compute the hash, and move it
      to the .gg directory. */
@@ -83,6 +104,8 @@ vector<string> execute_thunk( const Thunk & original_thunk )
     ChildProcess process {
       thunk.hash(),
       [thunk, &exec_dir_path]() {
+        /* if we're killed (e.g. the job was cancelled), so is the function */
+        CheckSystemCall( "prctl", prctl( PR_SET_PDEATHSIG, SIGKILL ) );
         CheckSystemCall( "chdir", chdir( exec_dir_path.string().c_str() ) );
         return thunk.execute();
       }
@@ -109,6 +132,7 @@ vector<string> execute_thunk( const Thunk & original_thunk )
       exec_dir_path.string(),
       allowed_files,
       [thunk]() {
+        CheckSystemCall( "prctl", prctl( PR_SET_PDEATHSIG, SIGKILL ) );
         return thunk.execute();
       },
       [&exec_dir_path] () {
@@ -172,25 +196,44 @@ vector<string> execute_thunk( const Thunk & original_thunk )
   return output_hashes;
 }
 
-void do_cleanup( const Thunk & thunk )
+/* keeps the given thunks and their inputs, so that the thunks later in the
+   list are still there when their turn comes, and as many of the most
+   recently used blobs as fit in GG_BLOB_BUDGET (none, if it's not set) */
+void do_cleanup( const vector<Thunk> & thunks )
 {
   unordered_set<string> infile_hashes;
 
-  infile_hashes.emplace( thunk.hash() );
+  for ( const Thunk & thunk : thunks ) {
+    infile_hashes.emplace( thunk.hash() );
 
-  for ( const Thunk::DataItem & item : thunk.values() ) {
-    infile_hashes.emplace( item.first );
+    for ( const auto & item : thunk.values() ) {
+      infile_hashes.emplace( item.first );
+    }
+
+    for ( const auto & item : thunk.executables() ) {
+      infile_hashes.emplace( item.first );
+    }
   }
 
-  for ( const Thunk::DataItem & item : thunk.executables() ) {
-    infile_hashes.emplace( item.first );
+  const Optional<uint64_t> budget = gg::blobs::budget();
+
+  if ( budget.initialized() ) {
+    gg::blobs::collect( *budget, infile_hashes, gg::blobs::in_use_window );
   }
+  else {
+    gg::blobs::collect( 0, infile_hashes );
+  }
+}
 
-  for ( const string & blob : roost::list_directory( gg::paths::blobs() ) ) {
-    const roost::path path = gg::paths::blob( blob );
-    if ( ( not roost::is_directory( path ) ) and infile_hashes.count( blob ) == 0 ) {
-      roost::remove( path );
-    }
+/* with a budget, the blobs that are used are kept the longest */
+void touch_inputs( const Thunk & thunk )
+{
+  for ( const auto & item : thunk.values() ) {
+    gg::blobs::touch( item.first );
+  }
+
+  for ( const auto & item : thunk.executables() ) {
+    gg::blobs::touch( item.first );
   }
 }
 
@@ -202,12 +245,13 @@ void fetch_dependencies( unique_ptr<StorageBackend> & storage_backend,
     bool executables = false;
 
     auto check_dep =
-      [&download_items, &executables]( const Thunk::DataItem & item ) -> void
+      [&download_items, &executables]( const Thunk::DataList::reference & item ) -> void
       {
         const auto target_path = gg::paths::blob( item.first );
 
         if ( not roost::exists( target_path )
-             or roost::file_size( target_path ) != gg::hash::size( item.first ) ) {
+             or static_cast<uint64_t>( roost::file_size( target_path ) )
+                != gg::hash::size( item.first ) ) {
           if ( executables ) {
             download_items.push_back( { item.first, target_path, 0544 } );
           }
@@ -240,7 +284,8 @@ void upload_output( unique_ptr<StorageBackend> & storage_backend,
     vector<storage::PutRequest> requests;
     for ( const string & output_hash : output_hashes ) {
       requests.push_back( { gg::paths::blob( output_hash ), output_hash,
-                            gg::hash::to_hex( output_hash ) } );
+                            gg::hash::content_sha256( output_hash,
+                                                       gg::paths::blob( output_hash ) ) } );
     }
     storage_backend->put( requests );
   }
@@ -256,7 +301,8 @@ void usage( const char * argv0 )
   << "Options: " << endl
   << " -g, --get-dependencies  Fetch the missing dependencies from the remote storage" << endl
   << " -p, --put-output        Upload the output to the remote storage" << endl
-  << " -C, --cleanup           Remove unnecessary blobs in .gg dir" << endl
+  << " -C, --cleanup           Remove unnecessary blobs in .gg dir, keeping the" << endl
+  << "                          most recently used ones within GG_BLOB_BUDGET" << endl
   << " -T, --timelog           Produce timing log for this execution" << endl
   << endl;
 }
@@ -318,7 +364,25 @@ int main( int argc, char * argv[] )
 
     gg::models::init();
 
-    for ( const string & thunk_hash : thunk_hashes ) {
+    const bool track_usage = gg::blobs::budget().initialized();
+
+    if ( get_dependencies or put_output ) {
+      storage_backend = StorageBackend::create_backend( gg::remote::storage_backend_uri() );
+    }
+
+    if ( cleanup ) {
+      vector<Thunk> thunks;
+
+      for ( const string & thunk_hash : thunk_hashes ) {
+        thunks.emplace_back( ThunkReader::read( gg::paths::blob( thunk_hash ), thunk_hash ) );
+      }
+
+      do_cleanup( thunks );
+    }
+
+    for ( size_t i = 0; i < thunk_hashes.size(); i++ ) {
+      const string & thunk_hash = thunk_hashes[ i ];
+
       /* take out an advisory lock on the thunk, in case
          other gg-execute processes are running at the same time */
       const string thunk_path = gg::paths::blob( thunk_hash ).string();
@@ -326,17 +390,24 @@ int main( int argc, char * argv[] )
                                                   open( thunk_path.c_str(), O_RDONLY ) ) };
       raw_thunk.block_for_exclusive_lock();
 
-      Thunk thunk = ThunkReader::read( thunk_path );
+      const Thunk original_thunk = ThunkReader::read( thunk_path );
+      Thunk thunk = original_thunk;
 
-      if ( timelog.initialized() ) { timelog->add_point( "read_thunk" ); }
+      /* the thunks are given in order: in a chain, the rest of the thunks
+         can't run without this one, and are left for the caller. without the
+         first one, there's nothing to run at all. */
+      if ( not thunk.can_be_executed() and not reduce_from_cache( thunk ) ) {
+        if ( i == 0 ) {
+          throw runtime_error( "thunk:" + thunk_hash + " cannot be reduced to "
+                               "an executable thunk" );
+        }
 
-      if ( get_dependencies or put_output ) {
-        storage_backend = StorageBackend::create_backend( gg::remote::storage_backend_uri() );
+        cerr << "thunk:" << thunk_hash << " cannot be reduced to an executable "
+             << "thunk; skipping it and the thunks after it." << endl;
+        break;
       }
 
-      if ( cleanup ) {
-        do_cleanup( thunk );
-      }
+      if ( timelog.initialized() ) { timelog->add_point( "read_thunk" ); }
 
       if ( timelog.initialized() ) { timelog->add_point( "do_cleanup" ); }
 
@@ -346,7 +417,11 @@ int main( int argc, char * argv[] )
 
       if ( timelog.initialized() ) { timelog->add_point( "get_dependencies" ); }
 
-      vector<string> output_hashes = execute_thunk( thunk );
+      if ( track_usage ) {
+        touch_inputs( thunk );
+      }
+
+      vector<string> output_hashes = execute_thunk( original_thunk, thunk );
 
       if ( timelog.initialized() ) { timelog->add_point( "execute" ); }
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <thread>
 #include <tuple>
+#include <sstream>
 #include <cstdlib>
 #include <getopt.h>
 #include <sys/time.h>
@@ -15,6 +16,7 @@
 #include "storage/backend_s3.hh"
 #include "thunk/ggutils.hh"
 #include "thunk/placeholder.hh"
+#include "thunk/snapshot.hh"
 #include "thunk/thunk_reader.hh"
 #include "thunk/thunk.hh"
 #include "execution/engine.hh"
@@ -23,12 +25,17 @@
 #include "execution/engine_gg.hh"
 #include "execution/engine_meow.hh"
 #include "execution/engine_gcloud.hh"
+#include "execution/scheduler.hh"
+#include "execution/placement.hh"
+#include "execution/batcher.hh"
 #include "tui/status_bar.hh"
 #include "util/digest.hh"
 #include "util/exception.hh"
+#include "util/ipc_socket.hh"
 #include "util/optional.hh"
 #include "util/path.hh"
 #include "util/timeit.hh"
+#include "util/units.hh"
 #include "util/util.hh"
 
 using namespace std;
@@ -38,6 +45,19 @@ constexpr char FORCE_NO_STATUS[] = "GG_FORCE_NO_STATUS";
 constexpr char FORCE_DEFAULT_ENGINE[] = "GG_FORCE_DEFAULT_ENGINE";
 constexpr char FORCE_MAX_JOBS[] = "GG_FORCE_MAX_JOBS";
 constexpr char FORCE_TIMEOUT[] = "GG_FORCE_TIMEOUT";
+constexpr char FORCE_SCHEDULER[] = "GG_FORCE_SCHEDULER";
+constexpr char FORCE_LOADER_THREADS[] = "GG_FORCE_LOADER_THREADS";
+constexpr char FORCE_HEDGE[] = "GG_FORCE_HEDGE";
+constexpr char FORCE_HEDGE_BUDGET[] = "GG_FORCE_HEDGE_BUDGET";
+constexpr char FORCE_PLACEMENT[] = "GG_FORCE_PLACEMENT";
+constexpr char FORCE_BATCH_SIZE[] = "GG_FORCE_BATCH_SIZE";
+constexpr char FORCE_BATCH_BYTES[] = "GG_FORCE_BATCH_BYTES";
+constexpr char FORCE_BATCH_LINGER[] = "GG_FORCE_BATCH_LINGER";
+constexpr char FORCE_DAEMON[] = "GG_FORCE_DAEMON";
+constexpr char FORCE_STREAM_UPLOAD[] = "GG_FORCE_STREAM_UPLOAD";
+constexpr char FORCE_SNAPSHOT[] = "GG_FORCE_SNAPSHOT";
+constexpr char FORCE_MEMORY_LIMIT[] = "GG_FORCE_MEMORY_LIMIT";
+constexpr char FORCE_FUSE_CHAINS[] = "GG_FORCE_FUSE_CHAINS";
 
 void sigint_handler( int )
 {
@@ -50,7 +70,14 @@ void usage( const char * argv0 )
        << "       " << "[-s|--no-status] [-d|--no-download] [-S|--sandboxed]" << endl
        << "       " << "[[-j|--jobs=<N>] [-e|--engine=<name>[=ENGINE_ARGS]]]... " << endl
        << "       " << "[[-j|--jobs=<N>] [-f|--fallback-engine=<name>[=ENGINE_ARGS]]]..." << endl
-       << "       " << "[-T|--timeout=<t>] [-m|--timeout-multiplier=<N>] THUNKS..." << endl
+       << "       " << "[-T|--timeout=<t>] [-m|--timeout-multiplier=<N>]" << endl
+       << "       " << "[-P|--scheduler=<policy>] [-L|--loader-threads=<N>]" << endl
+       << "       " << "[-H|--hedge=<percentile>] [-B|--hedge-budget=<ratio>]" << endl
+       << "       " << "[-p|--placement=<policy>]" << endl
+       << "       " << "[-b|--batch-size=<N>] [-y|--batch-bytes=<N>] [-w|--batch-linger=<ms>]" << endl
+       << "       " << "[-u|--stream-upload] [-g|--snapshot=<file>] [-M|--memory-limit=<MiB>]" << endl
+       << "       " << "[-F|--fuse-chains]" << endl
+       << "       " << "[-D|--daemon=<socket>] THUNKS..." << endl
        << endl
        << "Available engines:" << endl
        << "  - local   Executes the jobs on the local machine" << endl
@@ -59,10 +86,75 @@ void usage( const char * argv0 )
        << "  - meow    Executes the jobs on AWS Lambda with long-running workers" << endl
        << "  - gcloud  Executes the jobs on Google Cloud Functions" << endl
        << endl
+       << "Scheduling policies:" << endl
+       << "  - fifo                    Runs the jobs in the order they become ready (default)" << endl
+       << "  - critical-path           Prefers the jobs on the longest path to a target," << endl
+       << "                            weighted by thunk timeouts" << endl
+       << "  - critical-path-measured  Same, weighted by the observed runtimes" << endl
+       << endl
+       << "Hedging:" << endl
+       << "  With --hedge=P, a job is duplicated once it has been running for longer than" << endl
+       << "  the P-th percentile of the runtimes of its function, as long as the number of" << endl
+       << "  duplicates stays under --hedge-budget (default 0.1) times the launched jobs." << endl
+       << endl
+       << "Placement policies:" << endl
+       << "  - completion-time  Runs each job on the engine with the lowest expected" << endl
+       << "                     completion time, based on the input sizes, where the" << endl
+       << "                     inputs are, the engine load and the observed latencies" << endl
+       << "                     (default; set GG_PLACEMENT_LOG=<file> to log decisions)" << endl
+       << "  - first-fit        Runs each job on the first engine with a free slot" << endl
+       << endl
+       << "Batching:" << endl
+       << "  With --batch-size=N, the lambda, remote and gcloud engines send up to N" << endl
+       << "  thunks that share their executables in one invocation. A batch is sent once" << endl
+       << "  it's full, once its inputs reach --batch-bytes (default 200 MiB), or" << endl
+       << "  --batch-linger (default 20 ms) after its first thunk was forced." << endl
+       << endl
+       << "Streaming upload:" << endl
+       << "  With --stream-upload, the dependencies are uploaded in the background, and" << endl
+       << "  a job is sent to a remote engine as soon as its own inputs are uploaded." << endl
+       << "  The inputs of the jobs that are ready, or waiting, are uploaded first." << endl
+       << endl
+       << "Snapshot:" << endl
+       << "  With --snapshot=<file>, the thunks are read from a single file that holds" << endl
+       << "  the whole graph, instead of one file per thunk. If the file doesn't exist," << endl
+       << "  or is missing some of the targets, it's written from the blobs first." << endl
+       << endl
+       << "Memory limit:" << endl
+       << "  With --memory-limit=<MiB>, once the thunks in the graph take up about that" << endl
+       << "  much memory, the thunks that are still waiting for their dependencies are" << endl
+       << "  written to a file in the gg directory, and read back once they're needed." << endl
+       << endl
+       << "Chain fusion:" << endl
+       << "  With --fuse-chains, a ready thunk whose only consumer waits on nothing else" << endl
+       << "  runs in the same job as that consumer, and so on down the chain, as long as" << endl
+       << "  the engine can hold the inputs of the whole chain. The outputs in between" << endl
+       << "  are used in place on the worker; they are still uploaded and cached." << endl
+       << endl
+       << "Daemon:" << endl
+       << "  With --daemon=<socket>, gg-force keeps running and forces the thunks that" << endl
+       << "  other gg-force processes send to it through the unix domain socket, sharing" << endl
+       << "  one graph and one set of engines between them. When " << FORCE_DAEMON << endl
+       << "  is set to the path of the socket, gg-force hands its thunks to the daemon" << endl
+       << "  and waits for the results, and the engine options are ignored." << endl
+       << endl
        << "Environment variables:" << endl
        << "  - " << FORCE_NO_STATUS << endl
        << "  - " << FORCE_DEFAULT_ENGINE << endl
        << "  - " << FORCE_TIMEOUT << endl
+       << "  - " << FORCE_SCHEDULER << endl
+       << "  - " << FORCE_LOADER_THREADS << endl
+       << "  - " << FORCE_HEDGE << endl
+       << "  - " << FORCE_HEDGE_BUDGET << endl
+       << "  - " << FORCE_PLACEMENT << endl
+       << "  - " << FORCE_BATCH_SIZE << endl
+       << "  - " << FORCE_BATCH_BYTES << endl
+       << "  - " << FORCE_BATCH_LINGER << endl
+       << "  - " << FORCE_STREAM_UPLOAD << endl
+       << "  - " << FORCE_SNAPSHOT << endl
+       << "  - " << FORCE_MEMORY_LIMIT << endl
+       << "  - " << FORCE_FUSE_CHAINS << endl
+       << "  - " << FORCE_DAEMON << endl
        << endl;
 }
 
@@ -95,7 +187,8 @@ EngineInfo parse_engine( const string & name, const size_t max_jobs )
   }
 }
 
-unique_ptr<ExecutionEngine> make_execution_engine( const EngineInfo & engine )
+unique_ptr<ExecutionEngine> make_execution_engine( const EngineInfo & engine,
+                                                   const BatchLimits & batch_limits )
 {
   const string & engine_name = get<0>( engine );
   const string & engine_params = get<1>( engine );
@@ -107,7 +200,7 @@ unique_ptr<ExecutionEngine> make_execution_engine( const EngineInfo & engine )
   }
   else if ( engine_name == "lambda" ) {
     return make_unique<AWSLambdaExecutionEngine>( max_jobs, AWSCredentials(),
-      engine_params.length() ? engine_params : AWS::region() );
+      engine_params.length() ? engine_params : AWS::region(), batch_limits );
   }
   else if ( engine_name == "remote" ) {
     if ( engine_params.length() == 0 ) {
@@ -122,7 +215,8 @@ unique_ptr<ExecutionEngine> make_execution_engine( const EngineInfo & engine )
       port = stoi( engine_params.substr( colonpos + 1 ) );
     }
 
-    return make_unique<GGExecutionEngine>( max_jobs, Address { host_ip, port } );
+    return make_unique<GGExecutionEngine>( max_jobs, Address { host_ip, port },
+                                           batch_limits );
   }
   else if ( engine_name == "meow" ) {
     if ( engine_params.length() == 0 ) {
@@ -142,13 +236,91 @@ unique_ptr<ExecutionEngine> make_execution_engine( const EngineInfo & engine )
   }
   else if ( engine_name == "gcloud" ) {
     return make_unique<GCFExecutionEngine>( max_jobs,
-      safe_getenv("GG_GCLOUD_FUNCTION") );
+      safe_getenv("GG_GCLOUD_FUNCTION"), batch_limits );
   }
   else {
     throw runtime_error( "unknown execution engine" );
   }
 }
 
+/* opens the snapshot at the given path, after writing it if it doesn't have
+   all the targets */
+shared_ptr<const GraphSnapshot> open_snapshot( const string & path,
+                                               const vector<string> & target_hashes )
+{
+  const vector<gg::Hash> targets( target_hashes.begin(), target_hashes.end() );
+
+  if ( roost::exists( path ) ) {
+    try {
+      auto snapshot = make_shared<const GraphSnapshot>( path );
+
+      if ( all_of( targets.begin(), targets.end(),
+                   [&snapshot] ( const gg::Hash & h ) { return snapshot->has( h ); } ) ) {
+        return snapshot;
+      }
+    }
+    catch ( const exception & e ) {
+      cerr << "ignoring the graph snapshot: " << e.what() << endl;
+    }
+  }
+
+  GraphSnapshot::write( path, targets );
+  return make_shared<const GraphSnapshot>( path );
+}
+
+/* asks the daemon listening on the socket to force the targets */
+vector<string> force_through_daemon( const string & socket_path,
+                                     const vector<string> & target_hashes )
+{
+  IPCSocket socket;
+  socket.connect( socket_path );
+
+  string request;
+
+  for ( const string & hash : target_hashes ) {
+    request += ( request.empty() ? "" : " " ) + hash;
+  }
+
+  socket.write( request + "\n" );
+
+  string answer;
+
+  while ( answer.find( '\n' ) == string::npos ) {
+    const string data = socket.read();
+
+    if ( data.empty() ) {
+      throw runtime_error( "the daemon hung up" );
+    }
+
+    answer += data;
+  }
+
+  istringstream line { answer.substr( 0, answer.find( '\n' ) ) };
+  string status;
+  line >> status;
+
+  if ( status == "error" ) {
+    string error;
+    getline( line >> ws, error );
+    throw runtime_error( error );
+  }
+  else if ( status != "ok" ) {
+    throw runtime_error( "unexpected answer from the daemon: " + status );
+  }
+
+  vector<string> final_hashes;
+
+  for ( string hash; line >> hash; ) {
+    final_hashes.emplace_back( move( hash ) );
+  }
+
+  if ( final_hashes.size() != target_hashes.size() ) {
+    throw runtime_error( "the daemon answered for the wrong number of targets" );
+  }
+
+  return final_hashes;
+}
+
 int main( int argc, char * argv[] )
 {
   try {
@@ -168,7 +340,29 @@ int main( int argc, char * argv[] )
     size_t timeout_multiplier = 1;
     bool status_bar = !( getenv( FORCE_NO_STATUS ) != nullptr );
     bool no_download = false;
-
+    SchedulingPolicy scheduling_policy =
+      JobScheduler::parse_policy( safe_getenv_or( FORCE_SCHEDULER, "fifo" ) );
+    size_t loader_threads = ( getenv( FORCE_LOADER_THREADS ) != nullptr )
+                            ? stoul( safe_getenv( FORCE_LOADER_THREADS ) )
+                            : max( 1u, thread::hardware_concurrency() );
+    double hedging_percentile = ( getenv( FORCE_HEDGE ) != nullptr )
+                                ? stod( safe_getenv( FORCE_HEDGE ) ) : 0;
+    double hedging_budget = ( getenv( FORCE_HEDGE_BUDGET ) != nullptr )
+                            ? stod( safe_getenv( FORCE_HEDGE_BUDGET ) ) : 0.1;
+    PlacementPolicy placement_policy =
+      EnginePlacement::parse_policy( safe_getenv_or( FORCE_PLACEMENT, "completion-time" ) );
+
+    BatchLimits batch_limits;
+    batch_limits.max_thunks = stoul( safe_getenv_or( FORCE_BATCH_SIZE, "1" ) );
+    batch_limits.max_bytes = stoul( safe_getenv_or( FORCE_BATCH_BYTES,
+                                                    to_string( 200_MiB ) ) );
+    batch_limits.linger = std::chrono::milliseconds { stoul( safe_getenv_or( FORCE_BATCH_LINGER, "20" ) ) };
+
+    bool streaming_upload = ( getenv( FORCE_STREAM_UPLOAD ) != nullptr );
+    string snapshot_path = safe_getenv_or( FORCE_SNAPSHOT, "" );
+    size_t graph_memory_limit = stoul( safe_getenv_or( FORCE_MEMORY_LIMIT, "0" ) ) * 1_MiB;
+    bool fuse_chains = ( getenv( FORCE_FUSE_CHAINS ) != nullptr );
+    string daemon_socket;
     size_t total_max_jobs = 0;
     size_t max_jobs = thread::hardware_concurrency();
     vector<EngineInfo> engines_info;
@@ -183,11 +377,24 @@ int main( int argc, char * argv[] )
       { "engine",             required_argument, nullptr, 'e' },
       { "fallback-engine",    required_argument, nullptr, 'f' },
       { "no-download",        no_argument,       nullptr, 'd' },
+      { "scheduler",          required_argument, nullptr, 'P' },
+      { "loader-threads",     required_argument, nullptr, 'L' },
+      { "hedge",              required_argument, nullptr, 'H' },
+      { "hedge-budget",       required_argument, nullptr, 'B' },
+      { "placement",          required_argument, nullptr, 'p' },
+      { "batch-size",         required_argument, nullptr, 'b' },
+      { "batch-bytes",        required_argument, nullptr, 'y' },
+      { "batch-linger",       required_argument, nullptr, 'w' },
+      { "stream-upload",      no_argument,       nullptr, 'u' },
+      { "snapshot",           required_argument, nullptr, 'g' },
+      { "memory-limit",       required_argument, nullptr, 'M' },
+      { "fuse-chains",        no_argument,       nullptr, 'F' },
+      { "daemon",             required_argument, nullptr, 'D' },
       { nullptr,              0,                 nullptr,  0  },
     };
 
     while ( true ) {
-      const int opt = getopt_long( argc, argv, "sSj:T:e:d", long_options, NULL );
+      const int opt = getopt_long( argc, argv, "sSj:T:e:dP:L:H:B:p:b:y:w:ug:M:FD:", long_options, NULL );
 
       if ( opt == -1 ) {
         break;
@@ -228,6 +435,58 @@ int main( int argc, char * argv[] )
         timeout_multiplier = stoul( optarg );
         break;
 
+      case 'P':
+        scheduling_policy = JobScheduler::parse_policy( optarg );
+        break;
+
+      case 'L':
+        loader_threads = stoul( optarg );
+        break;
+
+      case 'H':
+        hedging_percentile = stod( optarg );
+        break;
+
+      case 'B':
+        hedging_budget = stod( optarg );
+        break;
+
+      case 'p':
+        placement_policy = EnginePlacement::parse_policy( optarg );
+        break;
+
+      case 'b':
+        batch_limits.max_thunks = stoul( optarg );
+        break;
+
+      case 'y':
+        batch_limits.max_bytes = stoul( optarg );
+        break;
+
+      case 'w':
+        batch_limits.linger = std::chrono::milliseconds { stoul( optarg ) };
+        break;
+
+      case 'u':
+        streaming_upload = true;
+        break;
+
+      case 'g':
+        snapshot_path = optarg;
+        break;
+
+      case 'M':
+        graph_memory_limit = stoul( optarg ) * 1_MiB;
+        break;
+
+      case 'F':
+        fuse_chains = true;
+        break;
+
+      case 'D':
+        daemon_socket = optarg;
+        break;
+
       default:
         throw runtime_error( "invalid option" );
       }
@@ -280,11 +539,23 @@ int main( int argc, char * argv[] )
       target_hashes.emplace_back( move( thunk_hash ) );
     }
 
-    if ( actual_targets.empty() ) {
+    if ( actual_targets.empty() and daemon_socket.empty() ) {
       cerr << "Nothing to force. Bye." << endl;
       return EXIT_SUCCESS;
     }
 
+    if ( daemon_socket.empty() and getenv( FORCE_DAEMON ) != nullptr ) {
+      const vector<string> reduced_hashes =
+        force_through_daemon( safe_getenv( FORCE_DAEMON ), target_hashes );
+
+      for ( size_t i = 0; i < reduced_hashes.size() and not no_download; i++ ) {
+        roost::copy_then_rename( gg::paths::blob( reduced_hashes[ i ] ), actual_targets[ i ] );
+        roost::make_executable( actual_targets[ i ] );
+      }
+
+      return EXIT_SUCCESS;
+    }
+
     vector<unique_ptr<ExecutionEngine>> execution_engines;
     vector<unique_ptr<ExecutionEngine>> fallback_engines;
     unique_ptr<StorageBackend> storage_backend;
@@ -301,12 +572,12 @@ int main( int argc, char * argv[] )
     }
 
     for ( const auto & engine : engines_info ) {
-      execution_engines.emplace_back( move( make_execution_engine( engine ) ) );
+      execution_engines.emplace_back( move( make_execution_engine( engine, batch_limits ) ) );
       remote_execution |= execution_engines.back()->is_remote();
     }
 
     for ( const auto & engine : fallback_engines_info ) {
-      fallback_engines.emplace_back( move( make_execution_engine( engine ) ) );
+      fallback_engines.emplace_back( move( make_execution_engine( engine, batch_limits ) ) );
       remote_execution |= fallback_engines.back()->is_remote();
     }
 
@@ -314,12 +585,42 @@ int main( int argc, char * argv[] )
       storage_backend = StorageBackend::create_backend( gg::remote::storage_backend_uri() );
     }
 
+    shared_ptr<const GraphSnapshot> snapshot;
+
+    if ( not snapshot_path.empty() ) {
+      snapshot = open_snapshot( snapshot_path, target_hashes );
+    }
+
+    if ( not daemon_socket.empty() ) {
+      if ( not target_hashes.empty() ) {
+        throw runtime_error( "the daemon doesn't take any thunks" );
+      }
+
+      Reductor reductor { {},
+                          move( execution_engines ),
+                          move( fallback_engines ),
+                          move( storage_backend ),
+                          std::chrono::milliseconds { timeout * 1000 },
+                          timeout_multiplier, status_bar,
+                          scheduling_policy, loader_threads,
+                          hedging_percentile, hedging_budget,
+                          placement_policy, streaming_upload, snapshot,
+                          graph_memory_limit, fuse_chains };
+
+      reductor.serve( daemon_socket );
+      return EXIT_SUCCESS;
+    }
+
     Reductor reductor { target_hashes,
                         move( execution_engines ),
                         move( fallback_engines ),
                         move( storage_backend ),
                         std::chrono::milliseconds { timeout * 1000 },
-                        timeout_multiplier, status_bar };
+                        timeout_multiplier, status_bar,
+                        scheduling_policy, loader_threads,
+                        hedging_percentile, hedging_budget,
+                        placement_policy, streaming_upload, snapshot,
+                        graph_memory_limit, fuse_chains };
 
     reductor.upload_dependencies();
     vector<string> reduced_hashes = reductor.reduce();
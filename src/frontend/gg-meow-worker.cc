@@ -3,6 +3,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <limits>
 #include <stdexcept>
 #include <cstdlib>
@@ -13,6 +14,7 @@
 #include "net/http_response.hh"
 #include "net/http_request.hh"
 #include "thunk/ggutils.hh"
+#include "execution/blob_collector.hh"
 #include "execution/loop.hh"
 #include "execution/meow/message.hh"
 #include "execution/meow/util.hh"
@@ -54,8 +56,13 @@ int main( int argc, char * argv[] )
 
     Address coordinator_addr { argv[ 1 ], static_cast<uint16_t>( port_argv ) };
     ExecutionLoop loop;
+    BlobCollector blob_collector { loop, BlobCollector::worker_budget() };
 
     MessageParser message_parser;
+
+    /* thunk hash => id of the child process that is executing it */
+    unordered_map<string, uint64_t> running_children;
+
     /* let's make a connection back to the coordinator */
     shared_ptr<TCPConnection> connection = loop.make_connection<TCPConnection>( coordinator_addr,
       [&message_parser] ( shared_ptr<TCPConnection>, string && data ) {
@@ -72,7 +79,15 @@ int main( int argc, char * argv[] )
     Message hello_message { Message::OpCode::Hey, "" };
     connection->enqueue_write( hello_message.str() );
 
-    while( loop.loop_once( -1 ).result == Poller::Result::Type::Success ) {
+    /* the blob collector's timer makes some of the polls time out */
+    while ( true ) {
+      const Poller::Result::Type result = loop.loop_once( -1 ).result;
+
+      if ( result != Poller::Result::Type::Success
+           and result != Poller::Result::Type::Timeout ) {
+        break;
+      }
+
       while ( not message_parser.empty() ) {
         const Message & message = message_parser.front();
 
@@ -108,9 +123,11 @@ int main( int argc, char * argv[] )
 
           /* now we can execute it */
           cerr << "[execute] " << execution_request.hash() << endl;
-          loop.add_child_process( execution_request.hash(),
-            [hash=execution_request.hash(), execution_request, &connection]
+          const uint64_t child_id = loop.add_child_process( execution_request.hash(),
+            [hash=execution_request.hash(), execution_request, &connection, &running_children]
             ( const uint64_t, const string &, const int status ) mutable {
+              running_children.erase( hash );
+
               if ( status ) {
                 /* execution failed */
                 Message message { Message::OpCode::ExecutionFailed, move( hash ) };
@@ -162,6 +179,21 @@ int main( int argc, char * argv[] )
             false
           );
 
+          running_children[ execution_request.hash() ] = child_id;
+          break;
+        }
+
+        case Message::OpCode::Cancel:
+        {
+          const string & hash = message.payload();
+          auto child = running_children.find( hash );
+
+          if ( child != running_children.end() ) {
+            loop.cancel_child_process( child->second );
+            running_children.erase( child );
+          }
+
+          cerr << "[cancel] " << hash << endl;
           break;
         }
 
@@ -59,7 +59,8 @@ int main( int argc, char * argv[] )
       if ( not last_batch ) {
         file_hash = gg::hash::file_force( file_name );
         if ( not storage_backend->is_available( file_hash ) ) {
-          put_requests.emplace_back( file_name, file_hash, gg::hash::to_hex( file_hash ) );
+          put_requests.emplace_back( file_name, file_hash,
+                                     gg::hash::content_sha256( file_hash, file_name ) );
         }
       }
 
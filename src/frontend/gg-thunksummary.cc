@@ -3,11 +3,13 @@
 #include <unistd.h>
 #include <cstring>
 #include <iostream>
+#include <thread>
+#include <getopt.h>
 
+#include "protobufs/util.hh"
 #include "thunk/ggutils.hh"
-#include "thunk/thunk_reader.hh"
-#include "thunk/thunk.hh"
-#include "trace/syscall.hh"
+#include "thunk/graph_summary.hh"
+#include "thunk/placeholder.hh"
 #include "util/exception.hh"
 #include "util/path.hh"
 
@@ -16,81 +18,70 @@ using namespace gg::thunk;
 
 void usage( const char * argv0 )
 {
-  cerr << argv0 << " THUNK-HASH" << endl;
+  cerr << "Usage: " << argv0 << endl
+       << "       " << "[-j|--jobs=<N>] [-c|--compact] THUNK..." << endl
+       << endl
+       << "Prints the critical path, the width of each level, the input sizes and the" << endl
+       << "fan-in and fan-out distributions of the graph under the given thunks, as" << endl
+       << "JSON. A THUNK is a thunk hash, or a placeholder. The thunks are read by N" << endl
+       << "threads (default: one per core)." << endl;
 }
 
-string shortn( const string & hash )
-{
-  return hash.substr( 0, 5 );
-}
-
-struct ThunkStats
+int main( int argc, char * argv[] )
 {
-  std::unordered_map<std::string, size_t> files {};
-  std::unordered_set<std::string> thunks {};
-
-  ThunkStats & operator+=( const ThunkStats & other )
-  {
-    files.insert( other.files.begin(), other.files.end() );
-    thunks.insert( other.thunks.begin(), other.thunks.end() );
-    return *this;
-  }
-
-  size_t total_file_size() const
-  {
-    size_t ret = 0;
-    for ( const auto & x : files ) {
-      ret += x.second;
+  try {
+    if ( argc <= 0 ) {
+      abort();
     }
-    return ret;
-  }
-};
 
-ThunkStats print_thunk_info( const string & hash, unsigned int indent )
-{
-  const Thunk thunk { move( ThunkReader::read( gg::paths::blob( hash ) ) ) };
-  const string indentation( indent, ' ' );
+    size_t thread_count = max( 1u, thread::hardware_concurrency() );
+    bool pretty_print = true;
 
-  const string display_name = shortn( hash );
+    const option command_line_options[] = {
+      { "jobs",    required_argument, nullptr, 'j' },
+      { "compact", no_argument,       nullptr, 'c' },
+      { 0, 0, 0, 0 }
+    };
 
-  ThunkStats stats;
-  stats.thunks.insert( hash );
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "j:c", command_line_options, nullptr );
 
-  cout << indentation << display_name << "\n";
+      if ( opt == -1 ) { break; }
 
-  for ( const auto & item : thunk.values() ) {
-    const string infile_name = shortn( item.first );
-    cout << indentation << " " << infile_name << "\n";
-    stats.files.insert( { item.first, gg::hash::size( item.first ) } );
-  }
-
-  for ( const auto & item : thunk.thunks() ) {
-    const string infile_name = shortn( item.first );
-    stats += print_thunk_info( item.first, indent + 1 );
-  }
+      switch ( opt ) {
+      case 'j':
+        thread_count = stoul( optarg );
+        break;
 
-  const string plural = stats.thunks.size() > 1 ? "s" : "";
+      case 'c':
+        pretty_print = false;
+        break;
 
-  cout << indentation << display_name << " uses " << stats.thunks.size()
-       << " thunk" << plural << " and " << stats.files.size() << " files totaling "
-       << stats.total_file_size() / 1048576 << " MiB\n";
-
-  return stats;
-}
-
-int main( int argc, char * argv[] )
-{
-  try {
-    if ( argc <= 0 ) {
-      abort();
+      default:
+        usage( argv[ 0 ] );
+        return EXIT_FAILURE;
+      }
     }
 
-    if ( argc != 2 ) {
+    if ( optind >= argc ) {
       usage( argv[ 0 ] );
       return EXIT_FAILURE;
     }
 
-    print_thunk_info( argv[ 1 ], 0 );
+    vector<gg::Hash> targets;
+
+    for ( int i = optind; i < argc; i++ ) {
+      Optional<ThunkPlaceholder> placeholder;
+
+      if ( roost::exists( argv[ i ] ) ) {
+        placeholder = ThunkPlaceholder::read( argv[ i ] );
+      }
+
+      targets.emplace_back( placeholder.initialized() ? placeholder->content_hash()
+                                                      : string { argv[ i ] } );
+    }
+
+    cout << protoutil::to_json( summarize_graph( targets, thread_count ), pretty_print ) << endl;
   }
   catch ( const exception &  e ) {
     print_exception( argv[ 0 ], e );
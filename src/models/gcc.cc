@@ -409,8 +409,8 @@ string GCCModelGenerator::generate_thunk( const GCCStage first_stage,
       cc1_program = CC1PLUS;
     }
 
-    for ( const string & dep : dependencies ) {
-      base_infiles.emplace_back( dep );
+    for ( ThunkFactory::Data & dep : ThunkFactory::Data::from_files( dependencies ) ) {
+      base_infiles.push_back( move( dep ) );
     }
 
     for ( const string & dir : include_path ) {
@@ -528,8 +528,14 @@ string GCCModelGenerator::generate_thunk( const GCCStage first_stage,
 
       if ( build_dir.initialized() ) {
         files = scan_build_directory( *build_dir, excludes );
+        vector<string> filenames;
+
         for ( const auto & file : files ) {
-          base_infiles.emplace_back( file.string() );
+          filenames.push_back( file.string() );
+        }
+
+        for ( ThunkFactory::Data & file : ThunkFactory::Data::from_files( filenames ) ) {
+          base_infiles.push_back( move( file ) );
         }
       }
 
@@ -80,8 +80,8 @@ string GCCModelGenerator::generate_link_thunk( const vector<InputFile> & link_in
     }
   }
 
-  for ( const string & dep : dependencies ) {
-    infiles.emplace_back( dep );
+  for ( ThunkFactory::Data & dep : ThunkFactory::Data::from_files( dependencies ) ) {
+    infiles.push_back( move( dep ) );
   }
 
   /* ARGS */
@@ -168,14 +168,29 @@ GCCModelGenerator::generate_dependencies_file( const OperationMode op_mode,
 
       /* do we have a possible cache hit? */
       if ( makedep_fn == dep_cache_entry.function() ) {
+        /* check if all the infiles are still the same, hashing them all at
+           once; a file that's gone is a miss */
         bool cache_hit = true;
+        vector<roost::path> infiles;
+        vector<string> infile_hashes;
 
-        /* check if all the infiles are still the same */
         for ( const auto & item : dep_cache_entry.values() ) {
-          if ( not Thunk::matches_filesystem( item ) ) {
+          if ( item.second.empty() ) {
             cache_hit = false;
             break;
           }
+
+          infiles.emplace_back( item.second );
+          infile_hashes.emplace_back( item.first );
+        }
+
+        try {
+          if ( cache_hit ) {
+            cache_hit = ( gg::hash::files( infiles ) == infile_hashes );
+          }
+        }
+        catch ( const unix_error & ) {
+          cache_hit = false;
         }
 
         if ( cache_hit ) {
@@ -203,9 +218,10 @@ GCCModelGenerator::generate_dependencies_file( const OperationMode op_mode,
 
   /* assemble the infiles */
   const vector<string> infiles_list = parse_dependencies_file( output_name, target_name );
+  const vector<string> infiles_hashes = gg::hash::files( { infiles_list.begin(), infiles_list.end() } );
   vector<Thunk::DataItem> dependencies;
-  for ( const auto & str : infiles_list ) {
-    dependencies.emplace_back( make_pair( gg::hash::file( str ), str ) );
+  for ( size_t i = 0; i < infiles_list.size(); i++ ) {
+    dependencies.emplace_back( make_pair( infiles_hashes[ i ], infiles_list[ i ] ) );
   }
 
   Thunk dep_cache_entry( makedep_fn, dependencies,
@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 
 import os
+import re
+import fcntl
 
 GG_DIR = os.environ.get('GG_DIR')
 
@@ -13,6 +15,7 @@ if not os.path.isabs(GG_DIR):
 class GGPaths:
     blobs = os.path.join(GG_DIR, "blobs")
     reductions = os.path.join(GG_DIR, "reductions")
+    reduction_log = os.path.join(reductions, "log")
 
     @classmethod
     def blob_path(cls, blob_hash):
@@ -27,28 +30,84 @@ class GGPaths:
         return "https://{bucket}.s3.amazonaws.com/{key}".format(bucket=bucket, key=key)
 
 class GGCache:
+    # the reductions are kept in a log of "old-hash new-hash" lines, and the
+    # last line for a hash wins; lines without a newline are partial. the
+    # log is read into memory once, and a lookup that misses reads whatever
+    # was appended since. a compacted log is a new file, which is read anew.
+    HASH_RE = re.compile(r"^[VT][A-Za-z0-9._]{43}(?:[0-9a-f]{8}|[1-9a-f][0-9a-f]{8,15})$")
+
+    index = {}
+    log_inode = None
+    log_offset = 0
+
+    @classmethod
+    def read_log(cls):
+        try:
+            fin = open(GGPaths.reduction_log, "rb")
+        except FileNotFoundError:
+            return
+
+        with fin:
+            inode = os.fstat(fin.fileno()).st_ino
+
+            if inode != cls.log_inode:
+                cls.index = {}
+                cls.log_inode = inode
+                cls.log_offset = 0
+
+            fin.seek(cls.log_offset)
+            data = fin.read()
+
+        end = data.rfind(b"\n") + 1
+        cls.log_offset += end
+
+        for line in data[:end].decode().splitlines():
+            entry = line.split(" ")
+
+            if len(entry) == 2 and cls.HASH_RE.match(entry[1]):
+                cls.index[entry[0]] = entry[1]
+
     @classmethod
     def check(cls, thunk_hash, output_tag=None):
         key = thunk_hash
         if output_tag:
             key += ("#%s" % output_tag)
 
+        if key not in cls.index:
+            cls.read_log()
+
+        if key in cls.index:
+            return cls.index[key]
+
+        # entries in the old format, one file each
         rpath = GGPaths.reduction_path(key)
 
         if not os.path.exists(rpath):
             return None
 
         with open(rpath, "r") as fin:
-            data = fin.read()
-            data = data.split(" ")
-            return data[0]
+            data = fin.read().split(" ")[0].strip()
+            return data if cls.HASH_RE.match(data) else None
 
     @classmethod
     def insert(cls, old_hash, new_hash):
-        rpath = GGPaths.reduction_path(old_hash)
+        while True:
+            with open(GGPaths.reduction_log, "a+") as fout:
+                fcntl.flock(fout, fcntl.LOCK_EX)
+
+                # the log might have been compacted while we were waiting
+                if os.fstat(fout.fileno()).st_ino != os.stat(GGPaths.reduction_log).st_ino:
+                    continue
+
+                line = "%s %s\n" % (old_hash, new_hash)
+
+                if fout.tell() > 0:
+                    fout.seek(fout.tell() - 1)
+                    if fout.read(1) != "\n":
+                        line = "\n" + line
 
-        with open(rpath, "w") as fout:
-            fout.write(new_hash)
+                fout.write(line)
+                return
 
 def make_gg_dirs():
     os.makedirs(GGPaths.blobs, exist_ok=True)
@@ -76,9 +76,12 @@ def handler(request):
             output_hash = GGCache.check(thunk['hash'], output_tag)
 
             if not output_hash:
+                # the rest of a chain that couldn't run here is left to the
+                # client, which gets the results of the thunks before it
                 return json.dumps({
                     'returnCode': return_code,
-                    'stdout': stdout
+                    'stdout': stdout,
+                    'executedThunks': executed_thunks
                 })
 
             data = None
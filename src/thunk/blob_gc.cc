@@ -0,0 +1,126 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "blob_gc.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "ggutils.hh"
+#include "util/exception.hh"
+#include "util/path.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+namespace gg {
+  namespace blobs {
+
+    Optional<uint64_t> budget()
+    {
+      const char * envar = getenv( "GG_BLOB_BUDGET" );
+
+      if ( envar == nullptr ) {
+        return {};
+      }
+
+      char * suffix;
+      uint64_t bytes = strtoull( envar, &suffix, 10 );
+
+      switch ( *suffix ) {
+      case 'G': bytes <<= 10; /* fall through */
+      case 'M': bytes <<= 10; /* fall through */
+      case 'K': bytes <<= 10; suffix++; break;
+      }
+
+      if ( suffix == envar or *suffix != '\0' ) {
+        throw runtime_error( "invalid GG_BLOB_BUDGET: " + string( envar ) );
+      }
+
+      return { true, bytes };
+    }
+
+    void touch( const string & hash )
+    {
+      const timespec times[ 2 ] = { { 0, UTIME_NOW }, { 0, UTIME_OMIT } };
+
+      /* only the owner of the blob is allowed to do this; the blobs that were
+         put there by someone else just look older than they are */
+      utimensat( AT_FDCWD, gg::paths::blob( hash ).string().c_str(), times, 0 );
+    }
+
+    uint64_t collect( const uint64_t budget,
+                      const unordered_set<string> & pinned,
+                      const seconds & grace )
+    {
+      struct Blob
+      {
+        string name;
+        timespec last_used;
+        uint64_t size;
+      };
+
+      const roost::path blobs_dir = gg::paths::blobs();
+      roost::Directory directory { blobs_dir.string() };
+
+      const time_t grace_start = time( nullptr ) - grace.count();
+      uint64_t total_size = 0;
+      vector<Blob> candidates;
+
+      for ( const string & name : roost::list_directory( blobs_dir ) ) {
+        struct stat blob_stat;
+
+        if ( fstatat( directory.num(), name.c_str(), &blob_stat, AT_SYMLINK_NOFOLLOW ) != 0 ) {
+          if ( errno == ENOENT ) {
+            continue; /* removed in the meantime */
+          }
+
+          throw unix_error( "fstatat (" + name + ")" );
+        }
+
+        if ( not S_ISREG( blob_stat.st_mode ) ) {
+          continue;
+        }
+
+        const uint64_t size = blob_stat.st_blocks * 512;
+        total_size += size;
+
+        if ( pinned.count( name ) or blob_stat.st_atim.tv_sec >= grace_start ) {
+          continue;
+        }
+
+        candidates.push_back( { name, blob_stat.st_atim, size } );
+      }
+
+      sort( candidates.begin(), candidates.end(),
+            [] ( const Blob & a, const Blob & b )
+            {
+              return a.last_used.tv_sec < b.last_used.tv_sec
+                     or ( a.last_used.tv_sec == b.last_used.tv_sec
+                          and a.last_used.tv_nsec < b.last_used.tv_nsec );
+            } );
+
+      uint64_t removed_size = 0;
+
+      for ( const Blob & blob : candidates ) {
+        if ( total_size <= budget ) {
+          break;
+        }
+
+        if ( unlinkat( directory.num(), blob.name.c_str(), 0 ) != 0 and errno != ENOENT ) {
+          throw unix_error( "unlinkat (" + blob.name + ")" );
+        }
+
+        total_size -= blob.size;
+        removed_size += blob.size;
+      }
+
+      return removed_size;
+    }
+
+  }
+}
@@ -0,0 +1,41 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BLOB_GC_HH
+#define BLOB_GC_HH
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <unordered_set>
+
+#include "util/optional.hh"
+
+namespace gg {
+  namespace blobs {
+
+    /* the number of bytes of blobs to keep around, from GG_BLOB_BUDGET (a
+       number of bytes, optionally followed by K, M or G); uninitialized if
+       it's not set */
+    Optional<uint64_t> budget();
+
+    /* a blob used more recently than this might be about to be used again, by
+       a thunk that's still running */
+    constexpr std::chrono::seconds in_use_window { 10 * 60 };
+
+    /* marks the blob as just used. blobs are never modified, so their access
+       time is free to say when they were last used; it's set explicitly, as
+       the file system might not keep it up to date. */
+    void touch( const std::string & hash );
+
+    /* removes the least recently used blobs, until the rest take up at most
+       `budget` bytes, and returns the number of bytes removed. the pinned
+       blobs are kept regardless, and so are the ones used in the last
+       `grace` seconds, which another process might be about to use. */
+    uint64_t collect( const uint64_t budget,
+                      const std::unordered_set<std::string> & pinned = {},
+                      const std::chrono::seconds & grace = std::chrono::seconds { 0 } );
+
+  }
+}
+
+#endif /* BLOB_GC_HH */
@@ -0,0 +1,210 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "data_list.hh"
+
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+using namespace gg::thunk;
+
+DataList::DataList( const vector<value_type> & items )
+{
+  entries_.reserve( items.size() );
+
+  for ( const value_type & item : items ) {
+    entries_.push_back( { item.first, intern( item.second ) } );
+  }
+
+  stable_sort( entries_.begin(), entries_.end() );
+  sorted_count_ = entries_.size();
+}
+
+DataList::DataList( vector<value_type> && items )
+{
+  entries_.reserve( items.size() );
+
+  for ( value_type & item : items ) {
+    entries_.push_back( { move( item.first ), intern( item.second ) } );
+  }
+
+  stable_sort( entries_.begin(), entries_.end() );
+  sorted_count_ = entries_.size();
+}
+
+shared_ptr<const string> DataList::intern( const string & name )
+{
+  static const shared_ptr<const string> empty_name = make_shared<const string>();
+
+  /* most of the inputs don't have a name */
+  if ( name.empty() ) {
+    return empty_name;
+  }
+
+  /* the names that no list holds anymore are swept out once the pool has
+     doubled since the last sweep */
+  static mutex pool_mutex;
+  static unordered_map<string, weak_ptr<const string>> pool;
+  static size_t sweep_size = 1024;
+
+  unique_lock<mutex> lock { pool_mutex };
+  weak_ptr<const string> & entry = pool[ name ];
+  shared_ptr<const string> interned = entry.lock();
+
+  if ( not interned ) {
+    interned = make_shared<const string>( name );
+    entry = interned;
+  }
+
+  if ( pool.size() >= sweep_size ) {
+    for ( auto it = pool.begin(); it != pool.end(); ) {
+      if ( it->second.expired() ) {
+        it = pool.erase( it );
+      }
+      else {
+        it++;
+      }
+    }
+
+    sweep_size = max<size_t>( 1024, 2 * pool.size() );
+  }
+
+  return interned;
+}
+
+void DataList::compact() const
+{
+  size_t kept = 0;
+  size_t kept_sorted = 0;
+
+  for ( size_t i = 0; i < entries_.size(); i++ ) {
+    if ( entries_[ i ].erased() ) {
+      continue;
+    }
+
+    if ( i < sorted_count_ ) {
+      kept_sorted++;
+    }
+
+    if ( kept != i ) {
+      entries_[ kept ] = move( entries_[ i ] );
+    }
+
+    kept++;
+  }
+
+  entries_.erase( entries_.begin() + kept, entries_.end() );
+  sorted_count_ = kept_sorted;
+  erased_count_ = 0;
+}
+
+void DataList::normalize() const
+{
+  if ( sorted_count_ < entries_.size() ) {
+    compact();
+
+    /* the new items go after the old ones with the same hash */
+    const auto middle = entries_.begin() + sorted_count_;
+    stable_sort( middle, entries_.end() );
+    inplace_merge( entries_.begin(), middle, entries_.end() );
+    sorted_count_ = entries_.size();
+  }
+  else if ( erased_count_ > entries_.size() / 2 ) {
+    /* the erased entries keep their hashes, so lookups can skip them until
+       they take up most of the space */
+    compact();
+  }
+}
+
+DataList::const_iterator DataList::begin() const
+{
+  normalize();
+  return { entries_.cbegin(), entries_.cend() };
+}
+
+DataList::const_iterator DataList::end() const
+{
+  /* begin() and end() can be called in any order, but end() is also called
+     while erasing items in a loop, so it shouldn't compact the vector */
+  if ( sorted_count_ < entries_.size() ) {
+    normalize();
+  }
+
+  return { entries_.cend(), entries_.cend() };
+}
+
+pair<DataList::const_iterator, DataList::const_iterator>
+DataList::equal_range( const string & hash ) const
+{
+  normalize();
+
+  const Entry key { hash, nullptr };
+  const auto range = std::equal_range( entries_.cbegin(), entries_.cend(), key );
+
+  return { { range.first, range.second }, { range.second, range.second } };
+}
+
+size_t DataList::count( const string & hash ) const
+{
+  const auto range = equal_range( hash );
+  return distance( range.first, range.second );
+}
+
+void DataList::insert( const string & hash, const string & name )
+{
+  insert( string { hash }, name );
+}
+
+void DataList::insert( string && hash, const string & name )
+{
+  /* items that come in order, e.g. from a serialized thunk, stay sorted */
+  const bool in_order = ( sorted_count_ == entries_.size() ) and
+                        ( entries_.empty() or not ( hash < entries_.back().hash ) );
+
+  entries_.push_back( { move( hash ), intern( name ) } );
+
+  if ( in_order ) {
+    sorted_count_++;
+  }
+}
+
+size_t DataList::erase( const string & hash )
+{
+  const auto range = equal_range( hash );
+  size_t count = 0;
+
+  for ( auto it = range.first; it != range.second; it = erase( it ) ) {
+    count++;
+  }
+
+  return count;
+}
+
+DataList::const_iterator DataList::erase( const const_iterator it )
+{
+  const auto offset = it.it_ - entries_.cbegin();
+  entries_[ offset ].name.reset();
+  erased_count_++;
+
+  return { it.it_ + 1, it.end_ };
+}
+
+bool DataList::operator==( const DataList & other ) const
+{
+  if ( size() != other.size() ) {
+    return false;
+  }
+
+  const_iterator it = begin();
+  const_iterator other_it = other.begin();
+
+  for ( ; it != end(); ++it, ++other_it ) {
+    /* the names are interned */
+    if ( it.it_->hash != other_it.it_->hash or it.it_->name != other_it.it_->name ) {
+      return false;
+    }
+  }
+
+  return true;
+}
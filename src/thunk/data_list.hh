@@ -0,0 +1,123 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef THUNK_DATA_LIST_HH
+#define THUNK_DATA_LIST_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iterator>
+
+namespace gg {
+  namespace thunk {
+
+    /* The inputs of a thunk, as (hash, filename) pairs. It behaves like the
+       std::multimap it replaces: the items are ordered by hash, and the items
+       with the same hash are kept in the order they were inserted. The items
+       are stored in one vector, and the filenames are interned, as the same
+       names show up in many thunks; a name leaves the pool once no list
+       holds it.
+
+       Inserted items are appended and erased items are only marked, so that
+       replacing the inputs one at a time stays cheap; the vector is put back
+       in order by the next lookup or iteration. Like the cached hash of a
+       thunk, that happens in const methods, so a DataList that is being
+       modified shouldn't be read from more than one thread. */
+    class DataList
+    {
+    public:
+      typedef std::pair<std::string, std::string> value_type;
+      typedef std::pair<const std::string &, const std::string &> reference;
+
+    private:
+      struct Entry
+      {
+        std::string hash {};
+        std::shared_ptr<const std::string> name {}; /* null once the item is erased */
+
+        bool erased() const { return name == nullptr; }
+        bool operator<( const Entry & other ) const { return hash < other.hash; }
+      };
+
+      mutable std::vector<Entry> entries_ {};
+
+      /* the first sorted_count_ entries are in order */
+      mutable size_t sorted_count_ { 0 };
+      mutable size_t erased_count_ { 0 };
+
+      void normalize() const;
+      void compact() const;
+
+      static std::shared_ptr<const std::string> intern( const std::string & name );
+
+    public:
+      class const_iterator
+      {
+      private:
+        typedef std::vector<Entry>::const_iterator Base;
+
+        Base it_;
+        Base end_;
+
+        void skip_erased() { while ( it_ != end_ and it_->erased() ) { ++it_; } }
+
+        friend class DataList;
+
+      public:
+        struct pointer
+        {
+          reference item;
+          const reference * operator->() const { return &item; }
+        };
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef DataList::value_type value_type;
+        typedef DataList::reference reference;
+        typedef std::ptrdiff_t difference_type;
+
+        const_iterator( const Base it, const Base end ) : it_( it ), end_( end ) { skip_erased(); }
+
+        reference operator*() const { return { it_->hash, *it_->name }; }
+        pointer operator->() const { return { **this }; }
+
+        const_iterator & operator++() { ++it_; skip_erased(); return *this; }
+        const_iterator operator++( int ) { const_iterator old { *this }; ++( *this ); return old; }
+
+        bool operator==( const const_iterator & other ) const { return it_ == other.it_; }
+        bool operator!=( const const_iterator & other ) const { return it_ != other.it_; }
+      };
+
+      typedef const_iterator iterator;
+
+      DataList() {}
+      DataList( const std::vector<value_type> & items );
+      DataList( std::vector<value_type> && items );
+
+      size_t size() const { return entries_.size() - erased_count_; }
+      bool empty() const { return size() == 0; }
+
+      const_iterator begin() const;
+      const_iterator end() const;
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend() const { return end(); }
+
+      std::pair<const_iterator, const_iterator> equal_range( const std::string & hash ) const;
+      size_t count( const std::string & hash ) const;
+
+      void insert( const std::string & hash, const std::string & name );
+      void insert( std::string && hash, const std::string & name );
+      void emplace( const value_type & item ) { insert( item.first, item.second ); }
+      void emplace( value_type && item ) { insert( std::move( item.first ), item.second ); }
+
+      size_t erase( const std::string & hash );
+      const_iterator erase( const const_iterator it );
+
+      bool operator==( const DataList & other ) const;
+      bool operator!=( const DataList & other ) const { return not operator==( other ); }
+    };
+
+  } /* namespace thunk */
+} /* namespace gg */
+
+#endif /* THUNK_DATA_LIST_HH */
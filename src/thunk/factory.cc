@@ -16,6 +16,7 @@
 #include "util/exception.hh"
 #include "util/file_descriptor.hh"
 #include "util/optional.hh"
+#include "util/parallel.hh"
 #include "util/path.hh"
 #include "util/tokenize.hh"
 
@@ -48,6 +49,50 @@ ThunkFactory::Data::Data( const string & filename,
   }
 }
 
+vector<ThunkFactory::Data>
+ThunkFactory::Data::from_files( const vector<string> & filenames )
+{
+  vector<string> normalized;
+  vector<Optional<ThunkPlaceholder>> placeholders( filenames.size() );
+
+  for ( const string & filename : filenames ) {
+    normalized.push_back( roost::path( filename ).lexically_normal().string() );
+  }
+
+  parallel_for( normalized.size(), io_thread_count(),
+    [&] ( const size_t i )
+    {
+      placeholders[ i ] = ThunkPlaceholder::read( normalized[ i ] );
+    } );
+
+  vector<roost::path> values;
+
+  for ( size_t i = 0; i < normalized.size(); i++ ) {
+    if ( not placeholders[ i ].initialized() ) {
+      values.emplace_back( normalized[ i ] );
+    }
+  }
+
+  const vector<string> value_hashes = gg::hash::files( values, { true, ObjectType::Value } );
+  auto value_hash = value_hashes.begin();
+
+  vector<Data> result;
+  result.reserve( normalized.size() );
+
+  for ( size_t i = 0; i < normalized.size(); i++ ) {
+    if ( placeholders[ i ].initialized() ) {
+      result.emplace_back( normalized[ i ], normalized[ i ], ObjectType::Thunk,
+                           placeholders[ i ]->content_hash() );
+    }
+    else {
+      result.emplace_back( normalized[ i ], normalized[ i ], ObjectType::Value,
+                           *value_hash++ );
+    }
+  }
+
+  return result;
+}
+
 Thunk ThunkFactory::create_thunk( const Function & function,
                                   const vector<Data> & data,
                                   const vector<Data> & executables,
@@ -142,7 +187,7 @@ string ThunkFactory::generate( const Function & function,
     thunk_data.emplace_back( manifest_hash, string {} );
     roost::atomic_create( manifest_data,
                           gg::paths::blob( manifest_hash ), true, 0400 );
-    thunk_function.envars().push_back( "GG_MANIFEST=" + thunk::data_placeholder( manifest_hash ) );
+    thunk_function.add_envar( "GG_MANIFEST=" + thunk::data_placeholder( manifest_hash ) );
   }
 
   if ( collect_data ) {
@@ -37,6 +37,10 @@ public:
           const gg::ObjectType & type = gg::ObjectType::Value,
           const std::string & hash = {} );
 
+    /* the data for each of the files, as Data( filename ) would make it, with
+       the files read and hashed on several threads */
+    static std::vector<Data> from_files( const std::vector<std::string> & filenames );
+
     const std::string & filename() const { return filename_; }
     const std::string & real_filename() const { return real_filename_; }
     const std::string & hash() const { return hash_; }
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cctype>
 
 using namespace std;
 using namespace gg;
@@ -29,6 +30,201 @@ Function::Function( const protobuf::Function & func_proto )
     envars_( func_proto.envars().begin(), func_proto.envars().end() )
 {}
 
+namespace {
+
+  bool is_hash_char( const char c )
+  {
+    return isalnum( static_cast<unsigned char>( c ) ) or c == '_' or c == '.';
+  }
+
+  size_t placeholder_length( const string & hash )
+  {
+    return DATA_PLACEHOLDER_START.length() + hash.length() + DATA_PLACEHOLDER_END.length();
+  }
+
+  /* finds the next "@{GGHASH:<hash>[#<tag>]}" at or after pos; returns the
+     position of the placeholder and sets hash_end to the end of its hash
+     and tag */
+  size_t find_placeholder( const string & str, size_t pos, size_t & hash_end )
+  {
+    while ( ( pos = str.find( DATA_PLACEHOLDER_START, pos ) ) != string::npos ) {
+      const size_t hash_start = pos + DATA_PLACEHOLDER_START.length();
+      size_t end = hash_start;
+
+      while ( end < str.length() and is_hash_char( str[ end ] ) ) { end++; }
+
+      if ( end > hash_start and end < str.length() and str[ end ] == '#' ) {
+        /* the tag can't contain a slash */
+        size_t tag_end = end + 1;
+        while ( tag_end < str.length() and str[ tag_end ] != '/'
+                and str.compare( tag_end, DATA_PLACEHOLDER_END.length(),
+                                 DATA_PLACEHOLDER_END ) != 0 ) {
+          tag_end++;
+        }
+
+        end = ( tag_end > end + 1 ) ? tag_end : string::npos;
+      }
+
+      if ( end != string::npos and end > hash_start and
+           str.compare( end, DATA_PLACEHOLDER_END.length(), DATA_PLACEHOLDER_END ) == 0 ) {
+        hash_end = end;
+        return pos;
+      }
+
+      pos++;
+    }
+
+    return string::npos;
+  }
+
+  string substitute( const string & str, const Function::PathFunc & path_of )
+  {
+    size_t hash_end;
+    size_t pos = find_placeholder( str, 0, hash_end );
+
+    if ( pos == string::npos ) {
+      return str;
+    }
+
+    string result;
+    size_t last = 0;
+
+    for ( ; pos != string::npos; pos = find_placeholder( str, last, hash_end ) ) {
+      /* the output tag isn't part of the path */
+      const size_t hash_start = pos + DATA_PLACEHOLDER_START.length();
+      size_t tag_start = hash_start;
+      while ( is_hash_char( str[ tag_start ] ) ) { tag_start++; }
+
+      result.append( str, last, pos - last );
+      result.append( path_of( str.substr( hash_start, tag_start - hash_start ) ) );
+      last = hash_end + DATA_PLACEHOLDER_END.length();
+    }
+
+    result.append( str, last, string::npos );
+    return result;
+  }
+
+}
+
+string & Function::string_at( const size_t index )
+{
+  return ( index < args_.size() ) ? args_[ index ] : envars_[ index - args_.size() ];
+}
+
+void Function::index_placeholders()
+{
+  indexed_ = true;
+  placeholders_.resize( args_.size() + envars_.size() );
+
+  for ( size_t i = 0; i < placeholders_.size(); i++ ) {
+    index_placeholders( i );
+  }
+}
+
+void Function::index_placeholders( const size_t index )
+{
+  const string & str = string_at( index );
+  vector<Placeholder> & placeholders = placeholders_[ index ];
+
+  size_t hash_end;
+  size_t pos = find_placeholder( str, 0, hash_end );
+
+  for ( ; pos != string::npos; pos = find_placeholder( str, pos, hash_end ) ) {
+    const size_t hash_start = pos + DATA_PLACEHOLDER_START.length();
+    placeholders.push_back( { pos, str.substr( hash_start, hash_end - hash_start ) } );
+
+    vector<size_t> & references = references_[ placeholders.back().hash ];
+    if ( references.empty() or references.back() != index ) {
+      references.push_back( index );
+    }
+
+    pos = hash_end + DATA_PLACEHOLDER_END.length();
+  }
+}
+
+void Function::add_envar( const string & envar )
+{
+  envars_.push_back( envar );
+
+  if ( indexed_ ) {
+    placeholders_.emplace_back();
+    index_placeholders( placeholders_.size() - 1 );
+  }
+}
+
+bool Function::replace_placeholders( const string & old_hash,
+                                     const string & new_hash )
+{
+  if ( not indexed_ ) {
+    index_placeholders();
+  }
+
+  auto old_references = references_.find( old_hash );
+
+  if ( old_hash == new_hash or old_references == references_.end() ) {
+    return false;
+  }
+
+  const vector<size_t> indices = move( old_references->second );
+  references_.erase( old_references );
+
+  vector<size_t> & new_references = references_[ new_hash ];
+
+  for ( const size_t index : indices ) {
+    string & str = string_at( index );
+    string result;
+    size_t last = 0;
+    bool changed = false;
+
+    for ( Placeholder & placeholder : placeholders_[ index ] ) {
+      result.append( str, last, placeholder.offset - last );
+      last = placeholder.offset + placeholder_length( placeholder.hash );
+
+      if ( placeholder.hash == old_hash ) {
+        placeholder.hash = new_hash;
+        changed = true;
+      }
+
+      placeholder.offset = result.length();
+      result.append( data_placeholder( placeholder.hash ) );
+    }
+
+    if ( not changed ) {
+      continue;
+    }
+
+    result.append( str, last, string::npos );
+    str = move( result );
+    new_references.push_back( index );
+  }
+
+  return true;
+}
+
+vector<string> Function::substituted_args( const PathFunc & path_of ) const
+{
+  vector<string> result;
+  result.reserve( args_.size() );
+
+  for ( const string & arg : args_ ) {
+    result.push_back( substitute( arg, path_of ) );
+  }
+
+  return result;
+}
+
+vector<string> Function::substituted_envars( const PathFunc & path_of ) const
+{
+  vector<string> result;
+  result.reserve( envars_.size() );
+
+  for ( const string & envar : envars_ ) {
+    result.push_back( substitute( envar, path_of ) );
+  }
+
+  return result;
+}
+
 protobuf::Function Function::to_protobuf() const
 {
   protobuf::Function func;
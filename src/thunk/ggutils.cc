@@ -2,20 +2,25 @@
 
 #include "ggutils.hh"
 
+#include <map>
 #include <sstream>
 #include <iomanip>
 #include <sys/types.h>
 #include <sys/fcntl.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <crypto++/sha.h>
 #include <crypto++/hex.h>
 #include <crypto++/base64.h>
 
+#include "hash_cache.hh"
+#include "reduction_index.hh"
 #include "thunk_reader.hh"
 #include "util/digest.hh"
 #include "util/exception.hh"
 #include "util/file_descriptor.hh"
+#include "util/parallel.hh"
 #include "util/tokenize.hh"
 #include "util/util.hh"
 #include "util/xdg.hh"
@@ -145,7 +150,7 @@ namespace gg {
 
     roost::path hash_cache()
     {
-      const static roost::path hash_cache_path = get_inner_directory( "hash_cache" );
+      const static roost::path hash_cache_path = root() / "hash_cache.db";
       return hash_cache_path;
     }
 
@@ -197,13 +202,6 @@ namespace gg {
       return remote_dir;
     }
 
-    roost::path hash_cache_entry( const string & filename, const struct stat & stat_entry )
-    {
-      const string cache_key = to_string( stat_entry.st_dev ) + "-"
-        + to_string( stat_entry.st_ino ) + "-" + roost::rbasename( filename ).string();
-      return hash_cache() / cache_key;
-    }
-
     roost::path dependency_cache_entry( const string & cache_key )
     {
       return dependency_cache() / cache_key;
@@ -243,24 +241,51 @@ namespace gg {
 
   namespace cache {
 
+    ReductionIndex & index()
+    {
+      static ReductionIndex reduction_index { gg::paths::reductions() };
+      return reduction_index;
+    }
+
     Optional<ReductionResult> check( const string & thunk_hash )
     {
-      roost::path reduction { gg::paths::reduction( thunk_hash ) };
+      const Optional<Hash> result = index().check( Hash( thunk_hash ) );
 
-      if ( not roost::exists( reduction ) ) {
-        return {}; // no reductions are available
+      if ( not result.initialized() ) {
+        return {};
       }
 
-      FileDescriptor cache_entry { CheckSystemCall( "open( " + reduction.string() + " )",
-                                                    open( reduction.string().c_str(), O_RDONLY ) ) };
-      const string output_hash = cache_entry.read_exactly( gg::hash::length );
-
-      return ReductionResult { output_hash };
+      return ReductionResult { result->str() };
     }
 
     void insert( const string & old_hash, const string & new_hash )
     {
-      roost::atomic_create( new_hash, gg::paths::reduction( old_hash ) );
+      index().insert( Hash( old_hash ), Hash( new_hash ) );
+    }
+
+    Optional<Hash> check( const Hash & thunk_hash )
+    {
+      return index().check( thunk_hash );
+    }
+
+    void insert( const Hash & old_hash, const Hash & new_hash )
+    {
+      index().insert( old_hash, new_hash );
+    }
+
+    void set_batch_size( const size_t batch_size )
+    {
+      index().set_batch_size( batch_size );
+    }
+
+    void flush()
+    {
+      index().flush();
+    }
+
+    void clear()
+    {
+      index().clear();
     }
 
   }
@@ -283,85 +308,223 @@ namespace gg {
       return thunk_hash + "#" + output_tag;
     }
 
-    string compute( const string & input, const ObjectType type )
+    /* the gg hash of `length` bytes, given their SHA-256 digest */
+    static string from_digest( string && digest, const ObjectType type,
+                               const uint64_t length )
     {
-      string ret { move( digest::sha256( input ) ) };
       ostringstream output_sstr;
 
-      replace( ret.begin(), ret.end(), '-', '.' );
-      output_sstr << to_underlying( type ) << ret << setfill( '0' )
-                  << setw( 8 ) << hex << input.length();
+      replace( digest.begin(), digest.end(), '-', '.' );
+      output_sstr << to_underlying( type ) << digest << setfill( '0' )
+                  << setw( 8 ) << hex << length;
       return output_sstr.str();
     }
 
+    /* reads until the buffer is full or the file ends, and returns the
+       number of bytes read */
+    static size_t fill( FileDescriptor & file, string & buffer )
+    {
+      size_t filled = 0;
+
+      while ( filled < buffer.size() ) {
+        const ssize_t bytes_read =
+          CheckSystemCall( "read", ::read( file.fd_num(), &buffer[ filled ],
+                                           buffer.size() - filled ) );
+
+        if ( bytes_read == 0 ) {
+          break;
+        }
+
+        filled += bytes_read;
+      }
+
+      return filled;
+    }
+
+    string compute( const string & input, const ObjectType type )
+    {
+      /* a version 2 thunk isn't hashed as a whole */
+      if ( type == ObjectType::Thunk and
+           input.compare( 0, thunk::MAGIC_NUMBER_V2.length(), thunk::MAGIC_NUMBER_V2 ) == 0 ) {
+        return ThunkReader::parse( input ).hash();
+      }
+
+      return from_digest( digest::sha256( input ), type, input.length() );
+    }
+
     string file_force( const roost::path & path, Optional<ObjectType> type )
     {
       FileDescriptor file { CheckSystemCall( "open (" + path.string() + ")",
                                              open( path.string().c_str(), O_RDONLY ) ) };
 
-      string contents;
-      while ( not file.eof() ) { contents += file.read(); }
+      struct stat file_stat;
+      CheckSystemCall( "fstat", fstat( file.fd_num(), &file_stat ) );
+
+      /* the file goes through one buffer at a time, so a large file takes no
+         more memory to hash than a small one. a small file gets a buffer
+         that's one byte larger than the file, to see the end in one go, and
+         is hashed with as few system calls as reading it whole. */
+      const size_t buffer_size =
+        S_ISREG( file_stat.st_mode )
+        ? min<size_t>( BUFFER_SIZE, file_stat.st_size + 1 )
+        : BUFFER_SIZE;
+
+      if ( buffer_size == BUFFER_SIZE ) {
+        posix_fadvise( file.fd_num(), 0, 0, POSIX_FADV_SEQUENTIAL );
+      }
+
+      string buffer( buffer_size, '\0' );
+      size_t filled = fill( file, buffer );
+
+      auto starts_with =
+        [&buffer, &filled] ( const string & prefix )
+        {
+          return filled >= prefix.size() and buffer.compare( 0, prefix.size(), prefix ) == 0;
+        };
 
       if ( not type.initialized() ) {
-        type = ( contents.size() >= thunk::MAGIC_NUMBER.size() and
-                 contents.compare( 0, thunk::MAGIC_NUMBER.size(),
-                                   gg::thunk::MAGIC_NUMBER ) == 0 )
-               ? ObjectType::Thunk : ObjectType::Value;
+        type = starts_with( thunk::MAGIC_NUMBER ) ? ObjectType::Thunk : ObjectType::Value;
+      }
+
+      /* version 2 thunks have to be parsed, and they're small anyway */
+      if ( *type == ObjectType::Thunk and starts_with( thunk::MAGIC_NUMBER_V2 ) ) {
+        string contents { buffer, 0, filled };
+
+        while ( ( filled = fill( file, buffer ) ) > 0 ) {
+          contents.append( buffer, 0, filled );
+        }
+
+        return compute( contents, *type );
+      }
+
+      digest::StreamingSHA256 hash_function;
+      uint64_t length = 0;
+
+      while ( filled > 0 ) {
+        hash_function.update( buffer.data(), filled );
+        length += filled;
+
+        /* a buffer that isn't full means the file has ended */
+        if ( filled < buffer.size() ) {
+          break;
+        }
+
+        filled = fill( file, buffer );
+      }
+
+      return from_digest( hash_function.finish(), *type, length );
+    }
+
+    static HashCache & hash_cache()
+    {
+      static HashCache cache { gg::paths::hash_cache() };
+      return cache;
+    }
+
+    /* file(), for a file that was stat'ed already */
+    static string cached_file( const roost::path & path, const struct stat & file_stat,
+                               const Optional<ObjectType> & type )
+    {
+      const Optional<string> cached_hash = hash_cache().get( path.string(), file_stat );
+
+      if ( cached_hash.initialized() ) {
+        return *cached_hash;
       }
 
-      return gg::hash::compute( contents, *type );
+      const string computed_hash = gg::hash::file_force( path, type );
+      hash_cache().put( path.string(), file_stat, computed_hash );
+
+      return computed_hash;
     }
 
     string file( const roost::path & path, Optional<ObjectType> type )
     {
       struct stat file_stat;
       CheckSystemCall( "stat", stat( path.string().c_str(), &file_stat ) );
-      const auto cache_entry_path = gg::paths::hash_cache_entry( path.string(), file_stat );
+      return cached_file( path, file_stat, type );
+    }
 
-      if ( roost::exists( cache_entry_path ) ) {
-        string cache_entry = roost::read_file( cache_entry_path );
-        vector<string> cache_contents = split( cache_entry, " " );
+    static vector<string> hash_files( const vector<roost::path> & paths,
+                                      const Optional<ObjectType> & type,
+                                      const bool use_cache )
+    {
+      vector<struct stat> stats( paths.size() );
 
-        if ( cache_contents.size() != 6 ) {
-          throw runtime_error( "bad cache entry: " + cache_entry_path.string() );
-        }
+      parallel_for( paths.size(), io_thread_count(),
+        [&] ( const size_t i )
+        {
+          CheckSystemCall( "stat (" + paths[ i ].string() + ")",
+                           stat( paths[ i ].string().c_str(), &stats[ i ] ) );
+        } );
+
+      /* a file that's named more than once, or through hard links, is only
+         hashed once */
+      map<pair<dev_t, ino_t>, size_t> unique_index;
+      vector<size_t> unique_files;
+      vector<size_t> file_index;
 
-        if ( cache_contents.at( 0 ) == to_string( file_stat.st_size )
-             and cache_contents.at( 1 ) == to_string( file_stat.st_mtim.tv_sec )
-             and cache_contents.at( 2 ) == to_string( file_stat.st_mtim.tv_nsec )
-             and cache_contents.at( 3 ) == to_string( file_stat.st_ctim.tv_sec )
-             and cache_contents.at( 4 ) == to_string( file_stat.st_ctim.tv_nsec ) ) {
-          /* cache hit! */
-          return cache_contents.at( 5 );
+      for ( size_t i = 0; i < paths.size(); i++ ) {
+        auto entry = unique_index.emplace( make_pair( stats[ i ].st_dev, stats[ i ].st_ino ),
+                                           unique_files.size() );
+
+        if ( entry.second ) {
+          unique_files.push_back( i );
         }
+
+        file_index.push_back( entry.first->second );
       }
 
-      const string computed_hash = gg::hash::file_force( path, type );
+      vector<string> unique_hashes( unique_files.size() );
 
-      roost::atomic_create( to_string( file_stat.st_size ) + " "
-                            + to_string( file_stat.st_mtim.tv_sec ) + " "
-                            + to_string( file_stat.st_mtim.tv_nsec ) + " "
-                            + to_string( file_stat.st_ctim.tv_sec ) + " "
-                            + to_string( file_stat.st_ctim.tv_nsec ) + " "
-                            + computed_hash,
-                            cache_entry_path );
+      parallel_for( unique_files.size(), io_thread_count(),
+        [&] ( const size_t j )
+        {
+          const size_t i = unique_files[ j ];
+          unique_hashes[ j ] = use_cache ? cached_file( paths[ i ], stats[ i ], type )
+                                         : file_force( paths[ i ], type );
+        } );
 
-      return computed_hash;
+      vector<string> hashes;
+      hashes.reserve( paths.size() );
+
+      for ( const size_t j : file_index ) {
+        hashes.push_back( unique_hashes[ j ] );
+      }
+
+      return hashes;
     }
 
-    string to_hex( const string & gghash )
+    vector<string> files( const vector<roost::path> & paths, Optional<ObjectType> type )
+    {
+      return hash_files( paths, type, true );
+    }
+
+    vector<string> files_force( const vector<roost::path> & paths, Optional<ObjectType> type )
+    {
+      return hash_files( paths, type, false );
+    }
+
+    /* the hex form of a base64url sha256 digest */
+    static string digest_to_hex( string digest )
     {
       string output;
 
-      string hash = gghash.substr( 1, gghash.length() - 9 );
-      replace( hash.begin(), hash.end(), '.', '-' );
-      hash += '=';
+      replace( digest.begin(), digest.end(), '.', '-' );
+      digest += '=';
 
-      StringSource s( hash, true,
+      StringSource s( digest, true,
                       new Base64URLDecoder(
                       new HexEncoder(
                       new StringSink( output ), false ) ) );
 
+      return output;
+    }
+
+    string to_hex( const string & gghash )
+    {
+      /* the size after the digest can be longer than 8 digits */
+      const string output = digest_to_hex( gghash.substr( 1, 43 ) );
+
       if ( output.length() == 64 ) {
         return output;
       }
@@ -370,10 +533,25 @@ namespace gg {
       }
     }
 
-    uint32_t size( const string & hash )
+    string content_sha256( const string & gghash, const roost::path & path )
+    {
+      if ( type( gghash ) == ObjectType::Value ) {
+        return to_hex( gghash );
+      }
+
+      /* a version 1 thunk is named after its contents, too */
+      const string contents = roost::read_file( path );
+
+      if ( contents.compare( 0, thunk::MAGIC_NUMBER_V2.length(), thunk::MAGIC_NUMBER_V2 ) != 0 ) {
+        return to_hex( gghash );
+      }
+
+      return digest_to_hex( digest::sha256( contents ) );
+    }
+
+    uint64_t size( const string & hash )
     {
-      assert( hash.length() >= 8 );
-      return stoul( hash.substr( hash.length() - 8 ), nullptr, 16 );
+      return Hash( hash ).size();
     }
 
     ObjectType type( const string & hash )
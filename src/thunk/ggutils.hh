@@ -29,7 +29,6 @@ namespace gg {
     roost::path reduction( const std::string & hash );
     roost::path metadata( const std::string & hash );
     roost::path remote( const std::string & hash );
-    roost::path hash_cache_entry( const std::string & filename, const struct stat & stat_entry );
     roost::path dependency_cache_entry( const std::string & cache_key );
     roost::path include_cache_entry( const std::string & hash );
     roost::path blueprint( const std::string & hash );
@@ -49,6 +48,19 @@ namespace gg {
 
     Optional<ReductionResult> check( const std::string & thunk_hash );
     void insert( const std::string & old_hash, const std::string & new_hash );
+
+    /* same, without going through the textual form of the hashes */
+    Optional<Hash> check( const Hash & thunk_hash );
+    void insert( const Hash & old_hash, const Hash & new_hash );
+
+    /* by default, every insert goes to the disk right away; with a batch size
+       set, the entries are written out once that many are pending, or when
+       flush() is called (or the process exits). */
+    void set_batch_size( const size_t batch_size );
+    void flush();
+
+    /* forgets every reduction, in this process and on the disk */
+    void clear();
   }
 
   namespace hash {
@@ -63,9 +75,23 @@ namespace gg {
     std::string compute( const std::string & input, const ObjectType type );
     std::string file( const roost::path & path, Optional<ObjectType> type = {} );
     std::string file_force( const roost::path & path, Optional<ObjectType> type = {} );
+
+    /* the hashes of the given files, in the same order, as file() and
+       file_force() would give them; the files are stat'ed and hashed on
+       several threads */
+    std::vector<std::string> files( const std::vector<roost::path> & paths,
+                                    Optional<ObjectType> type = {} );
+    std::vector<std::string> files_force( const std::vector<roost::path> & paths,
+                                          Optional<ObjectType> type = {} );
     std::string to_hex( const std::string & gghash );
 
-    uint32_t size( const std::string & gghash );
+    /* the sha256 of the object's contents, in hex, for storage services
+       that check what they're sent. that's the digest in the hash, except
+       for version 2 thunks, which are named after their sections; their
+       contents are hashed again, from the object at the given path. */
+    std::string content_sha256( const std::string & gghash, const roost::path & path );
+
+    uint64_t size( const std::string & gghash );
     ObjectType type( const std::string & gghash );
   }
 
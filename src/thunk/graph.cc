@@ -2,6 +2,11 @@
 
 #include "graph.hh"
 
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include <stdexcept>
 
 #include "ggutils.hh"
@@ -13,67 +18,405 @@ using namespace std;
 using namespace gg;
 using namespace gg::thunk;
 
-string ExecutionGraph::add_thunk( const string & full_hash )
+Thunk ExecutionGraph::read_thunk( const Hash & hash ) const
 {
-  const string hash = gg::hash::base( full_hash );
-  const string & updated = updated_hash( hash );
+  if ( snapshot_ ) {
+    Optional<Thunk> thunk = snapshot_->thunk( hash );
 
-  if ( thunks_.count( updated ) ) {
+    if ( thunk.initialized() ) {
+      return move( *thunk );
+    }
+  }
+
+  const string hash_str = hash.str();
+  return ThunkReader::read( gg::paths::blob( hash_str ), hash_str );
+}
+
+namespace {
+
+  /* roughly what a thunk takes in memory: its strings, and what the
+     containers spend on each of them */
+  size_t approximate_footprint( const Thunk & thunk )
+  {
+    size_t total = sizeof( Thunk ) + thunk.function().hash().length();
+
+    auto add_strings =
+      [&total] ( const vector<string> & strings )
+      {
+        for ( const string & str : strings ) {
+          total += sizeof( string ) + str.length();
+        }
+      };
+
+    auto add_data =
+      [&total] ( const Thunk::DataList & list )
+      {
+        for ( const auto & item : list ) {
+          total += sizeof( string ) + sizeof( void * ) + item.first.length();
+        }
+      };
+
+    add_strings( thunk.function().args() );
+    add_strings( thunk.function().envars() );
+    add_strings( thunk.outputs() );
+    add_data( thunk.values() );
+    add_data( thunk.thunks() );
+    add_data( thunk.executables() );
+
+    return total;
+  }
+
+}
+
+void ExecutionGraph::set_memory_limit( const size_t bytes, const string & spill_directory )
+{
+  memory_limit_ = bytes;
+
+  if ( memory_limit_ > 0 and not spill_file_ ) {
+    spill_file_ = make_unique<SpillFile>( ( roost::path( spill_directory ) / "graph-spill" ).string() );
+  }
+}
+
+void ExecutionGraph::insert_thunk( const Hash & hash, Thunk && thunk, const bool may_spill )
+{
+  if ( memory_limit_ == 0 ) {
+    thunks_.emplace( piecewise_construct, forward_as_tuple( hash ),
+                     forward_as_tuple( move( thunk ) ) );
+    return;
+  }
+
+  const size_t footprint = approximate_footprint( thunk );
+
+  if ( may_spill and resident_bytes_ + footprint > memory_limit_ ) {
+    spilled_.emplace( hash, SpilledThunk { spill_file_->append( ThunkWriter::serialize( thunk ) ), {},
+                                           thunk.function().hash(), thunk.timeout() } );
+    return;
+  }
+
+  resident_bytes_ += footprint;
+  footprints_[ hash ] = footprint;
+  thunks_.emplace( piecewise_construct, forward_as_tuple( hash ),
+                   forward_as_tuple( move( thunk ) ) );
+}
+
+void ExecutionGraph::erase_thunk( const Hash & hash )
+{
+  thunks_.erase( hash );
+
+  if ( spilled_.erase( hash ) ) {
+    paged_thunk_.reset();
+  }
+
+  auto footprint = footprints_.find( hash );
+
+  if ( footprint != footprints_.end() ) {
+    resident_bytes_ -= footprint->second;
+    footprints_.erase( footprint );
+  }
+}
+
+Thunk ExecutionGraph::read_spilled( const SpilledThunk & spilled ) const
+{
+  Thunk thunk = ThunkReader::parse( spill_file_->read( spilled.record ) );
+
+  for ( const auto & update : spilled.updates ) {
+    thunk.update_data( update.first, update.second );
+  }
+
+  return thunk;
+}
+
+Thunk & ExecutionGraph::resident_thunk( const Hash & hash )
+{
+  auto resident = thunks_.find( hash );
+
+  if ( resident != thunks_.end() ) {
+    return resident->second;
+  }
+
+  Thunk thunk = read_spilled( spilled_.at( hash ) );
+  spilled_.erase( hash );
+  paged_thunk_.reset();
+
+  insert_thunk( hash, move( thunk ), false );
+  return thunks_.at( hash );
+}
+
+const Thunk & ExecutionGraph::get_thunk( const Hash & hash ) const
+{
+  auto resident = thunks_.find( hash );
+
+  if ( resident != thunks_.end() ) {
+    return resident->second;
+  }
+
+  if ( not paged_thunk_ or paged_thunk_->first != hash ) {
+    paged_thunk_ = make_unique<pair<Hash, Thunk>>( hash, read_spilled( spilled_.at( hash ) ) );
+  }
+
+  return paged_thunk_->second;
+}
+
+ExecutionGraph::Cost ExecutionGraph::cost( const Hash & hash ) const
+{
+  auto spilled = spilled_.find( hash );
+
+  if ( spilled != spilled_.end() ) {
+    return { spilled->second.function_hash, spilled->second.timeout };
+  }
+
+  const Thunk & thunk = thunks_.at( hash );
+  return { thunk.function().hash(), thunk.timeout() };
+}
+
+Hash ExecutionGraph::add_thunk( const Hash & hash )
+{
+  unordered_map<Hash, Thunk> loaded;
+  return add_thunk( hash, loaded );
+}
+
+vector<Hash> ExecutionGraph::add_thunks( const vector<Hash> & hashes,
+                                         const size_t thread_count )
+{
+  /* with a single thread, the thunks are read as they're added */
+  unordered_map<Hash, Thunk> loaded;
+
+  if ( thread_count > 1 ) {
+    loaded = load_thunks( hashes, thread_count );
+  }
+
+  vector<Hash> result;
+
+  for ( const Hash & hash : hashes ) {
+    result.emplace_back( add_thunk( hash, loaded ) );
+  }
+
+  return result;
+}
+
+unordered_map<Hash, Thunk>
+ExecutionGraph::load_thunks( const vector<Hash> & hashes,
+                             const size_t thread_count ) const
+{
+  unordered_map<Hash, Thunk> loaded;
+
+  mutex state_mutex;
+  condition_variable state_changed;
+  deque<Hash> to_load;
+  unordered_set<Hash> seen;
+  size_t in_progress = 0;
+  exception_ptr failure;
+
+  auto enqueue =
+    [&] ( const Hash & full_hash )
+    {
+      const Hash hash = full_hash.base();
+
+      /* shared subgraphs are only loaded once */
+      if ( not has_thunk( updated_hash( hash ) ) and
+           not has_thunk( hash ) and seen.insert( hash ).second ) {
+        to_load.push_back( hash );
+      }
+    };
+
+  for ( const Hash & hash : hashes ) {
+    enqueue( hash );
+  }
+
+  auto worker =
+    [&] ()
+    {
+      unique_lock<mutex> lock { state_mutex };
+
+      while ( true ) {
+        state_changed.wait( lock, [&] { return not to_load.empty() or in_progress == 0
+                                               or failure; } );
+
+        if ( failure or to_load.empty() ) {
+          return;
+        }
+
+        const Hash hash { to_load.front() };
+        to_load.pop_front();
+        in_progress++;
+        lock.unlock();
+
+        try {
+          Thunk thunk { read_thunk( hash ) };
+          vector<Hash> dependencies;
+
+          for ( const auto & item : thunk.thunks() ) {
+            dependencies.emplace_back( item.first );
+          }
+
+          lock.lock();
+
+          for ( const Hash & dependency : dependencies ) {
+            enqueue( dependency );
+          }
+
+          loaded.emplace( piecewise_construct,
+                          forward_as_tuple( hash ),
+                          forward_as_tuple( move( thunk ) ) );
+        }
+        catch ( ... ) {
+          if ( not lock.owns_lock() ) {
+            lock.lock();
+          }
+
+          failure = current_exception();
+        }
+
+        in_progress--;
+        state_changed.notify_all();
+      }
+    };
+
+  vector<thread> threads;
+
+  for ( size_t i = 0; i < thread_count; i++ ) {
+    threads.emplace_back( worker );
+  }
+
+  for ( auto & thread : threads ) {
+    thread.join();
+  }
+
+  if ( failure ) {
+    rethrow_exception( failure );
+  }
+
+  return loaded;
+}
+
+Hash ExecutionGraph::add_thunk( const Hash & full_hash,
+                                unordered_map<Hash, Thunk> & loaded )
+{
+  const Hash hash = full_hash.base();
+  const Hash updated = updated_hash( hash );
+
+  if ( has_thunk( updated ) ) {
     return updated;
   }
 
-  if ( thunks_.count( hash ) ) {
+  if ( has_thunk( hash ) ) {
     return hash;
   }
 
-  Thunk thunk { move( ThunkReader::read( gg::paths::blob( hash ), hash ) ) };
+  auto preloaded = loaded.find( hash );
+
+  Thunk thunk { ( preloaded != loaded.end() )
+                ? move( preloaded->second )
+                : read_thunk( hash ) };
 
+  /* it might have been queued to be read by a deferred load */
+  reading_.erase( hash );
+
+  insert_loaded( hash, move( thunk ),
+                 [this, &loaded] ( const Hash & dependency )
+                 { return add_thunk( dependency, loaded ); } );
+
+  return hash;
+}
+
+void ExecutionGraph::defer_read( const Hash & hash )
+{
+  if ( reading_.insert( hash ).second ) {
+    to_read_.push_back( hash );
+  }
+}
+
+void ExecutionGraph::add_loaded_thunk( const Hash & hash, Thunk && thunk )
+{
+  /* it was added some other way while it was being read */
+  if ( reading_.erase( hash ) == 0 or has_thunk( hash ) ) {
+    return;
+  }
+
+  insert_loaded( hash, move( thunk ),
+                 [this] ( const Hash & dependency )
+                 {
+                   const Hash updated = updated_hash( dependency );
+
+                   if ( has_thunk( updated ) or is_reading( updated ) ) {
+                     return updated;
+                   }
+
+                   if ( not has_thunk( dependency ) ) {
+                     defer_read( dependency );
+                   }
+
+                   return dependency;
+                 } );
+}
+
+vector<Hash> ExecutionGraph::take_thunks_to_read()
+{
+  vector<Hash> result;
+  result.swap( to_read_ );
+  return result;
+}
+
+void ExecutionGraph::insert_loaded( const Hash & hash, Thunk && thunk,
+                                    const function<Hash( const Hash & )> & add_dependency )
+{
   /* creating the entry */
   referencing_thunks_[ hash ];
 
-  for ( const Thunk::DataItem & item : thunk.values() ) {
+  for ( const auto & item : thunk.values() ) {
     value_dependencies_.emplace( item.first );
   }
 
-  for ( const Thunk::DataItem & item : thunk.executables() ) {
+  for ( const auto & item : thunk.executables() ) {
     executable_dependencies_.emplace( item.first );
   }
 
-  vector<pair<string, string>> updates_to_thunk;
+  vector<pair<Hash, Hash>> updates_to_thunk;
+  size_t unresolved_count = 0;
 
-  for ( const Thunk::DataItem & item : thunk.thunks() ) {
-    const string item_base = gg::hash::base( item.first );
-    const string item_updated = add_thunk( item_base );
-    referencing_thunks_[ item_updated ].emplace( hash );
+  for ( const auto & item : thunk.thunks() ) {
+    const Hash item_base = Hash( item.first ).base();
+    const Hash item_updated = add_dependency( item_base );
+
+    /* different outputs of the same thunk count as one dependency */
+    if ( referencing_thunks_[ item_updated ].emplace( hash ).second ) {
+      unresolved_count++;
+    }
 
     if ( item_updated != item_base ) {
       updates_to_thunk.emplace_back( item_base, item_updated );
     }
   }
 
-  for ( const pair<string, string> & update : updates_to_thunk ) {
+  for ( const pair<Hash, Hash> & update : updates_to_thunk ) {
+    const string new_hash = update.second.str();
     vector<ThunkOutput> new_outputs;
+
     for ( const auto & output : thunk.outputs() ) {
-      new_outputs.emplace_back( update.second, output );
+      new_outputs.emplace_back( new_hash, output );
     }
 
-    thunk.update_data( update.first, new_outputs );
+    thunk.update_data( update.first.str(), new_outputs );
   }
 
-  thunks_.emplace( piecewise_construct,
-                   forward_as_tuple( hash ),
-                   forward_as_tuple( move( thunk ) ) );
+  unresolved_dependencies_[ hash ] = unresolved_count;
 
-  return hash;
+  if ( unresolved_count == 0 ) {
+    ready_thunks_.insert( hash );
+  }
+
+  insert_thunk( hash, move( thunk ), unresolved_count > 0 );
 }
 
-void ExecutionGraph::update_hash( const string & old_hash,
-                                  const vector<ThunkOutput> & outputs )
+vector<Hash> ExecutionGraph::update_hash( const Hash & old_hash,
+                                          const vector<ThunkOutput> & outputs )
 {
-  const string & new_hash = outputs.front().hash;
+  const Hash new_hash { outputs.front().hash };
+  const bool reduced_to_thunk = new_hash.is_thunk();
+  const string old_hash_str = old_hash.str();
 
   /* updating the hash chain */
-  if ( gg::hash::type( new_hash ) == gg::ObjectType::Thunk ) {
+  if ( reduced_to_thunk ) {
     if ( original_hashes_.count( old_hash ) == 0 ) {
       original_hashes_[ new_hash ] = old_hash;
       updated_hashes_[ old_hash ] = new_hash;
@@ -83,27 +426,56 @@ void ExecutionGraph::update_hash( const string & old_hash,
       updated_hashes_[ original_hashes_[ old_hash ] ] = new_hash;
       original_hashes_.erase( old_hash );
     }
+
+    /* creating the entry */
+    referencing_thunks_[ new_hash ];
   }
 
+  /* we don't need the old referencing thunks list */
+  auto referencing_entry = referencing_thunks_.find( old_hash );
+  const unordered_set<Hash> referencing { move( referencing_entry->second ) };
+  referencing_thunks_.erase( referencing_entry );
+
+  vector<Hash> released;
+
   /* updating the thunks that are referencing this thunk */
-  for ( const string & referencing_thunk_hash : referencing_thunks_.at( old_hash ) ) {
-    Thunk & referencing_thunk = thunks_.at( referencing_thunk_hash );
-    referencing_thunk.update_data( old_hash, outputs );
+  for ( const Hash & referencing_thunk_hash : referencing ) {
+    auto spilled = spilled_.find( referencing_thunk_hash );
+
+    if ( spilled != spilled_.end() ) {
+      spilled->second.updates.emplace_back( old_hash_str, outputs );
+      paged_thunk_.reset();
+    }
+    else {
+      thunks_.at( referencing_thunk_hash ).update_data( old_hash_str, outputs );
+    }
+
+    size_t & unresolved_count = unresolved_dependencies_.at( referencing_thunk_hash );
+
+    if ( reduced_to_thunk ) {
+      /* the dependency moves to the new thunk, unless the referencing thunk
+         was already waiting on it */
+      if ( not referencing_thunks_[ new_hash ].emplace( referencing_thunk_hash ).second ) {
+        unresolved_count--;
+      }
+    }
+    else if ( --unresolved_count == 0 ) {
+      released.push_back( referencing_thunk_hash );
+    }
   }
 
   /* we don't need the old thunk entry */
-  thunks_.erase( old_hash );
+  erase_thunk( old_hash );
+  unresolved_dependencies_.erase( old_hash );
 
-  /* we don't need the old referencing thunks list */
-  referencing_thunks_[ new_hash ] = move( referencing_thunks_.at( old_hash ) );
-  referencing_thunks_.erase( old_hash );
+  return released;
 }
 
-Optional<unordered_set<string>>
-ExecutionGraph::force_thunk( const string & old_hash,
+Optional<unordered_set<Hash>>
+ExecutionGraph::force_thunk( const Hash & old_hash,
                              vector<ThunkOutput> && original_outputs )
 {
-  if ( thunks_.count( old_hash ) == 0 ) {
+  if ( not has_thunk( old_hash ) ) {
     return { false };
   }
 
@@ -111,80 +483,194 @@ ExecutionGraph::force_thunk( const string & old_hash,
 
   string & actual_new_hash = outputs.front().hash;
 
-  unordered_set<string> next_to_execute;
-  const gg::ObjectType new_type = gg::hash::type( actual_new_hash );
+  unordered_set<Hash> next_to_execute;
 
   /* the old thunk has returned a new thunk. this is not a pipe dream. */
-  if ( new_type == gg::ObjectType::Thunk ) {
-    actual_new_hash = add_thunk( actual_new_hash );
-  }
-
-  update_hash( old_hash, outputs );
-
-  for ( const string & referencing_thunk_hash : referencing_thunks_.at( actual_new_hash ) ) {
-    Thunk & referencing_thunk = thunks_.at( referencing_thunk_hash );
+  if ( gg::hash::type( actual_new_hash ) == gg::ObjectType::Thunk ) {
+    const Hash new_hash = Hash( actual_new_hash ).base();
+    const Hash updated = updated_hash( new_hash );
+
+    if ( deferred_loading_ and not has_thunk( updated ) and not has_thunk( new_hash ) ) {
+      /* the thunks that are waiting on the old thunk can wait on the new one
+         before it's read */
+      const Hash & to_read = is_reading( updated ) ? updated : new_hash;
+      defer_read( to_read );
+      actual_new_hash = to_read.str();
+    }
+    else {
+      actual_new_hash = add_thunk( new_hash ).str();
 
-    if ( referencing_thunk.can_be_executed() ) {
-      const string referencing_thunk_new_hash = ThunkWriter::write( referencing_thunk );
+      /* the part of the new subgraph that wasn't already loaded might have
+         some thunks that are ready to go */
+      next_to_execute = take_ready_thunks();
+    }
+  }
 
-      vector<ThunkOutput> new_outputs;
-      for ( const auto & output : referencing_thunk.outputs() ) {
-        new_outputs.emplace_back( referencing_thunk_new_hash, output );
-      }
+  /* only the thunks whose last dependency was this one are released */
+  for ( const Hash & referencing_thunk_hash : update_hash( old_hash, outputs ) ) {
+    Thunk & referencing_thunk = resident_thunk( referencing_thunk_hash );
+    const string new_hash_str = ThunkWriter::write( referencing_thunk );
+    const Hash referencing_thunk_new_hash { new_hash_str };
 
-      thunks_.emplace( piecewise_construct,
-                       forward_as_tuple( referencing_thunk_new_hash ),
-                       forward_as_tuple( move( referencing_thunk ) ) );
+    vector<ThunkOutput> new_outputs;
+    for ( const auto & output : referencing_thunk.outputs() ) {
+      new_outputs.emplace_back( new_hash_str, output );
+    }
 
+    /* another thunk might have been updated to the same thunk already, which
+       is ready too, then; the graph only keeps the original hash of the
+       last one that's updated to it */
+    if ( has_thunk( referencing_thunk_new_hash ) or is_reading( referencing_thunk_new_hash ) ) {
+      merged_originals_.emplace_back( original_hash( referencing_thunk_new_hash ),
+                                      original_hash( referencing_thunk_hash ) );
       update_hash( referencing_thunk_hash, new_outputs );
-      next_to_execute.emplace( move( referencing_thunk_new_hash ) );
+      continue;
     }
-  }
 
-  if ( new_type == gg::ObjectType::Thunk ) {
-    next_to_execute = order_one_dependencies( actual_new_hash );
-  }
-  else {
-    /* the thunk has been reducted to a value. we don't need to keep
-    the list of thunks that are referencing it anymore. */
-    referencing_thunks_.erase( actual_new_hash );
+    insert_thunk( referencing_thunk_new_hash, move( referencing_thunk ), false );
+    unresolved_dependencies_.emplace( referencing_thunk_new_hash, 0 );
+
+    update_hash( referencing_thunk_hash, new_outputs );
+    next_to_execute.emplace( referencing_thunk_new_hash );
   }
 
   return { true, move( next_to_execute ) };
 }
 
-unordered_set<string> ExecutionGraph::order_one_dependencies( const string & input_hash ) const
+unordered_set<Hash> ExecutionGraph::order_one_dependencies( const Hash & input_hash ) const
 {
-  const string hash = gg::hash::base( input_hash );
+  const Hash hash = input_hash.base();
 
-  if ( thunks_.count( hash ) == 0 ) {
+  if ( not has_thunk( hash ) ) {
     throw runtime_error( "thunk hash not found in the execution graph" );
   }
 
-  const Thunk & thunk = thunks_.at( hash );
+  /* every thunk in the subgraph is visited once, no matter how many thunks
+     are sharing it */
+  unordered_set<Hash> result;
+  unordered_set<Hash> visited { hash };
+  vector<Hash> to_visit { hash };
+
+  while ( not to_visit.empty() ) {
+    const Hash current { to_visit.back() };
+    to_visit.pop_back();
+
+    /* the thunks that are still being read have nothing to offer yet */
+    if ( is_reading( current ) ) {
+      continue;
+    }
+
+    if ( unresolved_dependencies_.at( current ) == 0 ) {
+      result.insert( current );
+      continue;
+    }
 
-  if ( thunk.can_be_executed() ) {
-    return { hash };
+    for ( const auto & item : get_thunk( current ).thunks() ) {
+      const Hash item_base = Hash( item.first ).base();
+
+      if ( visited.insert( item_base ).second ) {
+        to_visit.push_back( item_base );
+      }
+    }
   }
 
+  return result;
+}
+
+unordered_set<Hash> ExecutionGraph::take_ready_thunks()
+{
+  unordered_set<Hash> result;
+  result.swap( ready_thunks_ );
+  return result;
+}
+
+const unordered_set<Hash> &
+ExecutionGraph::referencing_thunks( const Hash & hash ) const
+{
+  static const unordered_set<Hash> no_referencing_thunks {};
+
+  auto it = referencing_thunks_.find( hash );
+  return ( it != referencing_thunks_.end() ) ? it->second
+                                             : no_referencing_thunks;
+}
+
+unordered_set<string> ExecutionGraph::take_value_dependencies()
+{
   unordered_set<string> result;
+  result.swap( value_dependencies_ );
+  return result;
+}
 
-  for ( const Thunk::DataItem & item : thunk.thunks() ) {
-    auto subresult = order_one_dependencies( item.first );
-    result.insert( subresult.begin(), subresult.end() );
+unordered_set<string> ExecutionGraph::take_executable_dependencies()
+{
+  unordered_set<string> result;
+  result.swap( executable_dependencies_ );
+  return result;
+}
+
+void ExecutionGraph::remove_thunks( const unordered_set<Hash> & hashes )
+{
+  for ( const Hash & hash : hashes ) {
+    if ( not has_thunk( hash ) ) {
+      continue;
+    }
+
+    /* the thunks it's waiting on, which might still run for others */
+    for ( const auto & item : get_thunk( hash ).thunks() ) {
+      auto referencing = referencing_thunks_.find( Hash( item.first ).base() );
+
+      if ( referencing != referencing_thunks_.end() ) {
+        referencing->second.erase( hash );
+      }
+    }
+
+    referencing_thunks_.erase( hash );
+    unresolved_dependencies_.erase( hash );
+    ready_thunks_.erase( hash );
+    erase_thunk( hash );
+
+    auto original = original_hashes_.find( hash );
+
+    if ( original != original_hashes_.end() ) {
+      updated_hashes_.erase( original->second );
+      original_hashes_.erase( original );
+    }
   }
+}
 
-  return result;
+void ExecutionGraph::forget_original( const Hash & original_hash )
+{
+  auto updated = updated_hashes_.find( original_hash );
+
+  if ( updated == updated_hashes_.end() or
+       has_thunk( updated->second ) or is_reading( updated->second ) ) {
+    return;
+  }
+
+  auto original = original_hashes_.find( updated->second );
+
+  if ( original != original_hashes_.end() and original->second == original_hash ) {
+    original_hashes_.erase( original );
+  }
+
+  updated_hashes_.erase( updated );
+}
+
+vector<pair<Hash, Hash>> ExecutionGraph::take_merged_originals()
+{
+  vector<pair<Hash, Hash>> merged;
+  merged.swap( merged_originals_ );
+  return merged;
 }
 
-string ExecutionGraph::updated_hash( const string & original_hash ) const
+Hash ExecutionGraph::updated_hash( const Hash & original_hash ) const
 {
-  return updated_hashes_.count( original_hash ) ? updated_hashes_.at( original_hash )
-                                                : original_hash;
+  auto updated = updated_hashes_.find( original_hash );
+  return ( updated != updated_hashes_.end() ) ? updated->second : original_hash;
 }
 
-string ExecutionGraph::original_hash( const string & updated_hash ) const
+Hash ExecutionGraph::original_hash( const Hash & updated_hash ) const
 {
-  return original_hashes_.count( updated_hash ) ? original_hashes_.at( updated_hash )
-                                                : updated_hash;
+  auto original = original_hashes_.find( updated_hash );
+  return ( original != original_hashes_.end() ) ? original->second : updated_hash;
 }
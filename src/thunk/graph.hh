@@ -6,52 +6,202 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <chrono>
 #include <set>
+#include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <functional>
 
+#include "thunk/hash.hh"
+#include "thunk/snapshot.hh"
 #include "thunk/thunk.hh"
 #include "util/optional.hh"
+#include "util/spill_file.hh"
 
 class ExecutionGraph
 {
 private:
-  std::unordered_map<std::string, gg::thunk::Thunk> thunks_ {};
+  std::unordered_map<gg::Hash, gg::thunk::Thunk> thunks_ {};
 
-  std::unordered_map<std::string, std::unordered_set<std::string>> referencing_thunks_ {};
+  /* reverse edges: for each thunk, the thunks that are waiting on it */
+  std::unordered_map<gg::Hash, std::unordered_set<gg::Hash>> referencing_thunks_ {};
+
+  /* for each thunk, the number of distinct thunks it's still waiting on */
+  std::unordered_map<gg::Hash, size_t> unresolved_dependencies_ {};
+
+  /* thunks that were ready when they were loaded, and haven't been handed
+     out yet */
+  std::unordered_set<gg::Hash> ready_thunks_ {};
 
   std::unordered_set<std::string> value_dependencies_ {};
   std::unordered_set<std::string> executable_dependencies_ {};
 
-  std::unordered_map<std::string, std::string> original_hashes_ {};
-  std::unordered_map<std::string, std::string> updated_hashes_ {};
-
-  void update_hash( const std::string & old_hash,
-                    const std::vector<gg::ThunkOutput> & outputs );
+  std::unordered_map<gg::Hash, gg::Hash> original_hashes_ {};
+  std::unordered_map<gg::Hash, gg::Hash> updated_hashes_ {};
+
+  /* original hashes whose thunks were updated to the same thunk, each one
+     with the original hash that the graph remembers instead */
+  std::vector<std::pair<gg::Hash, gg::Hash>> merged_originals_ {};
+
+  std::shared_ptr<const gg::thunk::GraphSnapshot> snapshot_ {};
+
+  /* With a memory limit, a thunk that's still waiting on its dependencies
+     goes to the spill file instead of memory once the resident thunks are
+     over the limit. The updates it gets while it waits are kept in memory,
+     and applied when it's read back, which is when it becomes ready. The
+     thunks that are ready, and the indices, always stay in memory. */
+  struct SpilledThunk
+  {
+    SpillFile::Record record;
+    std::vector<std::pair<std::string, std::vector<gg::ThunkOutput>>> updates {};
+
+    /* for cost(), which doesn't read the thunk back */
+    std::string function_hash {};
+    std::chrono::milliseconds timeout { 0 };
+  };
+
+  size_t memory_limit_ { 0 };
+  size_t resident_bytes_ { 0 };
+  std::unique_ptr<SpillFile> spill_file_ {};
+  std::unordered_map<gg::Hash, SpilledThunk> spilled_ {};
+  std::unordered_map<gg::Hash, size_t> footprints_ {};
+
+  /* the last spilled thunk that get_thunk() returned */
+  mutable std::unique_ptr<std::pair<gg::Hash, gg::thunk::Thunk>> paged_thunk_ {};
+
+  /* With deferred loading, a thunk that an execution returns isn't read
+     right away: the thunks that were waiting on the old thunk wait on the
+     new one, which is read by the caller and added with add_loaded_thunk(),
+     along with the thunks it depends on, one level at a time. */
+  bool deferred_loading_ { false };
+  std::unordered_set<gg::Hash> reading_ {};
+  std::vector<gg::Hash> to_read_ {};
+
+  /* queues the thunk to be read, unless it's already being read */
+  void defer_read( const gg::Hash & hash );
+
+  /* adds a thunk whose dependencies were resolved by `add_dependency`, which
+     returns the hash the dependency goes by in the graph */
+  void insert_loaded( const gg::Hash & hash, gg::thunk::Thunk && thunk,
+                      const std::function<gg::Hash( const gg::Hash & )> & add_dependency );
+
+  void insert_thunk( const gg::Hash & hash, gg::thunk::Thunk && thunk,
+                     const bool may_spill );
+  void erase_thunk( const gg::Hash & hash );
+
+  gg::thunk::Thunk read_spilled( const SpilledThunk & spilled ) const;
+
+  /* reads the thunk back in, if it was spilled */
+  gg::thunk::Thunk & resident_thunk( const gg::Hash & hash );
+
+  /* returns the referencing thunks that have no unresolved dependencies
+     left after this update */
+  std::vector<gg::Hash> update_hash( const gg::Hash & old_hash,
+                                     const std::vector<gg::ThunkOutput> & outputs );
+
+  gg::Hash add_thunk( const gg::Hash & hash,
+                      std::unordered_map<gg::Hash, gg::thunk::Thunk> & loaded );
+
+  /* reads and parses the given thunks and everything they depend on, except
+     for what's already in the graph */
+  std::unordered_map<gg::Hash, gg::thunk::Thunk>
+  load_thunks( const std::vector<gg::Hash> & hashes,
+               const size_t thread_count ) const;
 
 public:
-  std::string add_thunk( const std::string & hash );
+  /* thunks that are in the snapshot are read from it instead of their own
+     files; the ones that aren't, e.g. those created while executing, are
+     still read from the blobs directory */
+  void set_snapshot( const std::shared_ptr<const gg::thunk::GraphSnapshot> & snapshot )
+  { snapshot_ = snapshot; }
+
+  /* keeps the thunks in memory under roughly `bytes`, spilling the rest to
+     a temporary file in the given directory; 0 means no limit */
+  void set_memory_limit( const size_t bytes, const std::string & spill_directory );
+
+  void set_deferred_loading( const bool deferred_loading )
+  { deferred_loading_ = deferred_loading; }
 
-  Optional<std::unordered_set<std::string>>
-  force_thunk( const std::string & old_hash,
+  /* from the snapshot if it's there, or else from the blobs directory. it
+     doesn't touch the graph, so it can be called from other threads. */
+  gg::thunk::Thunk read_thunk( const gg::Hash & hash ) const;
+
+  gg::Hash add_thunk( const gg::Hash & hash );
+
+  /* same as calling add_thunk() on each hash, but the thunk files are read
+     and parsed by `thread_count` threads before anything is added to the
+     graph. returns the hashes that add_thunk() would have returned. */
+  std::vector<gg::Hash> add_thunks( const std::vector<gg::Hash> & hashes,
+                                    const size_t thread_count );
+
+  Optional<std::unordered_set<gg::Hash>>
+  force_thunk( const gg::Hash & old_hash,
                std::vector<gg::ThunkOutput> && outputs );
 
-  const std::unordered_set<std::string> &
-  value_dependencies() const { return value_dependencies_; }
+  /* adds a thunk that was returned by take_thunks_to_read(); the thunks it
+     depends on that aren't in the graph are queued to be read in turn, and
+     if it's ready, it's returned by take_ready_thunks() */
+  void add_loaded_thunk( const gg::Hash & hash, gg::thunk::Thunk && thunk );
+
+  /* the thunks that have to be read and added with add_loaded_thunk(); each
+     one is returned only once */
+  std::vector<gg::Hash> take_thunks_to_read();
+
+  /* true if the thunk has been queued to be read, and isn't in the graph yet */
+  bool is_reading( const gg::Hash & hash ) const { return reading_.count( hash ) > 0; }
+
+  /* the blobs that the thunks need, by their textual hashes, which is how
+     they are named in the storage; each call returns the ones that the
+     thunks added since the last call need */
+  std::unordered_set<std::string> take_value_dependencies();
+  std::unordered_set<std::string> take_executable_dependencies();
+
+  std::unordered_set<gg::Hash>
+  order_one_dependencies( const gg::Hash & hash ) const;
+
+  /* the thunks that were ready to execute when add_thunk() loaded them;
+     each one is returned only once */
+  std::unordered_set<gg::Hash> take_ready_thunks();
+
+  /* a spilled thunk is read back for the caller, and the reference is only
+     good until get_thunk() is called again */
+  const gg::thunk::Thunk & get_thunk( const gg::Hash & hash ) const;
+
+  bool has_thunk( const gg::Hash & hash ) const
+  { return thunks_.count( hash ) > 0 or spilled_.count( hash ) > 0; }
+
+  /* what running the thunk costs; a spilled thunk isn't read back for it.
+     the reference is good until the graph changes. */
+  struct Cost
+  {
+    const std::string & function_hash;
+    std::chrono::milliseconds timeout;
+  };
+
+  Cost cost( const gg::Hash & hash ) const;
+
+  /* the thunks that are waiting on the given thunk */
+  const std::unordered_set<gg::Hash> &
+  referencing_thunks( const gg::Hash & hash ) const;
 
-  const std::unordered_set<std::string> &
-  executable_dependencies() const { return executable_dependencies_; }
+  /* the pairs of original hashes that were merged since the last call; the
+     first one of each pair now goes by the second one */
+  std::vector<std::pair<gg::Hash, gg::Hash>> take_merged_originals();
 
-  std::unordered_set<std::string>
-  order_one_dependencies( const std::string & hash ) const;
+  /* drops the thunks, which have to include every thunk that is waiting on
+     any of them, e.g. the thunks that can't be reduced after a failure */
+  void remove_thunks( const std::unordered_set<gg::Hash> & hashes );
 
-  const gg::thunk::Thunk &
-  get_thunk( const std::string & hash ) const { return thunks_.at( hash ); }
+  /* drops the updated hash of a thunk that was reduced to a value, once
+     nothing asks for it anymore */
+  void forget_original( const gg::Hash & original_hash );
 
-  std::string updated_hash( const std::string & original_hash ) const;
-  std::string original_hash( const std::string & updated_hash ) const;
-  size_t size() const { return thunks_.size(); }
+  gg::Hash updated_hash( const gg::Hash & original_hash ) const;
+  gg::Hash original_hash( const gg::Hash & updated_hash ) const;
+  size_t size() const { return thunks_.size() + spilled_.size(); }
+  size_t spilled_count() const { return spilled_.size(); }
 };
 
 #endif /* GRAPH_HH */
@@ -0,0 +1,215 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "graph_summary.hh"
+
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "graph.hh"
+#include "ggutils.hh"
+#include "thunk.hh"
+#include "util/optional.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+namespace {
+
+  /* the thunks that a thunk depends on, counting each one once no matter
+     how many of its outputs are used */
+  vector<Hash> dependencies( const Thunk & thunk )
+  {
+    vector<Hash> result;
+
+    for ( const auto & item : thunk.thunks() ) {
+      const Hash base = Hash( item.first ).base();
+
+      if ( find( result.begin(), result.end(), base ) == result.end() ) {
+        result.push_back( base );
+      }
+    }
+
+    return result;
+  }
+
+  /* calls `f` for the hash of each value and executable of a thunk */
+  template<class Function>
+  void for_each_input( const Thunk & thunk, Function && f )
+  {
+    for ( const auto & item : thunk.values() ) { f( item.first ); }
+    for ( const auto & item : thunk.executables() ) { f( item.first ); }
+  }
+
+  void add_degrees( const map<uint32_t, uint64_t> & degrees,
+                    google::protobuf::RepeatedPtrField<protobuf::GraphSummary::DegreeCount> & counts )
+  {
+    for ( const auto & degree : degrees ) {
+      auto & count = *counts.Add();
+      count.set_degree( degree.first );
+      count.set_thunks( degree.second );
+    }
+  }
+
+}
+
+protobuf::GraphSummary summarize_graph( const vector<Hash> & targets,
+                                        const size_t thread_count )
+{
+  ExecutionGraph graph;
+  const vector<Hash> roots = graph.add_thunks( targets, thread_count );
+
+  /* for each thunk, its level, and the dependency on the level below it
+     that the critical path goes through */
+  unordered_map<Hash, uint32_t> levels;
+  unordered_map<Hash, Hash> deepest_dependency;
+  vector<Hash> order;
+
+  /* depth-first, without recursion, as the graphs can be very deep */
+  for ( const Hash & root : roots ) {
+    vector<pair<Hash, bool>> to_visit { { root, false } };
+
+    while ( not to_visit.empty() ) {
+      const Hash hash = to_visit.back().first;
+      const bool expanded = to_visit.back().second;
+      to_visit.pop_back();
+
+      if ( levels.count( hash ) ) {
+        continue;
+      }
+
+      const vector<Hash> thunk_dependencies = dependencies( graph.get_thunk( hash ) );
+
+      if ( not expanded ) {
+        to_visit.emplace_back( hash, true );
+
+        for ( const Hash & dependency : thunk_dependencies ) {
+          if ( not levels.count( dependency ) ) {
+            to_visit.emplace_back( dependency, false );
+          }
+        }
+
+        continue;
+      }
+
+      uint32_t level = 0;
+      Optional<Hash> deepest;
+
+      for ( const Hash & dependency : thunk_dependencies ) {
+        const uint32_t dependency_level = levels.at( dependency );
+
+        if ( dependency_level + 1 > level ) {
+          level = dependency_level + 1;
+          deepest.reset( dependency );
+        }
+      }
+
+      if ( deepest.initialized() ) {
+        deepest_dependency.emplace( hash, *deepest );
+      }
+
+      levels.emplace( hash, level );
+      order.push_back( hash );
+    }
+  }
+
+  protobuf::GraphSummary summary;
+  map<uint32_t, uint64_t> fan_in;
+  map<uint32_t, uint64_t> fan_out;
+  unordered_set<string> inputs;
+  uint64_t total_input_bytes = 0;
+  uint64_t edges = 0;
+
+  for ( const Hash & hash : order ) {
+    const Thunk & thunk = graph.get_thunk( hash );
+    const uint32_t level = levels.at( hash );
+
+    while ( static_cast<uint32_t>( summary.width_per_level_size() ) <= level ) {
+      summary.add_width_per_level( 0 );
+    }
+
+    summary.set_width_per_level( level, summary.width_per_level( level ) + 1 );
+
+    const size_t in_degree = dependencies( thunk ).size();
+    fan_in[ in_degree ]++;
+    fan_out[ graph.referencing_thunks( hash ).size() ]++;
+    edges += in_degree;
+
+    for_each_input( thunk,
+      [&] ( const string & input )
+      {
+        total_input_bytes += gg::hash::size( input );
+        inputs.insert( input );
+      } );
+  }
+
+  uint64_t unique_input_bytes = 0;
+
+  for ( const string & input : inputs ) {
+    unique_input_bytes += gg::hash::size( input );
+  }
+
+  summary.set_thunks( order.size() );
+  summary.set_edges( edges );
+  summary.set_total_input_bytes( total_input_bytes );
+  summary.set_unique_input_bytes( unique_input_bytes );
+  summary.set_unique_inputs( inputs.size() );
+  add_degrees( fan_in, *summary.mutable_fan_in() );
+  add_degrees( fan_out, *summary.mutable_fan_out() );
+
+  /* the critical path starts from the deepest target */
+  Optional<Hash> deepest_root;
+
+  for ( const Hash & root : roots ) {
+    if ( not deepest_root.initialized() or levels.at( root ) > levels.at( *deepest_root ) ) {
+      deepest_root.reset( root );
+    }
+  }
+
+  if ( deepest_root.initialized() ) {
+    summary.set_critical_path_length( levels.at( *deepest_root ) + 1 );
+    summary.add_critical_path( deepest_root->str() );
+
+    for ( auto next = deepest_dependency.find( *deepest_root );
+          next != deepest_dependency.end();
+          next = deepest_dependency.find( next->second ) ) {
+      summary.add_critical_path( next->second.str() );
+    }
+  }
+
+  for ( size_t i = 0; i < roots.size(); i++ ) {
+    unordered_set<Hash> visited { roots[ i ] };
+    vector<Hash> to_visit { roots[ i ] };
+    unordered_set<string> target_inputs;
+    uint64_t target_input_bytes = 0;
+
+    while ( not to_visit.empty() ) {
+      const Thunk & thunk = graph.get_thunk( to_visit.back() );
+      to_visit.pop_back();
+
+      for_each_input( thunk,
+        [&] ( const string & input )
+        {
+          if ( target_inputs.insert( input ).second ) {
+            target_input_bytes += gg::hash::size( input );
+          }
+        } );
+
+      for ( const Hash & dependency : dependencies( thunk ) ) {
+        if ( visited.insert( dependency ).second ) {
+          to_visit.push_back( dependency );
+        }
+      }
+    }
+
+    auto & target = *summary.add_targets();
+    target.set_hash( targets[ i ].str() );
+    target.set_depth( levels.at( roots[ i ] ) + 1 );
+    target.set_thunks( visited.size() );
+    target.set_unique_input_bytes( target_input_bytes );
+  }
+
+  return summary;
+}
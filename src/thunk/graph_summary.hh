@@ -0,0 +1,18 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef GRAPH_SUMMARY_HH
+#define GRAPH_SUMMARY_HH
+
+#include <vector>
+
+#include "thunk/hash.hh"
+#include "protobufs/gg.pb.h"
+
+/* Statistics about the graph under the given targets, for capacity
+   planning. Every thunk is read once, by `thread_count` threads, and the
+   level of each thunk is worked out once, no matter how many paths lead to
+   it. Only the per-target counts walk the subgraph of each target. */
+gg::protobuf::GraphSummary summarize_graph( const std::vector<gg::Hash> & targets,
+                                            const size_t thread_count );
+
+#endif /* GRAPH_SUMMARY_HH */
@@ -0,0 +1,260 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "hash.hh"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+using namespace gg;
+
+static_assert( sizeof( Hash ) == 48, "gg::Hash should stay compact" );
+
+namespace {
+
+  /* base64url, with '.' in place of '-', which is what gghashes use */
+  const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._";
+  const char HEX_CHARS[] = "0123456789abcdef";
+
+  constexpr size_t ENCODED_DIGEST_LENGTH = 43;
+
+  /* the size is in hex, with at least 8 digits; a larger size takes as many
+     more digits as it needs, without leading zeros */
+  constexpr size_t MIN_SIZE_LENGTH = 8;
+  constexpr size_t MAX_SIZE_LENGTH = 16;
+  constexpr size_t MIN_HASH_LENGTH = 1 + ENCODED_DIGEST_LENGTH + MIN_SIZE_LENGTH;
+
+  struct DecodeTable
+  {
+    array<int8_t, 256> base64 {};
+    array<int8_t, 256> hex {};
+
+    DecodeTable()
+    {
+      base64.fill( -1 );
+      hex.fill( -1 );
+
+      for ( size_t i = 0; i < 64; i++ ) {
+        base64[ static_cast<uint8_t>( BASE64_CHARS[ i ] ) ] = i;
+      }
+
+      for ( size_t i = 0; i < 16; i++ ) {
+        hex[ static_cast<uint8_t>( HEX_CHARS[ i ] ) ] = i;
+      }
+    }
+  };
+
+  const DecodeTable decode_table {};
+
+  /* the output tags, by their ids; the first one is never used */
+  class TagTable
+  {
+  private:
+    mutex mutex_ {};
+    deque<string> tags_ { "" };
+    unordered_map<string, uint16_t> ids_ {};
+
+  public:
+    uint16_t id( const string & tag )
+    {
+      unique_lock<mutex> lock { mutex_ };
+      auto entry = ids_.find( tag );
+
+      if ( entry != ids_.end() ) {
+        return entry->second;
+      }
+
+      if ( tags_.size() > numeric_limits<uint16_t>::max() ) {
+        throw runtime_error( "too many distinct output tags" );
+      }
+
+      const uint16_t new_id = tags_.size();
+      tags_.push_back( tag );
+      ids_.emplace( tag, new_id );
+      return new_id;
+    }
+
+    /* the elements of a deque don't move when it grows */
+    const string & tag( const uint16_t id )
+    {
+      unique_lock<mutex> lock { mutex_ };
+      return tags_.at( id );
+    }
+  };
+
+  TagTable & tag_table()
+  {
+    static TagTable table;
+    return table;
+  }
+
+  bool decode( const string & gghash, array<uint8_t, Hash::DIGEST_LENGTH> & digest,
+               uint64_t & size, ObjectType & type, size_t & tag_pos )
+  {
+    if ( gghash.length() < MIN_HASH_LENGTH ) {
+      return false;
+    }
+
+    constexpr size_t size_start = 1 + ENCODED_DIGEST_LENGTH;
+    const size_t size_end = min( gghash.find( '#', size_start ), gghash.length() );
+    const size_t size_length = size_end - size_start;
+
+    if ( size_length < MIN_SIZE_LENGTH or size_length > MAX_SIZE_LENGTH or
+         ( size_length > MIN_SIZE_LENGTH and gghash[ size_start ] == '0' ) ) {
+      return false;
+    }
+
+    tag_pos = ( size_end < gghash.length() ) ? size_end + 1 : string::npos;
+
+    switch ( gghash[ 0 ] ) {
+    case 'V': type = ObjectType::Value; break;
+    case 'T': type = ObjectType::Thunk; break;
+    default: return false;
+    }
+
+    /* 43 characters carry 258 bits; the last two must be zero */
+    uint32_t buffer = 0;
+    size_t bits = 0;
+    size_t out = 0;
+
+    for ( size_t i = 1; i <= ENCODED_DIGEST_LENGTH; i++ ) {
+      const int8_t value = decode_table.base64[ static_cast<uint8_t>( gghash[ i ] ) ];
+
+      if ( value < 0 ) {
+        return false;
+      }
+
+      buffer = ( buffer << 6 ) | value;
+      bits += 6;
+
+      if ( bits >= 8 ) {
+        bits -= 8;
+        digest[ out++ ] = ( buffer >> bits ) & 0xff;
+      }
+    }
+
+    if ( ( buffer & ( ( 1 << bits ) - 1 ) ) != 0 ) {
+      return false;
+    }
+
+    size = 0;
+
+    for ( size_t i = size_start; i < size_end; i++ ) {
+      const int8_t value = decode_table.hex[ static_cast<uint8_t>( gghash[ i ] ) ];
+
+      if ( value < 0 ) {
+        return false;
+      }
+
+      size = ( size << 4 ) | value;
+    }
+
+    return true;
+  }
+
+}
+
+Hash::Hash( const string & gghash )
+{
+  size_t tag_pos;
+
+  if ( not decode( gghash, digest_, size_, type_, tag_pos ) ) {
+    throw runtime_error( "invalid gghash: " + gghash );
+  }
+
+  if ( tag_pos != string::npos ) {
+    tag_ = tag_table().id( gghash.substr( tag_pos ) );
+  }
+}
+
+bool Hash::is_valid( const string & gghash )
+{
+  array<uint8_t, DIGEST_LENGTH> digest;
+  uint64_t size;
+  ObjectType type;
+  size_t tag_pos;
+
+  return decode( gghash, digest, size, type, tag_pos );
+}
+
+string Hash::str() const
+{
+  string result;
+  result.reserve( MIN_HASH_LENGTH + MAX_SIZE_LENGTH - MIN_SIZE_LENGTH
+                  + ( has_tag() ? 1 + tag().length() : 0 ) );
+  result += static_cast<char>( type_ );
+
+  uint32_t buffer = 0;
+  size_t bits = 0;
+
+  for ( const uint8_t byte : digest_ ) {
+    buffer = ( buffer << 8 ) | byte;
+    bits += 8;
+
+    while ( bits >= 6 ) {
+      bits -= 6;
+      result += BASE64_CHARS[ ( buffer >> bits ) & 0x3f ];
+    }
+  }
+
+  result += BASE64_CHARS[ ( buffer << ( 6 - bits ) ) & 0x3f ];
+
+  int shift = 4 * ( MIN_SIZE_LENGTH - 1 );
+
+  while ( shift + 4 < 64 and ( size_ >> ( shift + 4 ) ) != 0 ) {
+    shift += 4;
+  }
+
+  for ( ; shift >= 0; shift -= 4 ) {
+    result += HEX_CHARS[ ( size_ >> shift ) & 0xf ];
+  }
+
+  if ( has_tag() ) {
+    result += '#';
+    result += tag();
+  }
+
+  return result;
+}
+
+string Hash::hex() const
+{
+  string result;
+  result.reserve( 2 * DIGEST_LENGTH );
+
+  for ( const uint8_t byte : digest_ ) {
+    result += HEX_CHARS[ byte >> 4 ];
+    result += HEX_CHARS[ byte & 0xf ];
+  }
+
+  return result;
+}
+
+const string & Hash::tag() const
+{
+  return tag_table().tag( tag_ );
+}
+
+Hash Hash::base() const
+{
+  Hash result { *this };
+  result.tag_ = 0;
+  return result;
+}
+
+Hash Hash::with_tag( const string & tag ) const
+{
+  Hash result { *this };
+  result.tag_ = tag_table().id( tag );
+  return result;
+}
+
+bool Hash::operator<( const Hash & other ) const
+{
+  return tie( type_, digest_, size_, tag_ )
+         < tie( other.type_, other.digest_, other.size_, other.tag_ );
+}
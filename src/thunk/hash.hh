@@ -0,0 +1,93 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef THUNK_HASH_HH
+#define THUNK_HASH_HH
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace gg {
+
+  enum class ObjectType : char
+  {
+    Value = 'V',
+    Thunk = 'T',
+  };
+
+  /* A gghash in binary form: the sha256 digest, the type and the size of the
+     object, and the output tag, if there's one. The tags are interned, so
+     every Hash takes 48 bytes, and comparing or hashing one doesn't touch
+     anything else. The textual form is only needed for file names and for
+     talking to other processes. */
+  class Hash
+  {
+  public:
+    static constexpr size_t DIGEST_LENGTH = 32;
+
+  private:
+    std::array<uint8_t, DIGEST_LENGTH> digest_ {};
+    uint64_t size_ { 0 };
+    uint16_t tag_ { 0 }; /* 0 means no tag */
+    ObjectType type_ { ObjectType::Value };
+
+  public:
+    Hash() {}
+
+    /* parses a gghash, with or without an output tag */
+    explicit Hash( const std::string & gghash );
+
+    Hash( const ObjectType type, const std::array<uint8_t, DIGEST_LENGTH> & digest,
+          const uint64_t size )
+      : digest_( digest ), size_( size ), type_( type ) {}
+
+    std::string str() const;
+    std::string hex() const;
+
+    const std::array<uint8_t, DIGEST_LENGTH> & digest() const { return digest_; }
+    ObjectType type() const { return type_; }
+    uint64_t size() const { return size_; }
+    bool is_thunk() const { return type_ == ObjectType::Thunk; }
+
+    bool has_tag() const { return tag_ != 0; }
+    const std::string & tag() const;
+
+    /* the same object, without the output tag */
+    Hash base() const;
+    Hash with_tag( const std::string & tag ) const;
+
+    size_t hash_code() const
+    {
+      /* the digest is already uniformly distributed */
+      size_t code;
+      std::memcpy( &code, digest_.data(), sizeof( code ) );
+      return code ^ ( static_cast<size_t>( tag_ ) * 0x9e3779b97f4a7c15ULL );
+    }
+
+    bool operator==( const Hash & other ) const
+    {
+      return digest_ == other.digest_ and size_ == other.size_
+             and tag_ == other.tag_ and type_ == other.type_;
+    }
+
+    bool operator!=( const Hash & other ) const { return not operator==( other ); }
+    bool operator<( const Hash & other ) const;
+
+    static bool is_valid( const std::string & gghash );
+  };
+
+}
+
+namespace std {
+
+  template<>
+  struct hash<gg::Hash>
+  {
+    size_t operator()( const gg::Hash & h ) const { return h.hash_code(); }
+  };
+
+}
+
+#endif /* THUNK_HASH_HH */
@@ -0,0 +1,368 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "hash_cache.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "hash.hh"
+#include "util/exception.hh"
+#include "util/file_descriptor.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::hash;
+
+namespace {
+
+  const char MAGIC[ 8 ] = { 'g', 'g', 'h', 'c', 'a', 'c', 'h', 'e' };
+  const uint32_t VERSION = 2;
+
+  const uint32_t BUCKET_COUNT = 1 << 20;
+  const uint32_t MAX_RECORDS = 1 << 22;
+  const uint32_t GROWTH = 1 << 14; /* records added to the file at a time */
+
+  struct Header
+  {
+    char magic[ 8 ];
+    uint32_t version;
+    uint32_t bucket_count;
+    uint32_t record_size;
+
+    /* only changed with the file locked */
+    uint32_t record_count;
+    uint32_t stale_count;
+    uint32_t retired;
+  };
+
+  struct Record
+  {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t name_hash;
+
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t ctime_sec;
+    uint32_t mtime_nsec;
+    uint32_t ctime_nsec;
+
+    uint8_t digest[ Hash::DIGEST_LENGTH ];
+    uint64_t object_size; /* files can be 4 GiB or more */
+    uint32_t next; /* index + 1 of the next record in the chain, or 0 */
+    char type;
+  };
+
+  const size_t HEADER_SIZE = 4096;
+  const size_t RECORDS_OFFSET = HEADER_SIZE + BUCKET_COUNT * sizeof( uint32_t );
+
+  size_t file_size( const uint32_t record_capacity )
+  {
+    return RECORDS_OFFSET + record_capacity * sizeof( Record );
+  }
+
+  /* FNV-1a; it has to be the same in every process */
+  uint64_t name_hash( const string & filename )
+  {
+    const string name = roost::rbasename( filename ).string();
+    uint64_t result = 0xcbf29ce484222325ULL;
+
+    for ( const char c : name ) {
+      result = ( result ^ static_cast<uint8_t>( c ) ) * 0x100000001b3ULL;
+    }
+
+    return result;
+  }
+
+  Record make_record( const string & filename, const struct stat & file_stat )
+  {
+    Record record;
+    memset( &record, 0, sizeof( record ) );
+
+    record.dev = file_stat.st_dev;
+    record.ino = file_stat.st_ino;
+    record.name_hash = name_hash( filename );
+    record.size = file_stat.st_size;
+    record.mtime_sec = file_stat.st_mtim.tv_sec;
+    record.mtime_nsec = file_stat.st_mtim.tv_nsec;
+    record.ctime_sec = file_stat.st_ctim.tv_sec;
+    record.ctime_nsec = file_stat.st_ctim.tv_nsec;
+
+    return record;
+  }
+
+  bool same_key( const Record & a, const Record & b )
+  {
+    return a.dev == b.dev and a.ino == b.ino and a.name_hash == b.name_hash;
+  }
+
+  bool same_stat( const Record & a, const Record & b )
+  {
+    return a.size == b.size
+           and a.mtime_sec == b.mtime_sec and a.mtime_nsec == b.mtime_nsec
+           and a.ctime_sec == b.ctime_sec and a.ctime_nsec == b.ctime_nsec;
+  }
+
+}
+
+struct HashCache::Table
+{
+  const string path;
+  FileDescriptor file;
+  uint32_t capacity { 0 };
+
+  /* the whole address range that the file can grow into is mapped up front,
+     so the mapping never moves */
+  char * base { nullptr };
+  Header * header { nullptr };
+  uint32_t * buckets { nullptr };
+  Record * records { nullptr };
+
+  Table( const string & table_path )
+    : path( table_path ),
+      file( CheckSystemCall( "open (" + path + ")",
+                             open( path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 ) ) )
+  {
+    void * mapping = mmap( nullptr, file_size( MAX_RECORDS ), PROT_READ | PROT_WRITE,
+                           MAP_SHARED, file.fd_num(), 0 );
+
+    if ( mapping == MAP_FAILED ) {
+      throw unix_error( "mmap (" + path + ")" );
+    }
+
+    base = static_cast<char *>( mapping );
+    header = reinterpret_cast<Header *>( base );
+    buckets = reinterpret_cast<uint32_t *>( base + HEADER_SIZE );
+    records = reinterpret_cast<Record *>( base + RECORDS_OFFSET );
+
+    FileLock lock { file };
+
+    if ( not valid() ) {
+      /* a new file, or one whose creator died half-way, or one from another
+         version; whoever is using the last kind is in for a surprise */
+      CheckSystemCall( "ftruncate", ftruncate( file.fd_num(), 0 ) );
+      CheckSystemCall( "ftruncate", ftruncate( file.fd_num(), file_size( GROWTH ) ) );
+
+      header->version = VERSION;
+      header->bucket_count = BUCKET_COUNT;
+      header->record_size = sizeof( Record );
+      memcpy( header->magic, MAGIC, sizeof( MAGIC ) );
+    }
+
+    update_capacity();
+  }
+
+  ~Table()
+  {
+    munmap( base, file_size( MAX_RECORDS ) );
+  }
+
+  bool valid()
+  {
+    struct stat file_stat;
+    CheckSystemCall( "fstat", fstat( file.fd_num(), &file_stat ) );
+
+    return static_cast<size_t>( file_stat.st_size ) >= file_size( 0 )
+           and memcmp( header->magic, MAGIC, sizeof( MAGIC ) ) == 0
+           and header->version == VERSION
+           and header->bucket_count == BUCKET_COUNT
+           and header->record_size == sizeof( Record );
+  }
+
+  void update_capacity()
+  {
+    struct stat file_stat;
+    CheckSystemCall( "fstat", fstat( file.fd_num(), &file_stat ) );
+    capacity = ( file_stat.st_size - RECORDS_OFFSET ) / sizeof( Record );
+  }
+
+  bool retired() const { return __atomic_load_n( &header->retired, __ATOMIC_ACQUIRE ); }
+  uint32_t record_count() const { return header->record_count; }
+  uint32_t stale_count() const { return header->stale_count; }
+
+  uint32_t & bucket( const Record & key )
+  {
+    return buckets[ ( ( key.dev * 31 + key.ino ) ^ key.name_hash ) % BUCKET_COUNT ];
+  }
+
+  /* the newest record for the key, if there's one */
+  const Record * find( const Record & key )
+  {
+    uint32_t next = __atomic_load_n( &bucket( key ), __ATOMIC_ACQUIRE );
+
+    while ( next != 0 ) {
+      const Record & record = records[ next - 1 ];
+
+      if ( same_key( record, key ) ) {
+        return &record;
+      }
+
+      next = record.next;
+    }
+
+    return nullptr;
+  }
+
+  /* must be called with the file locked, and with room for the record */
+  void append( const Record & record )
+  {
+    const uint32_t index = header->record_count;
+
+    if ( index >= capacity ) {
+      update_capacity(); /* another process might have grown the file */
+    }
+
+    if ( index >= capacity ) {
+      const uint32_t new_capacity = min( MAX_RECORDS, index + GROWTH );
+      CheckSystemCall( "ftruncate", ftruncate( file.fd_num(), file_size( new_capacity ) ) );
+      capacity = new_capacity;
+    }
+
+    if ( find( record ) != nullptr ) {
+      header->stale_count++;
+    }
+
+    /* the slot is claimed before it's filled, so if this process dies
+       half-way, the slot is only wasted */
+    header->record_count = index + 1;
+
+    uint32_t & head = bucket( record );
+    records[ index ] = record;
+    records[ index ].next = head;
+    __atomic_store_n( &head, index + 1, __ATOMIC_RELEASE );
+  }
+
+  /* forbid copying */
+  Table( const Table & other ) = delete;
+  Table & operator=( const Table & other ) = delete;
+};
+
+HashCache::HashCache( const roost::path & path )
+  : path_( path )
+{}
+
+HashCache::~HashCache() {}
+
+HashCache::Table & HashCache::current()
+{
+  Table * table = table_.load();
+
+  if ( table != nullptr and not table->retired() ) {
+    return *table;
+  }
+
+  lock_guard<mutex> lock { mutex_ };
+  return current_locked();
+}
+
+HashCache::Table & HashCache::current_locked()
+{
+  Table * table = table_.load();
+
+  while ( table == nullptr or table->retired() ) {
+    tables_.emplace_back( new Table( path_.string() ) );
+    table = tables_.back().get();
+  }
+
+  table_ = table;
+  return *table;
+}
+
+Optional<string> HashCache::get( const string & filename,
+                                 const struct stat & file_stat )
+{
+  const Record key = make_record( filename, file_stat );
+  const Record * record = current().find( key );
+
+  if ( record == nullptr or not same_stat( *record, key ) ) {
+    return {};
+  }
+
+  array<uint8_t, Hash::DIGEST_LENGTH> digest;
+  memcpy( digest.data(), record->digest, digest.size() );
+
+  return Hash( static_cast<ObjectType>( record->type ), digest,
+               record->object_size ).str();
+}
+
+void HashCache::put( const string & filename, const struct stat & file_stat,
+                     const string & hash )
+{
+  const Hash parsed { hash };
+
+  Record record = make_record( filename, file_stat );
+  memcpy( record.digest, parsed.digest().data(), parsed.digest().size() );
+  record.object_size = parsed.size();
+  record.type = static_cast<char>( parsed.type() );
+
+  lock_guard<mutex> lock { mutex_ };
+
+  while ( true ) {
+    Table & table = current_locked();
+    FileLock file_lock { table.file };
+
+    if ( table.retired() ) {
+      continue; /* someone else has just compacted it */
+    }
+
+    const uint32_t count = table.record_count();
+    const uint32_t stale = table.stale_count();
+
+    if ( stale > 0 and ( count >= MAX_RECORDS
+                         or ( count >= GROWTH and stale > count / 2 ) ) ) {
+      compact( table );
+      continue;
+    }
+
+    if ( count >= MAX_RECORDS ) {
+      return; /* full of live records; this one goes uncached */
+    }
+
+    table.append( record );
+    return;
+  }
+}
+
+/* must be called with the table's file locked */
+void HashCache::compact( Table & table )
+{
+  const string new_path = path_.string() + "." + to_string( getpid() );
+  unlink( new_path.c_str() ); /* left behind by a process that died compacting */
+
+  {
+    Table new_table { new_path };
+    vector<const Record *> live;
+
+    for ( uint32_t i = 0; i < BUCKET_COUNT; i++ ) {
+      live.clear();
+
+      for ( uint32_t next = table.buckets[ i ]; next != 0; ) {
+        const Record & record = table.records[ next - 1 ];
+        bool superseded = false;
+
+        for ( const Record * newer : live ) {
+          superseded = superseded or same_key( *newer, record );
+        }
+
+        if ( not superseded ) {
+          live.push_back( &record );
+        }
+
+        next = record.next;
+      }
+
+      /* oldest first, so that the chains keep their order */
+      for ( auto it = live.rbegin(); it != live.rend(); it++ ) {
+        new_table.append( **it );
+      }
+    }
+  }
+
+  roost::rename( new_path, path_ );
+  __atomic_store_n( &table.header->retired, 1, __ATOMIC_RELEASE );
+}
@@ -0,0 +1,70 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef HASH_CACHE_HH
+#define HASH_CACHE_HH
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "util/optional.hh"
+#include "util/path.hh"
+
+namespace gg {
+  namespace hash {
+
+    /* The hashes of local files, keyed by (device, inode, file name) and
+       checked against the size, mtime and ctime of the file. Everything lives
+       in one file that is mapped into memory: a fixed array of buckets,
+       followed by fixed-size records that are chained off the buckets, newest
+       first. A record is never touched again once it's linked in, so lookups
+       don't take any locks. Inserts append a record and link it in while
+       holding an flock() on the file, so any number of processes can share
+       the cache.
+
+       Once most of the records have been superseded, or the file is full, the
+       live records are copied to a new file that is renamed over the old one.
+       The old file is then marked as retired, and every process that still
+       has it open moves over to the new one. */
+    class HashCache
+    {
+    public:
+      struct Table;
+
+    private:
+      const roost::path path_;
+
+      std::mutex mutex_ {};
+      std::atomic<Table *> table_ { nullptr };
+
+      /* every table this process has opened; the retired ones are kept
+         around, as other threads might still be reading them */
+      std::vector<std::unique_ptr<Table>> tables_ {};
+
+      Table & current();
+      Table & current_locked();
+
+      void compact( Table & table );
+
+    public:
+      HashCache( const roost::path & path );
+      ~HashCache();
+
+      Optional<std::string> get( const std::string & filename,
+                                 const struct stat & file_stat );
+
+      void put( const std::string & filename, const struct stat & file_stat,
+                const std::string & hash );
+
+      /* forbid copying */
+      HashCache( const HashCache & other ) = delete;
+      HashCache & operator=( const HashCache & other ) = delete;
+    };
+
+  }
+}
+
+#endif /* HASH_CACHE_HH */
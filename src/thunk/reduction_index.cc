@@ -0,0 +1,334 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "reduction_index.hh"
+
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "util/exception.hh"
+#include "util/file_descriptor.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::cache;
+
+/* the log isn't compacted until it has at least this many lines */
+static constexpr size_t MIN_COMPACTION_LINES = 4096;
+
+ReductionIndex::ReductionIndex( const roost::path & reductions_dir )
+  : reductions_dir_( reductions_dir ), log_path_( reductions_dir / "log" )
+{}
+
+ReductionIndex::~ReductionIndex()
+{
+  try {
+    flush();
+  }
+  catch ( const exception & e ) {
+    cerr << "could not write the pending reductions: " << e.what() << endl;
+  }
+}
+
+void ReductionIndex::load()
+{
+  open_log();
+  with_log_locked( [this] () { import_directory(); } );
+  read_log();
+  loaded_ = true;
+}
+
+void ReductionIndex::open_log()
+{
+  /* someone might have removed the whole directory */
+  roost::create_directories( reductions_dir_ );
+
+  log_.reset( new FileDescriptor { CheckSystemCall( "open (" + log_path_.string() + ")",
+    open( log_path_.string().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644 ) ) } );
+
+  struct stat log_stat;
+  CheckSystemCall( "fstat", fstat( log_->fd_num(), &log_stat ) );
+  log_device_ = log_stat.st_dev;
+  log_inode_ = log_stat.st_ino;
+  log_offset_ = 0;
+  log_lines_ = 0;
+
+  /* the entries are read again from the new log, except for the ones that
+     haven't been written yet */
+  entries_.clear();
+
+  for ( const auto & entry : pending_ ) {
+    entries_[ entry.first ] = entry.second;
+  }
+}
+
+bool ReductionIndex::log_replaced() const
+{
+  if ( log_ == nullptr ) {
+    return true;
+  }
+
+  struct stat log_stat;
+
+  if ( stat( log_path_.string().c_str(), &log_stat ) != 0 ) {
+    if ( errno == ENOENT ) {
+      return true;
+    }
+
+    throw unix_error( "stat (" + log_path_.string() + ")" );
+  }
+
+  return log_stat.st_dev != log_device_ or log_stat.st_ino != log_inode_;
+}
+
+void ReductionIndex::read_log()
+{
+  if ( log_replaced() ) {
+    open_log();
+  }
+
+  struct stat log_stat;
+  CheckSystemCall( "fstat", fstat( log_->fd_num(), &log_stat ) );
+
+  if ( log_stat.st_size <= log_offset_ ) {
+    return;
+  }
+
+  string data( log_stat.st_size - log_offset_, '\0' );
+  size_t filled = 0;
+
+  while ( filled < data.size() ) {
+    const ssize_t bytes_read =
+      CheckSystemCall( "pread", pread( log_->fd_num(), &data[ filled ],
+                                       data.size() - filled, log_offset_ + filled ) );
+
+    if ( bytes_read == 0 ) {
+      break;
+    }
+
+    filled += bytes_read;
+  }
+
+  data.resize( filled );
+
+  /* a line without its newline is either still being written, and is read
+     the next time, or was cut short by a crash, and is skipped */
+  size_t line_start = 0;
+
+  for ( size_t line_end = data.find( '\n' ); line_end != string::npos;
+        line_end = data.find( '\n', line_start ) ) {
+    const size_t space = data.find( ' ', line_start );
+
+    if ( space < line_end ) {
+      const string old_hash = data.substr( line_start, space - line_start );
+      const string new_hash = data.substr( space + 1, line_end - space - 1 );
+
+      if ( Hash::is_valid( old_hash ) and Hash::is_valid( new_hash ) ) {
+        entries_[ Hash( old_hash ) ] = Hash( new_hash );
+        log_lines_++;
+      }
+    }
+
+    line_start = line_end + 1;
+  }
+
+  log_offset_ += line_start;
+}
+
+void ReductionIndex::with_log_locked( const function<void()> & action )
+{
+  while ( true ) {
+    if ( log_replaced() ) {
+      open_log();
+    }
+
+    FileLock lock { *log_ };
+
+    if ( log_replaced() ) {
+      continue; /* it was compacted while we were waiting */
+    }
+
+    action();
+    return;
+  }
+}
+
+void ReductionIndex::append_to_log( const string & lines )
+{
+  struct stat log_stat;
+  CheckSystemCall( "fstat", fstat( log_->fd_num(), &log_stat ) );
+
+  char last_char = '\n';
+
+  if ( log_stat.st_size > 0 ) {
+    CheckSystemCall( "pread", pread( log_->fd_num(), &last_char, 1, log_stat.st_size - 1 ) );
+  }
+
+  /* whoever wrote the last line died half-way; end that line, so it's skipped */
+  if ( last_char != '\n' ) {
+    log_->write( "\n" );
+  }
+
+  log_->write( lines );
+}
+
+void ReductionIndex::import_directory()
+{
+  roost::Directory directory { reductions_dir_.string() };
+  string lines;
+  vector<string> imported;
+
+  for ( const string & name : roost::list_directory( reductions_dir_ ) ) {
+    /* skips the log, and its temporary files */
+    if ( not Hash::is_valid( name ) ) {
+      continue;
+    }
+
+    const int fd = openat( directory.num(), name.c_str(), O_RDONLY );
+
+    if ( fd < 0 ) {
+      if ( errno == ENOENT ) {
+        continue;
+      }
+
+      throw unix_error( "openat( " + name + " )" );
+    }
+
+    FileDescriptor entry { fd };
+    /* the hash of an object of 4 GiB or more is longer than hash::length */
+    const string new_hash = entry.read();
+
+    /* skipping the entries that are still being written */
+    if ( not Hash::is_valid( new_hash ) ) {
+      continue;
+    }
+
+    lines += name + " " + new_hash + "\n";
+    imported.push_back( name );
+  }
+
+  if ( imported.empty() ) {
+    return;
+  }
+
+  append_to_log( lines );
+
+  for ( const string & name : imported ) {
+    unlinkat( directory.num(), name.c_str(), 0 );
+  }
+}
+
+void ReductionIndex::compact()
+{
+  string lines;
+
+  for ( const auto & entry : entries_ ) {
+    lines += entry.first.str() + " " + entry.second.str() + "\n";
+  }
+
+  /* the other processes, and this one, switch over to the new log the next
+     time they look at it */
+  roost::atomic_create( lines, log_path_ );
+}
+
+Optional<Hash> ReductionIndex::check( const Hash & hash )
+{
+  /* only thunks are reduced */
+  if ( not hash.is_thunk() ) {
+    return {};
+  }
+
+  unique_lock<mutex> lock { mutex_ };
+
+  if ( not loaded_ ) {
+    load();
+  }
+
+  auto entry = entries_.find( hash );
+
+  if ( entry == entries_.end() ) {
+    /* another process might have added it after the log was read */
+    read_log();
+    entry = entries_.find( hash );
+  }
+
+  if ( entry == entries_.end() ) {
+    return {};
+  }
+
+  return { true, entry->second };
+}
+
+void ReductionIndex::insert( const Hash & old_hash, const Hash & new_hash )
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  auto entry = entries_.find( old_hash );
+
+  if ( entry != entries_.end() and entry->second == new_hash ) {
+    return; /* it's already on the disk, or about to be */
+  }
+
+  entries_[ old_hash ] = new_hash;
+  pending_.emplace_back( old_hash, new_hash );
+
+  if ( pending_.size() >= batch_size_ ) {
+    write_pending();
+  }
+}
+
+void ReductionIndex::write_pending()
+{
+  if ( pending_.empty() ) {
+    return;
+  }
+
+  string lines;
+
+  for ( const auto & entry : pending_ ) {
+    lines += entry.first.str() + " " + entry.second.str() + "\n";
+  }
+
+  with_log_locked(
+    [&] ()
+    {
+      append_to_log( lines );
+      pending_.clear();
+
+      /* catching up first, so that nothing in the log is left out */
+      read_log();
+
+      if ( log_lines_ >= MIN_COMPACTION_LINES and log_lines_ > 2 * entries_.size() ) {
+        compact();
+      }
+    } );
+}
+
+void ReductionIndex::set_batch_size( const size_t batch_size )
+{
+  unique_lock<mutex> lock { mutex_ };
+  batch_size_ = batch_size;
+
+  if ( pending_.size() >= batch_size_ ) {
+    write_pending();
+  }
+}
+
+void ReductionIndex::flush()
+{
+  unique_lock<mutex> lock { mutex_ };
+  write_pending();
+}
+
+void ReductionIndex::clear()
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  pending_.clear();
+  roost::empty_directory( reductions_dir_ );
+  open_log();
+  loaded_ = true;
+}
@@ -0,0 +1,93 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef REDUCTION_INDEX_HH
+#define REDUCTION_INDEX_HH
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+
+#include "ggutils.hh"
+#include "hash.hh"
+#include "util/file_descriptor.hh"
+#include "util/optional.hh"
+#include "util/path.hh"
+
+namespace gg {
+  namespace cache {
+
+    /* An in-memory view of the reductions, which are kept in an append-only
+       log in the reductions directory, one "old-hash new-hash" line each.
+       The log is read once, the first time a lookup is made; a lookup that
+       misses in memory reads whatever other processes have appended since.
+       Inserts are appended either immediately or in batches, with the log
+       locked, so any number of processes can share it. A line cut short by
+       a crash is skipped.
+
+       When most of the lines in the log are superseded, the live entries are
+       written to a new log that is renamed over the old one; the processes
+       that have the old one open notice that the file under the name has
+       changed, and load the new one. Entries in the old format (one file per
+       entry) are moved into the log when it's loaded. */
+    class ReductionIndex
+    {
+    private:
+      const roost::path reductions_dir_;
+      const roost::path log_path_;
+
+      std::mutex mutex_ {};
+
+      bool loaded_ { false };
+      std::unordered_map<Hash, Hash> entries_ {};
+
+      std::unique_ptr<FileDescriptor> log_ {};
+      dev_t log_device_ { 0 };
+      ino_t log_inode_ { 0 };
+      off_t log_offset_ { 0 };   /* how much of the log has been read */
+      size_t log_lines_ { 0 };   /* how many entries were read from it */
+
+      size_t batch_size_ { 0 };
+      std::vector<std::pair<Hash, Hash>> pending_ {};
+
+      void load();
+      void open_log();
+      bool log_replaced() const;
+      void read_log();
+
+      /* runs the action with the log that's under the name locked */
+      void with_log_locked( const std::function<void()> & action );
+
+      /* these have to be called with the log locked */
+      void append_to_log( const std::string & lines );
+      void import_directory();
+      void compact();
+
+      void write_pending();
+
+    public:
+      ReductionIndex( const roost::path & reductions_dir );
+      ~ReductionIndex();
+
+      Optional<Hash> check( const Hash & hash );
+      void insert( const Hash & old_hash, const Hash & new_hash );
+
+      /* 0 means that every insert is written out immediately */
+      void set_batch_size( const size_t batch_size );
+      void flush();
+
+      /* forgets every reduction, including the ones on the disk */
+      void clear();
+
+      /* forbid copying */
+      ReductionIndex( const ReductionIndex & other ) = delete;
+      ReductionIndex & operator=( const ReductionIndex & other ) = delete;
+    };
+
+  }
+}
+
+#endif /* REDUCTION_INDEX_HH */
@@ -0,0 +1,285 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "snapshot.hh"
+
+#include <map>
+#include <deque>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <crypto++/sha.h>
+
+#include "ggutils.hh"
+#include "thunk_reader.hh"
+#include "util/path.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+using namespace CryptoPP;
+
+namespace {
+
+  const char SNAPSHOT_MAGIC[ 8 ] = { 'G', 'G', 'G', 'R', 'A', 'P', 'H', '\0' };
+  constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  /* parses a serialized thunk from the blobs directory, and makes sure that
+     it's the one we asked for */
+  Thunk parse_checked( const Hash & hash, const char * data, const size_t length )
+  {
+    const string hash_str = hash.str();
+    Thunk thunk = ThunkReader::parse( data, length );
+    bool matches;
+
+    if ( thunk.version() == 1 ) {
+      array<uint8_t, Hash::DIGEST_LENGTH> digest;
+      SHA256().CalculateDigest( digest.data(), reinterpret_cast<const uint8_t *>( data ),
+                                length );
+
+      matches = ( Hash { ObjectType::Thunk, digest, length } == hash );
+    }
+    else {
+      matches = ( thunk.hash() == hash_str );
+    }
+
+    if ( not matches ) {
+      throw runtime_error( "thunk does not match its hash: " + hash_str );
+    }
+
+    thunk.set_hash( hash_str );
+    return thunk;
+  }
+
+  template<class T>
+  void append( string & output, const T * items, const size_t count )
+  {
+    output.append( reinterpret_cast<const char *>( items ), count * sizeof( T ) );
+  }
+
+}
+
+Hash GraphSnapshot::Entry::hash() const
+{
+  return { static_cast<ObjectType>( type ), digest, size };
+}
+
+GraphSnapshot::GraphSnapshot( const string & path )
+  : file_( path )
+{
+  auto fail = [&path] ( const string & reason )
+    { return runtime_error( "invalid graph snapshot (" + path + "): " + reason ); };
+
+  if ( file_.size() < sizeof( Header ) ) {
+    throw fail( "too short" );
+  }
+
+  header_ = reinterpret_cast<const Header *>( file_.data() );
+
+  if ( memcmp( header_->magic, SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) ) != 0 ) {
+    throw fail( "bad magic number" );
+  }
+
+  if ( header_->version != VERSION ) {
+    throw fail( "unsupported version" );
+  }
+
+  if ( header_->byte_order != BYTE_ORDER_MARK ) {
+    throw fail( "written on a machine with a different byte order" );
+  }
+
+  const uint64_t file_size = file_.size();
+  const uint64_t thunk_count = header_->thunk_count;
+  const uint64_t dependency_count = header_->dependency_count;
+
+  if ( thunk_count > file_size / sizeof( Entry ) or
+       dependency_count > file_size / sizeof( uint32_t ) ) {
+    throw fail( "bad counts" );
+  }
+
+  const uint64_t tables_end = sizeof( Header ) + thunk_count * sizeof( Entry )
+                            + dependency_count * sizeof( uint32_t );
+
+  if ( tables_end > file_size or header_->data_offset < tables_end or
+       header_->data_offset > file_size or
+       header_->data_length > file_size - header_->data_offset ) {
+    throw fail( "bad offsets" );
+  }
+
+  const uint64_t data_end = header_->data_offset + header_->data_length;
+
+  array<uint8_t, Hash::DIGEST_LENGTH> checksum;
+  SHA256().CalculateDigest( checksum.data(),
+                            reinterpret_cast<const uint8_t *>( file_.data() + sizeof( Header ) ),
+                            data_end - sizeof( Header ) );
+
+  if ( checksum != header_->checksum ) {
+    throw fail( "checksum mismatch" );
+  }
+
+  entries_ = reinterpret_cast<const Entry *>( file_.data() + sizeof( Header ) );
+  dependencies_ = reinterpret_cast<const uint32_t *>( entries_ + thunk_count );
+  data_ = file_.data() + header_->data_offset;
+
+  for ( size_t i = 0; i < thunk_count; i++ ) {
+    const Entry & entry = entries_[ i ];
+
+    if ( entry.offset > header_->data_length or
+         entry.length > header_->data_length - entry.offset or
+         entry.first_dependency > dependency_count or
+         entry.dependency_count > dependency_count - entry.first_dependency ) {
+      throw fail( "bad entry" );
+    }
+  }
+
+  for ( size_t i = 0; i < dependency_count; i++ ) {
+    if ( dependencies_[ i ] >= thunk_count ) {
+      throw fail( "bad dependency" );
+    }
+  }
+}
+
+const GraphSnapshot::Entry * GraphSnapshot::find( const Hash & full_hash ) const
+{
+  const Hash hash = full_hash.base();
+  const Entry * end = entries_ + header_->thunk_count;
+
+  /* the entries are in the order of gg::Hash */
+  const Entry * entry = lower_bound( entries_, end, hash,
+                                     [] ( const Entry & e, const Hash & h ) { return e.hash() < h; } );
+
+  if ( entry == end or entry->hash() != hash ) {
+    return nullptr;
+  }
+
+  return entry;
+}
+
+Optional<Thunk> GraphSnapshot::thunk( const Hash & hash ) const
+{
+  const Entry * entry = find( hash );
+
+  if ( entry == nullptr ) {
+    return {};
+  }
+
+  /* the thunk was checked against its hash when the snapshot was written,
+     and the checksum has covered it since */
+  Thunk thunk = ThunkReader::parse( data_ + entry->offset, entry->length );
+  thunk.set_hash( entry->hash().str() );
+  return { true, move( thunk ) };
+}
+
+vector<Hash> GraphSnapshot::dependencies( const Hash & hash ) const
+{
+  const Entry * entry = find( hash );
+
+  if ( entry == nullptr ) {
+    throw runtime_error( "thunk not in graph snapshot: " + hash.str() );
+  }
+
+  vector<Hash> result;
+
+  for ( size_t i = 0; i < entry->dependency_count; i++ ) {
+    result.emplace_back( entries_[ dependencies_[ entry->first_dependency + i ] ].hash() );
+  }
+
+  return result;
+}
+
+void GraphSnapshot::write( const string & path, const vector<Hash> & targets )
+{
+  struct Node
+  {
+    string data {};
+    vector<Hash> dependencies {};
+  };
+
+  /* the map keeps the thunks in the order of the index */
+  map<Hash, Node> nodes;
+  deque<Hash> to_visit;
+
+  for ( const Hash & target : targets ) {
+    to_visit.push_back( target.base() );
+  }
+
+  while ( not to_visit.empty() ) {
+    const Hash hash = to_visit.front();
+    to_visit.pop_front();
+
+    if ( nodes.count( hash ) ) {
+      continue;
+    }
+
+    if ( not hash.is_thunk() ) {
+      throw runtime_error( "not a thunk: " + hash.str() );
+    }
+
+    Node node;
+    node.data = roost::read_file( gg::paths::blob( hash.str() ) );
+    const Thunk thunk = parse_checked( hash, node.data.data(), node.data.length() );
+
+    for ( const auto & item : thunk.thunks() ) {
+      const Hash dependency = Hash( item.first ).base();
+
+      /* different outputs of the same thunk are one edge */
+      if ( std::find( node.dependencies.begin(), node.dependencies.end(),
+                      dependency ) == node.dependencies.end() ) {
+        node.dependencies.push_back( dependency );
+        to_visit.push_back( dependency );
+      }
+    }
+
+    nodes.emplace( hash, move( node ) );
+  }
+
+  unordered_map<Hash, uint32_t> indices;
+
+  for ( const auto & node : nodes ) {
+    indices.emplace( node.first, indices.size() );
+  }
+
+  vector<Entry> entries;
+  vector<uint32_t> dependencies;
+  string data;
+
+  for ( const auto & node : nodes ) {
+    Entry entry {};
+    entry.digest = node.first.digest();
+    entry.size = node.first.size();
+    entry.type = static_cast<uint8_t>( node.first.type() );
+    entry.offset = data.length();
+    entry.length = node.second.data.length();
+    entry.first_dependency = dependencies.size();
+    entry.dependency_count = node.second.dependencies.size();
+
+    for ( const Hash & dependency : node.second.dependencies ) {
+      dependencies.push_back( indices.at( dependency ) );
+    }
+
+    data.append( node.second.data );
+    entries.push_back( entry );
+  }
+
+  string contents;
+  contents.resize( sizeof( Header ) );
+  append( contents, entries.data(), entries.size() );
+  append( contents, dependencies.data(), dependencies.size() );
+
+  Header header {};
+  memcpy( header.magic, SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) );
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.thunk_count = entries.size();
+  header.dependency_count = dependencies.size();
+  header.data_offset = contents.length();
+  header.data_length = data.length();
+
+  contents.append( data );
+  SHA256().CalculateDigest( header.checksum.data(),
+                            reinterpret_cast<const uint8_t *>( contents.data() + sizeof( Header ) ),
+                            contents.length() - sizeof( Header ) );
+  memcpy( &contents[ 0 ], &header, sizeof( Header ) );
+
+  roost::atomic_create( contents, path );
+}
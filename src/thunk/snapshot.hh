@@ -0,0 +1,96 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef THUNK_SNAPSHOT_HH
+#define THUNK_SNAPSHOT_HH
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "thunk/hash.hh"
+#include "thunk/thunk.hh"
+#include "util/mapped_file.hh"
+#include "util/optional.hh"
+
+namespace gg {
+  namespace thunk {
+
+    /* A graph of thunks in a single file, so that loading it doesn't take a
+       read() and an open() for every thunk. The file holds the serialized
+       thunks as they are in the blobs directory, an index sorted by hash,
+       and the edges between them. Every thunk is checked against its hash
+       when the snapshot is written, and the whole file against a checksum
+       when it's mapped into memory.
+
+       The file is in the byte order of the machine that wrote it, and it's
+       refused anywhere else. */
+    class GraphSnapshot
+    {
+    public:
+      static constexpr uint32_t VERSION = 2;
+
+    private:
+      struct Header
+      {
+        char magic[ 8 ];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t thunk_count;
+        uint64_t dependency_count;
+        uint64_t data_offset;
+        uint64_t data_length;
+        /* sha256 of everything after the header */
+        std::array<uint8_t, Hash::DIGEST_LENGTH> checksum;
+      };
+
+      struct Entry
+      {
+        std::array<uint8_t, Hash::DIGEST_LENGTH> digest;
+        uint64_t size;
+        uint8_t type;
+        uint8_t padding1[ 3 ];
+        uint32_t length;
+        uint64_t offset; /* relative to the data region */
+        uint32_t first_dependency;
+        uint32_t dependency_count;
+
+        Hash hash() const;
+      };
+
+      static_assert( sizeof( Header ) == 80, "unexpected snapshot header layout" );
+      static_assert( sizeof( Entry ) == 64, "unexpected snapshot entry layout" );
+
+      MappedFile file_;
+      const Header * header_ { nullptr };
+      const Entry * entries_ { nullptr };
+      const uint32_t * dependencies_ { nullptr };
+      const char * data_ { nullptr };
+
+      const Entry * find( const Hash & hash ) const;
+
+    public:
+      GraphSnapshot( const std::string & path );
+
+      /* writes the given thunks and everything they depend on, as they are
+         in the blobs directory */
+      static void write( const std::string & path, const std::vector<Hash> & targets );
+
+      size_t size() const { return header_->thunk_count; }
+      bool has( const Hash & hash ) const { return find( hash ) != nullptr; }
+
+      /* the thunk with the given hash, if it's in the snapshot */
+      Optional<Thunk> thunk( const Hash & hash ) const;
+
+      /* the thunks that the given thunk depends on, without output tags */
+      std::vector<Hash> dependencies( const Hash & hash ) const;
+
+      /* ban copying */
+      GraphSnapshot( const GraphSnapshot & other ) = delete;
+      GraphSnapshot & operator=( const GraphSnapshot & other ) = delete;
+    };
+
+  } /* namespace thunk */
+} /* namespace gg */
+
+#endif /* THUNK_SNAPSHOT_HH */
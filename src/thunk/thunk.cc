@@ -8,7 +8,7 @@
 #include <unordered_map>
 #include <algorithm>
 #include <numeric>
-#include <regex>
+#include <crypto++/sha.h>
 
 #include "protobufs/util.hh"
 #include "thunk/ggutils.hh"
@@ -29,7 +29,7 @@ string thunk::data_placeholder( const string & hash )
   return DATA_PLACEHOLDER_START + hash + DATA_PLACEHOLDER_END;
 }
 
-string data_to_string( const pair<const string, string> & item )
+string data_to_string( const Thunk::DataList::reference & item )
 {
   if ( item.second.length() > 0 ) {
     return item.first + '=' + item.second;
@@ -39,7 +39,7 @@ string data_to_string( const pair<const string, string> & item )
   }
 }
 
-pair<const string, string> Thunk::string_to_data( const string & str )
+Thunk::DataItem Thunk::string_to_data( const string & str )
 {
   auto eqpos = str.find( '=' );
   if ( eqpos == string::npos ) {
@@ -72,16 +72,22 @@ Thunk::Thunk( const Function & function,
   : function_( function ),
     values_(),
     thunks_(),
-    executables_( executables.cbegin(), executables.cend() ),
+    executables_( executables ),
     outputs_( outputs )
 {
+  vector<DataItem> values;
+  vector<DataItem> thunks;
+
   for ( const DataItem & item : data ) {
     switch ( hash::type( item.first ) ) {
-    case ObjectType::Value: values_.emplace( item ); break;
-    case ObjectType::Thunk: thunks_.emplace( item ); break;
+    case ObjectType::Value: values.emplace_back( item ); break;
+    case ObjectType::Thunk: thunks.emplace_back( item ); break;
     }
   }
 
+  values_ = DataList { move( values ) };
+  thunks_ = DataList { move( thunks ) };
+
   throw_if_error();
 }
 
@@ -89,19 +95,21 @@ Thunk::Thunk( Function && function,
               vector<DataItem> && data,
               vector<DataItem> && executables,
               vector<string> && outputs )
-  : function_( move( function ) ), values_(), thunks_(), executables_(),
-    outputs_( move( outputs ) )
+  : function_( move( function ) ), values_(), thunks_(),
+    executables_( move( executables ) ), outputs_( move( outputs ) )
 {
+  vector<DataItem> values;
+  vector<DataItem> thunks;
+
   for ( DataItem & item : data ) {
     switch ( hash::type( item.first ) ) {
-    case ObjectType::Value: values_.emplace( move( item ) ); break;
-    case ObjectType::Thunk: thunks_.emplace( move( item ) ); break;
+    case ObjectType::Value: values.emplace_back( move( item ) ); break;
+    case ObjectType::Thunk: thunks.emplace_back( move( item ) ); break;
     }
   }
 
-  for ( DataItem & item : executables ) {
-    executables_.emplace( move( item ) ) ;
-  }
+  values_ = DataList { move( values ) };
+  thunks_ = DataList { move( thunks ) };
 
   throw_if_error();
 }
@@ -111,21 +119,10 @@ Thunk::Thunk( Function && function,
               vector<DataItem> && thunks,
               vector<DataItem> && executables,
               vector<string> && outputs )
-  : function_( move( function ) ), values_(), thunks_(), executables_(),
+  : function_( move( function ) ), values_( move( values ) ),
+    thunks_( move( thunks ) ), executables_( move( executables ) ),
     outputs_( move( outputs ) )
 {
-  for ( DataItem & item : values ) {
-    values_.emplace( move( item ) );
-  }
-
-  for ( DataItem & item : thunks ) {
-    thunks_.emplace( move( item ) );
-  }
-
-  for ( DataItem & item : executables ) {
-    executables_.emplace( move( item ) ) ;
-  }
-
   throw_if_error();
 }
 
@@ -139,13 +136,14 @@ Thunk::Thunk( Function && function, DataList && values,
   throw_if_error();
 }
 
-Thunk::Thunk( const gg::protobuf::Thunk & thunk_proto )
+Thunk::Thunk( const gg::protobuf::Thunk & thunk_proto, const uint8_t version )
   : function_( thunk_proto.function() ),
     values_(),
     thunks_(),
     executables_(),
     outputs_( thunk_proto.outputs().cbegin(), thunk_proto.outputs().cend() ),
-    timeout_( thunk_proto.timeout() )
+    timeout_( thunk_proto.timeout() ),
+    version_( version )
 {
   for ( const string & item : thunk_proto.values() ) {
     values_.emplace( string_to_data( item ) );
@@ -174,27 +172,12 @@ int Thunk::execute() const
 
   bool verbose = ( getenv( "GG_VERBOSE" ) != nullptr );
 
-  // preparing argv
-  vector<string> args = function_.args();
-  vector<string> envars { function_.envars() };
-
-  auto replace_data_placeholder =
-    []( string & str ) -> void
-    {
-      if ( regex_search( str, DATA_PLACEHOLDER_REGEX ) ) {
-        string new_path = regex_replace( str, DATA_PLACEHOLDER_REGEX, gg::paths::blob( "$1" ).string() );
-        swap( str, new_path );
-      }
-    };
+  /* replace the hash placeholders with the actual paths */
+  auto blob_path = []( const string & hash ) { return gg::paths::blob( hash ).string(); };
 
-  /* do we need to replace a hash placeholder with the actual path? */
-  for ( string & arg : args ) {
-    replace_data_placeholder( arg );
-  }
-
-  for ( string & envar : envars ) {
-    replace_data_placeholder( envar );
-  }
+  // preparing argv
+  vector<string> args = function_.substituted_args( blob_path );
+  vector<string> envars = function_.substituted_envars( blob_path );
 
   const roost::path thunk_path = gg::paths::blob( hash() );
 
@@ -264,24 +247,51 @@ string Thunk::execution_payload( const vector<Thunk> & thunks )
   return protoutil::to_json( request );
 }
 
-protobuf::Thunk Thunk::to_protobuf() const
+void Thunk::add_section( protobuf::Thunk & thunk_proto, const Section section ) const
 {
-  protobuf::Thunk thunk_proto;
-
-  *thunk_proto.mutable_function() = function_.to_protobuf();
+  switch ( section ) {
+  case FUNCTION_SECTION:
+    *thunk_proto.mutable_function() = function_.to_protobuf();
+    break;
+
+  case VALUES_SECTION:
+    for ( const auto & h : values_ ) { thunk_proto.add_values( data_to_string( h ) ); }
+    break;
+
+  case THUNKS_SECTION:
+    for ( const auto & h : thunks_ ) { thunk_proto.add_thunks( data_to_string( h ) ); }
+    break;
+
+  case EXECUTABLES_SECTION:
+    for ( const auto & h : executables_ ) { thunk_proto.add_executables( data_to_string( h ) ); }
+    break;
+
+  case OUTPUTS_SECTION:
+    for ( const string & output : outputs_ ) { thunk_proto.add_outputs( output ); }
+    break;
+
+  case OPTIONS_SECTION:
+    for ( const auto & l : links_ ) {
+      auto & link = *thunk_proto.add_links();
+      link.set_name( l.first );
+      link.set_target( l.second );
+    }
 
-  for ( const auto & h : values_ ) { thunk_proto.add_values( data_to_string( h ) ); }
-  for ( const auto & h : thunks_ ) { thunk_proto.add_thunks( data_to_string( h ) ); }
-  for ( const auto & h : executables_ ) { thunk_proto.add_executables( data_to_string( h ) ); }
-  for ( const string & output : outputs_ ) { thunk_proto.add_outputs( output ); }
+    thunk_proto.set_timeout( timeout_.count() );
+    break;
 
-  for ( const auto & l : links_ ) {
-    auto & link = *thunk_proto.add_links();
-    link.set_name( l.first );
-    link.set_target( l.second );
+  case SECTION_COUNT:
+    throw runtime_error( "invalid thunk section" );
   }
+}
 
-  thunk_proto.set_timeout( timeout_.count() );
+protobuf::Thunk Thunk::to_protobuf() const
+{
+  protobuf::Thunk thunk_proto;
+
+  for ( size_t i = 0; i < SECTION_COUNT; i++ ) {
+    add_section( thunk_proto, static_cast<Section>( i ) );
+  }
 
   return thunk_proto;
 }
@@ -298,21 +308,87 @@ bool Thunk::operator==( const Thunk & other ) const
 
 void Thunk::set_timeout( const std::chrono::milliseconds & timeout )
 {
-  hash_.clear();
+  invalidate( OPTIONS_SECTION );
   timeout_ = timeout;
 }
 
 void Thunk::add_link( const string & name, const string & hash )
 {
-  hash_.clear();
+  invalidate( OPTIONS_SECTION );
   links_.emplace_back( name, hash );
 }
 
+void Thunk::set_version( const uint8_t version )
+{
+  if ( version != 1 and version != 2 ) {
+    throw runtime_error( "unknown thunk version: " + to_string( version ) );
+  }
+
+  hash_.clear();
+  version_ = version;
+}
+
+void Thunk::invalidate( const Section section )
+{
+  hash_.clear();
+
+  if ( not section_digests_.empty() ) {
+    section_digests_[ section ].valid = false;
+  }
+}
+
+string Thunk::sections_hash() const
+{
+  if ( section_digests_.empty() ) {
+    section_digests_.resize( SECTION_COUNT );
+  }
+
+  string digests;
+  digests.reserve( MAGIC_NUMBER_V2.length() + SECTION_COUNT * Hash::DIGEST_LENGTH );
+  digests.append( MAGIC_NUMBER_V2 );
+
+  size_t total_size = MAGIC_NUMBER_V2.length();
+
+  for ( size_t i = 0; i < SECTION_COUNT; i++ ) {
+    SectionDigest & section = section_digests_[ i ];
+
+    if ( not section.valid ) {
+      protobuf::Thunk section_proto;
+      add_section( section_proto, static_cast<Section>( i ) );
+      const string data = section_proto.SerializeAsString();
+
+      SHA256().CalculateDigest( section.digest.data(),
+                                reinterpret_cast<const uint8_t *>( data.data() ),
+                                data.length() );
+      section.size = data.length();
+      section.valid = true;
+    }
+
+    digests.append( reinterpret_cast<const char *>( section.digest.data() ),
+                    section.digest.size() );
+    total_size += section.size;
+  }
+
+  /* the fields of a protobuf are serialized one after the other, so the
+     sizes of the sections add up to the size of the serialized thunk */
+  array<uint8_t, Hash::DIGEST_LENGTH> root;
+  SHA256().CalculateDigest( root.data(),
+                            reinterpret_cast<const uint8_t *>( digests.data() ),
+                            digests.length() );
+
+  return Hash { ObjectType::Thunk, root, total_size }.str();
+}
+
 string Thunk::hash() const
 {
   if ( not hash_.initialized() ) {
-    hash_.reset( gg::hash::compute( ThunkWriter::serialize( *this ),
-                                    ObjectType::Thunk ) );
+    if ( version_ == 1 ) {
+      hash_.reset( gg::hash::compute( ThunkWriter::serialize( *this ),
+                                      ObjectType::Thunk ) );
+    }
+    else {
+      hash_.reset( sections_hash() );
+    }
   }
 
   return *hash_;
@@ -339,7 +415,8 @@ string Thunk::executable_hash() const
 void Thunk::update_data( const string & original_hash,
                          const vector<ThunkOutput> & outputs )
 {
-  hash_.clear(); /* invalidating the cached hash */
+  invalidate( THUNKS_SECTION );
+  version_ = 2;
 
   bool first_output = true;
 
@@ -356,43 +433,26 @@ void Thunk::update_data( const string & original_hash,
 
     auto result = thunks_.equal_range( old_hash );
 
-    vector<string> old_names;
+    /* the names are interned, so they outlive the erased items */
+    vector<const string *> old_names;
 
-    for ( auto it = result.first; it != result.second; ) {
-      old_names.emplace_back( move( it->second ) );
-      it = thunks_.erase( it );
+    for ( auto it = result.first; it != result.second; it = thunks_.erase( it ) ) {
+      old_names.push_back( &it->second );
     }
 
-    for ( const auto & old_name : old_names ) {
+    for ( const string * old_name : old_names ) {
       switch ( hash::type( new_hash ) ) {
-      case ObjectType::Thunk: thunks_.insert( { new_hash, old_name } ); break;
-      case ObjectType::Value: values_.insert( { new_hash, old_name } ); break;
+      case ObjectType::Thunk: thunks_.insert( new_hash, *old_name ); break;
+      case ObjectType::Value:
+        values_.insert( new_hash, *old_name );
+        invalidate( VALUES_SECTION );
+        break;
       }
     }
 
     /* let's update the args/envs as necessary */
-    const string srcstr = data_placeholder( old_hash );
-    const string dststr = data_placeholder( new_hash );
-
-    auto update_placeholder =
-      []( string & str, const string & src, const string & dst )
-      {
-        size_t index = 0;
-
-        while ( true ) {
-          index = str.find( src, index );
-          if ( index == string::npos ) break;
-          str.replace( index, src.length(), dst );
-          index += dst.length();
-        }
-      };
-
-    for ( string & arg : function_.args() ) {
-      update_placeholder( arg, srcstr, dststr );
-    }
-
-    for ( string & envar : function_.envars() ) {
-      update_placeholder( envar, srcstr, dststr );
+    if ( function_.replace_placeholders( old_hash, new_hash ) ) {
+      invalidate( FUNCTION_SECTION );
     }
 
     first_output = false;
@@ -404,11 +464,11 @@ Thunk::get_allowed_files() const
 {
   unordered_map<string, Permissions> allowed_files;
 
-  for ( const DataItem & item : values_ ) {
+  for ( const auto & item : values_ ) {
     allowed_files[ gg::paths::blob( item.first ).string() ] = { true, false, false };
   }
 
-  for ( const DataItem & item : executables_ ) {
+  for ( const auto & item : executables_ ) {
     allowed_files[ gg::paths::blob( item.first ).string() ] = { true, false, true };
   }
 
@@ -426,12 +486,12 @@ size_t Thunk::infiles_size( const bool include_executables ) const
 {
   size_t total_size = 0;
 
-  for ( const DataItem & item : values_ ) {
+  for ( const auto & item : values_ ) {
     total_size += gg::hash::size( item.first );
   }
 
   if ( include_executables ) {
-    for ( const DataItem & item : executables_ ) {
+    for ( const auto & item : executables_ ) {
       total_size += gg::hash::size( item.first );
     }
   }
@@ -439,7 +499,7 @@ size_t Thunk::infiles_size( const bool include_executables ) const
   return total_size;
 }
 
-bool Thunk::matches_filesystem( const DataItem & item )
+bool Thunk::matches_filesystem( const DataList::reference & item )
 {
   const string & hash = item.first;
   const string & filename = item.second;
@@ -452,7 +512,7 @@ bool Thunk::matches_filesystem( const DataItem & item )
     return false;
   }
 
-  if ( gg::hash::size( hash ) != roost::file_size( filename ) ) {
+  if ( gg::hash::size( hash ) != static_cast<uint64_t>( roost::file_size( filename ) ) ) {
     return false;
   }
 
@@ -9,7 +9,6 @@
 #include <map>
 #include <unordered_map>
 #include <limits>
-#include <regex>
 #include <chrono>
 #include <sys/types.h>
 #include <crypto++/base64.h>
@@ -18,17 +17,13 @@
 #include "protobufs/thunk.pb.h"
 #include "protobufs/gg.pb.h"
 #include "sandbox/sandbox.hh"
+#include "thunk/data_list.hh"
+#include "thunk/hash.hh"
 #include "util/optional.hh"
 #include "util/path.hh"
 
 namespace gg {
 
-  enum class ObjectType : char
-  {
-    Value = 'V',
-    Thunk = 'T',
-  };
-
   struct ThunkOutput
   {
     std::string hash {};
@@ -46,22 +41,49 @@ namespace gg {
   namespace thunk {
 
     const std::string MAGIC_NUMBER = "##GGTHUNK##";
+
+    /* Version 2 thunks are hashed section by section (see Thunk::hash()).
+       Their header starts with MAGIC_NUMBER, so anything that only checks
+       for the magic number takes them for thunks; the next byte can't start
+       a protobuf, so it also tells the two versions apart. */
+    const std::string MAGIC_NUMBER_V2 = MAGIC_NUMBER + "v2";
+    constexpr uint8_t CURRENT_VERSION = 2;
     const std::string BEGIN_REPLACE = "__GG_BEGIN_REPLACE__";
     const std::string END_REPLACE = "__GG_END_REPLACE__";
 
     const std::string DATA_PLACEHOLDER_START = "@{GGHASH:";
     const std::string DATA_PLACEHOLDER_END = "}";
-    const std::regex DATA_PLACEHOLDER_REGEX { R"X(@\{GGHASH:([a-zA-Z0-9_.]+)(?:#([^/]+))?\})X" };
 
     std::string data_placeholder( const std::string & hash );
 
     class Function
     {
+    public:
+      typedef std::function<std::string( const std::string & hash )> PathFunc;
+
     private:
+      /* a data placeholder in one of the args or envars */
+      struct Placeholder
+      {
+        size_t offset { 0 };
+        std::string hash {}; /* with the output tag, if there's one */
+      };
+
       std::string hash_ {};
       std::vector<std::string> args_;
       std::vector<std::string> envars_ {};
 
+      /* the placeholders of args_, then of envars_, in the order they appear
+         in each string, and the strings each hash is referenced from; built
+         the first time the placeholders are replaced */
+      bool indexed_ { false };
+      std::vector<std::vector<Placeholder>> placeholders_ {};
+      std::unordered_map<std::string, std::vector<size_t>> references_ {};
+
+      std::string & string_at( const size_t index );
+      void index_placeholders();
+      void index_placeholders( const size_t index );
+
     public:
       Function( const std::string & hash,
                 const std::vector<std::string> & args,
@@ -78,8 +100,18 @@ namespace gg {
       const std::vector<std::string> & args() const { return args_; }
       const std::vector<std::string> & envars() const { return envars_; }
 
-      std::vector<std::string> & args() { return args_; }
-      std::vector<std::string> & envars() { return envars_; }
+      void add_envar( const std::string & envar );
+
+      /* points the placeholders of old_hash to new_hash, and returns false
+         if there were none; after the first call, this only touches the
+         strings that reference old_hash */
+      bool replace_placeholders( const std::string & old_hash,
+                                 const std::string & new_hash );
+
+      /* the args and envars, with every placeholder replaced by the path of
+         its object; the output tags are dropped */
+      std::vector<std::string> substituted_args( const PathFunc & path_of ) const;
+      std::vector<std::string> substituted_envars( const PathFunc & path_of ) const;
 
       gg::protobuf::Function to_protobuf() const;
 
@@ -90,11 +122,30 @@ namespace gg {
     class Thunk
     {
     public:
-      /* XXX maybe use unordered_multimap? */
-      typedef std::multimap<std::string, std::string> DataList;
+      typedef gg::thunk::DataList DataList;
       typedef DataList::value_type DataItem;
 
     private:
+      /* the parts of a version 2 thunk that are hashed separately, in the
+         order of their fields in the protobuf */
+      enum Section
+      {
+        FUNCTION_SECTION = 0,
+        VALUES_SECTION,
+        THUNKS_SECTION,
+        EXECUTABLES_SECTION,
+        OUTPUTS_SECTION,
+        OPTIONS_SECTION, /* the timeout and the links */
+        SECTION_COUNT
+      };
+
+      struct SectionDigest
+      {
+        std::array<uint8_t, Hash::DIGEST_LENGTH> digest {};
+        uint32_t size { 0 }; /* of the serialized section */
+        bool valid { false };
+      };
+
       Function function_;
       DataList values_;
       DataList thunks_;
@@ -103,10 +154,17 @@ namespace gg {
       std::vector<std::pair<std::string, std::string>> links_ {};
       std::chrono::milliseconds timeout_ { 0 };
 
+      uint8_t version_ { CURRENT_VERSION };
+
       mutable Optional<std::string> hash_ {};
+      mutable std::vector<SectionDigest> section_digests_ {};
 
       void throw_if_error() const;
 
+      void add_section( gg::protobuf::Thunk & thunk_proto, const Section section ) const;
+      void invalidate( const Section section );
+      std::string sections_hash() const;
+
     public:
       Thunk( const Function & function,
              const std::vector<DataItem> & data,
@@ -128,7 +186,8 @@ namespace gg {
              DataList && thunks, DataList && executables,
              std::vector<std::string> && outputs );
 
-      Thunk( const gg::protobuf::Thunk & thunk_proto );
+      Thunk( const gg::protobuf::Thunk & thunk_proto,
+             const uint8_t version = CURRENT_VERSION );
 
       int execute() const;
 
@@ -143,9 +202,11 @@ namespace gg {
       const std::vector<std::string> & outputs() const { return outputs_; }
       const std::vector<std::pair<std::string, std::string>> & links() const { return links_; }
       const std::chrono::milliseconds & timeout() const { return timeout_; }
+      uint8_t version() const { return version_; }
 
       void set_timeout( const std::chrono::milliseconds & timeout );
       void add_link( const std::string & name, const std::string & hash );
+      void set_version( const uint8_t version );
 
       gg::protobuf::Thunk to_protobuf() const;
 
@@ -153,6 +214,9 @@ namespace gg {
       bool operator!=( const Thunk & other ) const { return not operator==( other ); }
 
       void set_hash( const std::string & hash ) const { hash_.reset( hash ); }
+      /* the hash of a version 1 thunk is the hash of its serialized form;
+         for version 2, it's the hash of the digests of its sections, but
+         the size is still the size of the serialized thunk */
       std::string hash() const;
       std::string executable_hash() const;
       std::string output_hash( const std::string & tag ) const;
@@ -160,6 +224,8 @@ namespace gg {
       bool can_be_executed() const { return ( thunks_.size() == 0 ); }
       size_t infiles_size( const bool include_executables = true ) const;
 
+      /* replaces a dependency with its outputs; the thunk is upgraded to
+         version 2, so that only the sections that change are rehashed */
       void update_data( const std::string & old_hash,
                         const std::vector<ThunkOutput> & outputs );
 
@@ -167,10 +233,9 @@ namespace gg {
          thunk. */
       std::unordered_map<std::string, Permissions> get_allowed_files() const;
 
-      static std::pair<const std::string, std::string>
-      string_to_data( const std::string & str );
+      static DataItem string_to_data( const std::string & str );
 
-      static bool matches_filesystem( const DataItem & item );
+      static bool matches_filesystem( const DataList::reference & item );
     };
 
   } /* namespace thunk */
@@ -1,6 +1,9 @@
 /* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
 
 #include <fcntl.h>
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include "thunk/thunk_reader.hh"
 #include "util/exception.hh"
@@ -10,6 +13,184 @@
 using namespace std;
 using namespace gg;
 using namespace gg::thunk;
+using namespace google::protobuf::io;
+using google::protobuf::internal::WireFormatLite;
+
+namespace {
+
+  /* a length-delimited field, in the buffer that's being parsed */
+  struct Field
+  {
+    const char * data { "" };
+    size_t length { 0 };
+
+    string str() const { return { data, length }; }
+    const uint8_t * bytes() const { return reinterpret_cast<const uint8_t *>( data ); }
+  };
+
+  constexpr uint32_t field_tag( const int number )
+  {
+    return WireFormatLite::MakeTag( number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED );
+  }
+
+  bool read_field( CodedInputStream & input, Field & field )
+  {
+    uint32_t length;
+
+    if ( not input.ReadVarint32( &length ) ) {
+      return false;
+    }
+
+    field = {};
+
+    if ( length > 0 ) {
+      const void * data;
+      int available;
+
+      if ( not input.GetDirectBufferPointer( &data, &available )
+           or static_cast<uint32_t>( available ) < length ) {
+        return false;
+      }
+
+      field = { static_cast<const char *>( data ), length };
+    }
+
+    return input.Skip( length );
+  }
+
+  /* "hash=name", or just the hash */
+  void add_data_item( DataList & list, const Field & field )
+  {
+    static const string no_name {};
+    const char * eqpos = static_cast<const char *>( memchr( field.data, '=', field.length ) );
+
+    if ( eqpos == nullptr ) {
+      list.insert( field.str(), no_name );
+    }
+    else {
+      list.insert( string( field.data, eqpos ), string( eqpos + 1, field.data + field.length ) );
+    }
+  }
+
+  /* the parts of a thunk, as they come out of the protobuf */
+  struct ThunkFields
+  {
+    string function_hash {};
+    vector<string> args {};
+    vector<string> envars {};
+    DataList values {};
+    DataList thunks {};
+    DataList executables {};
+    vector<string> outputs {};
+    vector<pair<string, string>> links {};
+    uint32_t timeout { 0 };
+  };
+
+  bool parse_function( const Field & message, ThunkFields & fields )
+  {
+    CodedInputStream input { message.bytes(), static_cast<int>( message.length ) };
+    Field field;
+
+    while ( const uint32_t tag = input.ReadTag() ) {
+      switch ( tag ) {
+      case field_tag( protobuf::Function::kHashFieldNumber ):
+        if ( not read_field( input, field ) ) { return false; }
+        fields.function_hash = field.str();
+        break;
+
+      case field_tag( protobuf::Function::kArgsFieldNumber ):
+        if ( not read_field( input, field ) ) { return false; }
+        fields.args.emplace_back( field.str() );
+        break;
+
+      case field_tag( protobuf::Function::kEnvarsFieldNumber ):
+        if ( not read_field( input, field ) ) { return false; }
+        fields.envars.emplace_back( field.str() );
+        break;
+
+      default:
+        if ( not WireFormatLite::SkipField( &input, tag ) ) { return false; }
+      }
+    }
+
+    return input.ConsumedEntireMessage();
+  }
+
+  bool parse_link( const Field & message, ThunkFields & fields )
+  {
+    CodedInputStream input { message.bytes(), static_cast<int>( message.length ) };
+    Field field;
+    pair<string, string> link;
+
+    while ( const uint32_t tag = input.ReadTag() ) {
+      switch ( tag ) {
+      case field_tag( protobuf::Link::kNameFieldNumber ):
+        if ( not read_field( input, field ) ) { return false; }
+        link.first = field.str();
+        break;
+
+      case field_tag( protobuf::Link::kTargetFieldNumber ):
+        if ( not read_field( input, field ) ) { return false; }
+        link.second = field.str();
+        break;
+
+      default:
+        if ( not WireFormatLite::SkipField( &input, tag ) ) { return false; }
+      }
+    }
+
+    fields.links.emplace_back( move( link ) );
+    return input.ConsumedEntireMessage();
+  }
+
+  /* reads the fields straight out of the buffer, so that every string is
+     only copied once, into the thunk, instead of into a protobuf::Thunk
+     first. Follows the protobuf rules: fields can come in any order, the
+     last value of a scalar wins, and unknown fields are skipped. */
+  bool parse_thunk( const Field & message, ThunkFields & fields )
+  {
+    CodedInputStream input { message.bytes(), static_cast<int>( message.length ) };
+    Field field;
+
+    while ( const uint32_t tag = input.ReadTag() ) {
+      if ( tag == WireFormatLite::MakeTag( protobuf::Thunk::kTimeoutFieldNumber,
+                                           WireFormatLite::WIRETYPE_VARINT ) ) {
+        if ( not input.ReadVarint32( &fields.timeout ) ) { return false; }
+        continue;
+      }
+
+      if ( WireFormatLite::GetTagWireType( tag ) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED ) {
+        if ( not WireFormatLite::SkipField( &input, tag ) ) { return false; }
+        continue;
+      }
+
+      if ( not read_field( input, field ) ) {
+        return false;
+      }
+
+      switch ( WireFormatLite::GetTagFieldNumber( tag ) ) {
+      case protobuf::Thunk::kFunctionFieldNumber:
+        if ( not parse_function( field, fields ) ) { return false; }
+        break;
+
+      case protobuf::Thunk::kValuesFieldNumber: add_data_item( fields.values, field ); break;
+      case protobuf::Thunk::kThunksFieldNumber: add_data_item( fields.thunks, field ); break;
+      case protobuf::Thunk::kExecutablesFieldNumber: add_data_item( fields.executables, field ); break;
+      case protobuf::Thunk::kOutputsFieldNumber: fields.outputs.emplace_back( field.str() ); break;
+
+      case protobuf::Thunk::kLinksFieldNumber:
+        if ( not parse_link( field, fields ) ) { return false; }
+        break;
+
+      default:
+        break;
+      }
+    }
+
+    return input.ConsumedEntireMessage();
+  }
+
+}
 
 bool ThunkReader::is_thunk( const roost::path & path )
 {
@@ -21,13 +202,55 @@ bool ThunkReader::is_thunk( const roost::path & path )
 
 Thunk ThunkReader::read( const roost::path & path, const std::string & hash )
 {
-  ProtobufDeserializer deserializer { path.string() };
-  protobuf::Thunk thunk_proto;
+  return parse( roost::read_file( path ), hash );
+}
 
-  deserializer.read_string( MAGIC_NUMBER.length() ); /* skipping the magic number */
-  deserializer.read_protobuf( thunk_proto );
+Thunk ThunkReader::parse( const string & data, const string & hash )
+{
+  return parse( data.data(), data.length(), hash );
+}
+
+Thunk ThunkReader::parse( const char * data, const size_t length, const string & hash )
+{
+  uint8_t version;
+  size_t header_length;
+
+  auto has_magic =
+    [data, length] ( const string & magic )
+    {
+      return length >= magic.length() and magic.compare( 0, magic.length(), data, magic.length() ) == 0;
+    };
+
+  if ( has_magic( MAGIC_NUMBER_V2 ) ) {
+    version = 2;
+    header_length = MAGIC_NUMBER_V2.length();
+  }
+  else if ( has_magic( MAGIC_NUMBER ) ) {
+    version = 1;
+    header_length = MAGIC_NUMBER.length();
+  }
+  else {
+    throw runtime_error( "not a thunk" );
+  }
+
+  ThunkFields fields;
+
+  if ( length - header_length > static_cast<size_t>( numeric_limits<int>::max() ) or
+       not parse_thunk( { data + header_length, length - header_length }, fields ) ) {
+    throw runtime_error( "could not parse thunk" );
+  }
+
+  Thunk thunk { { move( fields.function_hash ), move( fields.args ), move( fields.envars ) },
+                move( fields.values ), move( fields.thunks ), move( fields.executables ),
+                move( fields.outputs ) };
+
+  thunk.set_timeout( chrono::milliseconds { fields.timeout } );
+
+  for ( const auto & link : fields.links ) {
+    thunk.add_link( link.first, link.second );
+  }
 
-  Thunk thunk { thunk_proto };
+  thunk.set_version( version );
 
   if ( hash.length() > 0 ) {
     thunk.set_hash( hash );
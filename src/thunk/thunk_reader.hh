@@ -18,4 +18,10 @@ private:
 public:
   static bool is_thunk( const roost::path & path );
   static gg::thunk::Thunk read( const roost::path & path, const std::string & hash = {} );
+
+  /* parses a serialized thunk of either version; nothing points into the
+     data once it returns, so it can be a mapped file */
+  static gg::thunk::Thunk parse( const std::string & data, const std::string & hash = {} );
+  static gg::thunk::Thunk parse( const char * data, const size_t length,
+                                 const std::string & hash = {} );
 };
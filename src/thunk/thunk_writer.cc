@@ -17,8 +17,9 @@ using namespace gg::thunk;
 string ThunkWriter::write( const Thunk & thunk, const roost::path & path )
 {
   const string serialized_thunk = serialize( thunk );
-  const string thunk_hash = gg::hash::compute( serialized_thunk,
-                                               ObjectType::Thunk );
+  const string thunk_hash = ( thunk.version() == 1 )
+                          ? gg::hash::compute( serialized_thunk, ObjectType::Thunk )
+                          : thunk.hash();
   thunk.set_hash( thunk_hash );
 
   roost::path target_path { ( not path.empty() ) ? path
@@ -33,7 +34,7 @@ string ThunkWriter::write( const Thunk & thunk, const roost::path & path )
 
 string ThunkWriter::serialize( const gg::thunk::Thunk & thunk )
 {
-  string ret { MAGIC_NUMBER };
+  string ret { ( thunk.version() == 1 ) ? MAGIC_NUMBER : MAGIC_NUMBER_V2 };
   if ( not thunk.to_protobuf().AppendToString( &ret ) ) {
     throw runtime_error( "could not serialize thunk" );
   }
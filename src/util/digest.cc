@@ -2,7 +2,6 @@
 
 #include "digest.hh"
 
-#include <crypto++/sha.h>
 #include <crypto++/hex.h>
 #include <crypto++/base64.h>
 
@@ -11,15 +10,42 @@ using namespace std;
 
 string digest::sha256( const string & input )
 {
-  SHA256 hash_function;
+  return sha256( input.data(), input.length() );
+}
+
+string digest::sha256( const char * data, const size_t length )
+{
+  StreamingSHA256 hash_function;
+  hash_function.update( data, length );
+  return hash_function.finish();
+}
+
+void digest::StreamingSHA256::update( const char * data, const size_t length )
+{
+  hash_function_.Update( reinterpret_cast<const byte *>( data ), length );
+}
+
+string digest::StreamingSHA256::finish()
+{
+  string raw_digest( SHA256::DIGESTSIZE, '\0' );
+  hash_function_.Final( reinterpret_cast<byte *>( &raw_digest[ 0 ] ) );
+
   string ret;
 
   /* Each stage of the Crypto++ pipeline will delete the pointer it owns
      (https://www.cryptopp.com/wiki/Pipelining) */
 
-  StringSource s( input, true,
-                  new HashFilter( hash_function,
-                                  new Base64URLEncoder( new StringSink( ret ), false ) ) );
+  StringSource s( raw_digest, true,
+                  new Base64URLEncoder( new StringSink( ret ), false ) );
 
   return ret;
 }
+
+string digest::sha256_implementation()
+{
+#if CRYPTOPP_VERSION >= 800
+  return SHA256().AlgorithmProvider();
+#else
+  return "unknown";
+#endif
+}
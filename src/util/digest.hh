@@ -4,10 +4,32 @@
 #define DIGEST_HH
 
 #include <string>
+#include <crypto++/sha.h>
 
 namespace digest
 {
+  /* base64url, without padding */
   std::string sha256( const std::string & input );
+  std::string sha256( const char * data, const size_t length );
+
+  /* SHA-256 of input that comes in pieces, e.g. a file that's read one
+     buffer at a time */
+  class StreamingSHA256
+  {
+  private:
+    CryptoPP::SHA256 hash_function_ {};
+
+  public:
+    void update( const char * data, const size_t length );
+
+    /* the digest of everything so far, encoded like sha256(); the object
+       can be used again afterwards */
+    std::string finish();
+  };
+
+  /* the instructions that SHA-256 runs on, as Crypto++ picked them for this
+     CPU, e.g. "SHANI" */
+  std::string sha256_implementation();
 }
 
 #endif /* DIGEST_HH */
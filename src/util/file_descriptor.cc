@@ -138,6 +138,17 @@ void FileDescriptor::block_for_exclusive_lock()
   CheckSystemCall( "flock", flock( fd_num(), LOCK_EX ) );
 }
 
+FileLock::FileLock( const FileDescriptor & file )
+  : file_( file )
+{
+  CheckSystemCall( "flock", flock( file_.fd_num(), LOCK_EX ) );
+}
+
+FileLock::~FileLock()
+{
+  flock( file_.fd_num(), LOCK_UN );
+}
+
 void FileDescriptor::set_blocking( const bool block )
 {
   int flags = CheckSystemCall( "fcntl F_GETFL", fcntl( fd_, F_GETFL ) );
@@ -64,4 +64,19 @@ public:
   const FileDescriptor & operator=( const FileDescriptor & other ) = delete;
 };
 
+/* holds an exclusive flock() on a file for as long as it's alive */
+class FileLock
+{
+private:
+  const FileDescriptor & file_;
+
+public:
+  FileLock( const FileDescriptor & file );
+  ~FileLock();
+
+  /* forbid copying */
+  FileLock( const FileLock & other ) = delete;
+  FileLock & operator=( const FileLock & other ) = delete;
+};
+
 #endif /* FILE_DESCRIPTOR_HH */
@@ -13,6 +13,15 @@ private:
   std::vector<std::pair<Iterator, Iterator>> iterators_;
   size_t current_;
 
+  /* moves on to the next range that has something left in it */
+  void skip_exhausted()
+  {
+    while ( current_ < iterators_.size() and
+            iterators_[ current_ ].first == iterators_[ current_ ].second ) {
+      current_++;
+    }
+  }
+
 public:
   typedef std::forward_iterator_tag iterator_category;
   typedef typename std::iterator_traits<Iterator>::value_type value_type;
@@ -23,7 +32,9 @@ public:
                 Iterator t2_begin, Iterator t2_end, const size_t current = 0 )
     : iterators_( { { t1_begin, t1_end }, { t2_begin, t2_end } } ),
       current_( current )
-  {}
+  {
+    skip_exhausted();
+  }
 
   JoinIterator & operator++()
   {
@@ -31,53 +42,23 @@ public:
       return *this;
     }
 
-    if ( iterators_.at( current_ ).first != iterators_.at( current_ ).second ) {
-      iterators_.at( current_ ).first++;
-    }
-    else {
-      current_++;
-    }
-
+    iterators_[ current_ ].first++;
+    skip_exhausted();
     return *this;
   }
 
-  reference operator*()
-  {
-    auto & c = iterators_[ current_ ];
-
-    if ( c.first != c.second ) {
-      return *c.first;
-    }
-
-    return *iterators_[ current_ + 1 ].first;
-  }
-
-  pointer operator->()
-  {
-    auto & c = iterators_[ current_ ];
-
-    if ( c.first != c.second ) {
-      return &( *c.first );
-    }
-
-    return &( *iterators_[ current_ + 1 ].first );
-  }
+  reference operator*() { return *iterators_[ current_ ].first; }
+  pointer operator->() { return &( *iterators_[ current_ ].first ); }
 
+  /* every iterator past the end is the same */
   bool operator==( const JoinIterator & other )
   {
-    if ( current_ != other.current_ or
-         iterators_.size() != other.iterators_.size() ) {
+    if ( current_ != other.current_ ) {
       return false;
     }
 
-    for ( size_t i = 0; i < iterators_.size(); i++ ) {
-      if ( iterators_[ i ].first != other.iterators_[ i ].first or
-           iterators_[ i ].second != other.iterators_[ i ].second ) {
-        return false;
-      }
-    }
-
-    return true;
+    return current_ == iterators_.size() or
+           iterators_[ current_ ].first == other.iterators_[ current_ ].first;
   }
 
   bool operator!=( const JoinIterator & other ) { return not operator==( other ); }
@@ -94,7 +75,7 @@ public:
   JoinContainer( Iterator c1_begin, Iterator c1_end,
                  Iterator c2_begin, Iterator c2_end )
     : begin_( c1_begin, c1_end, c2_begin, c2_end ),
-      end_( c1_end, c1_end, c2_end, c2_end, 1 )
+      end_( c1_end, c1_end, c2_end, c2_end, 2 )
   {}
 
   JoinIterator<Iterator> begin() { return begin_; }
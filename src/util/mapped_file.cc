@@ -0,0 +1,49 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "mapped_file.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+using namespace std;
+
+MappedFile::MappedFile( const string & filename )
+{
+  FileDescriptor file { CheckSystemCall( "open (" + filename + ")",
+                                         open( filename.c_str(), O_RDONLY ) ) };
+
+  struct stat file_stat;
+  CheckSystemCall( "fstat", fstat( file.fd_num(), &file_stat ) );
+  size_ = file_stat.st_size;
+
+  /* mmap() doesn't accept empty mappings */
+  if ( size_ == 0 ) {
+    return;
+  }
+
+  void * mapping = mmap( nullptr, size_, PROT_READ, MAP_SHARED, file.fd_num(), 0 );
+
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap (" + filename + ")" );
+  }
+
+  data_ = static_cast<const char *>( mapping );
+}
+
+MappedFile::MappedFile( MappedFile && other )
+  : data_( other.data_ ), size_( other.size_ )
+{
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile::~MappedFile()
+{
+  if ( data_ != nullptr ) {
+    munmap( const_cast<char *>( data_ ), size_ );
+  }
+}
@@ -0,0 +1,33 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <string>
+
+/* a read-only, shared memory mapping of a whole file */
+class MappedFile
+{
+private:
+  const char * data_ { nullptr };
+  size_t size_ { 0 };
+
+public:
+  MappedFile( const std::string & filename );
+  ~MappedFile();
+
+  const char * data() const { return data_; }
+  size_t size() const { return size_; }
+
+  /* ban copying */
+  MappedFile( const MappedFile & other ) = delete;
+  MappedFile & operator=( const MappedFile & other ) = delete;
+
+  /* allow move constructor */
+  MappedFile( MappedFile && other );
+
+  /* ... but not move assignment operator */
+  MappedFile & operator=( MappedFile && other ) = delete;
+};
+
+#endif /* MAPPED_FILE_HH */
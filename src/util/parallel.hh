@@ -0,0 +1,74 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef PARALLEL_HH
+#define PARALLEL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* the number of threads for work that mostly waits on the file system, which
+   can keep more threads busy than there are cores */
+inline size_t io_thread_count()
+{
+  return std::max<size_t>( 8, std::thread::hardware_concurrency() );
+}
+
+/* calls f( i ) for every i in [0, count), on up to thread_count threads, and
+   returns once all the calls are done. after a call throws, no more calls are
+   started, and the exception is rethrown here. the threads are gone by the
+   time this returns, so the caller can still fork. */
+template<class Function>
+void parallel_for( const size_t count, const size_t thread_count, Function && f )
+{
+  if ( count <= 1 or thread_count <= 1 ) {
+    for ( size_t i = 0; i < count; i++ ) {
+      f( i );
+    }
+
+    return;
+  }
+
+  std::atomic<size_t> next { 0 };
+  std::atomic<bool> failed { false };
+  std::mutex failure_mutex;
+  std::exception_ptr failure;
+
+  auto worker =
+    [&] ()
+    {
+      for ( size_t i = next++; i < count and not failed; i = next++ ) {
+        try {
+          f( i );
+        }
+        catch ( ... ) {
+          std::lock_guard<std::mutex> lock { failure_mutex };
+
+          if ( not failure ) {
+            failure = std::current_exception();
+          }
+
+          failed = true;
+        }
+      }
+    };
+
+  std::vector<std::thread> threads;
+
+  for ( size_t i = 0; i < std::min( count, thread_count ); i++ ) {
+    threads.emplace_back( worker );
+  }
+
+  for ( auto & thread : threads ) {
+    thread.join();
+  }
+
+  if ( failure ) {
+    std::rethrow_exception( failure );
+  }
+}
+
+#endif /* PARALLEL_HH */
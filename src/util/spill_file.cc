@@ -0,0 +1,49 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "spill_file.hh"
+
+#include <limits>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "exception.hh"
+
+using namespace std;
+
+SpillFile::SpillFile( const string & filename_template )
+  : file_( filename_template )
+{
+  CheckSystemCall( "unlink", unlink( file_.name().c_str() ) );
+}
+
+SpillFile::Record SpillFile::append( const string & data )
+{
+  if ( data.length() > numeric_limits<uint32_t>::max() ) {
+    throw runtime_error( "spill record too large" );
+  }
+
+  const Record record { size_, static_cast<uint32_t>( data.length() ) };
+  file_.fd().write( data );
+  size_ += data.length();
+  return record;
+}
+
+string SpillFile::read( const Record & record )
+{
+  string data( record.length, '\0' );
+  size_t done = 0;
+
+  while ( done < data.length() ) {
+    const ssize_t count = CheckSystemCall( "pread",
+      pread( file_.fd().fd_num(), &data[ done ], data.length() - done,
+             record.offset + done ) );
+
+    if ( count == 0 ) {
+      throw runtime_error( "spill file is shorter than expected" );
+    }
+
+    done += count;
+  }
+
+  return data;
+}
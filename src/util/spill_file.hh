@@ -0,0 +1,36 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SPILL_FILE_HH
+#define SPILL_FILE_HH
+
+#include <string>
+#include <cstdint>
+
+#include "temp_file.hh"
+
+/* an append-only temporary file, for data that's kept out of memory until
+   it's needed again. the file is unlinked as soon as it's created, so it goes
+   away with the object, or the process; the space isn't reused. */
+class SpillFile
+{
+public:
+  struct Record
+  {
+    uint64_t offset;
+    uint32_t length;
+  };
+
+private:
+  UniqueFile file_;
+  uint64_t size_ { 0 };
+
+public:
+  SpillFile( const std::string & filename_template );
+
+  Record append( const std::string & data );
+  std::string read( const Record & record );
+
+  uint64_t size() const { return size_; }
+};
+
+#endif /* SPILL_FILE_HH */
@@ -0,0 +1,174 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "execution/batcher.hh"
+#include "thunk/ggutils.hh"
+#include "thunk/thunk.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+/* a thunk with a 1000-byte executable and a 10-byte value */
+Thunk make_thunk( const string & executable, const string & name )
+{
+  const string exe_hash = gg::hash::compute( string( 1000, executable[ 0 ] ),
+                                             ObjectType::Value );
+  const string value_hash = gg::hash::compute( name + string( 10 - name.length(), ' ' ),
+                                               ObjectType::Value );
+
+  return { { exe_hash, { name }, {} }, { { value_hash, "" } }, {},
+           { { exe_hash, "" } }, { "out" } };
+}
+
+size_t distinct_bytes( const vector<Thunk> & thunks )
+{
+  vector<string> seen;
+  size_t total = 0;
+
+  for ( const Thunk & thunk : thunks ) {
+    for ( const auto & items : { thunk.values(), thunk.executables() } ) {
+      for ( const auto & item : items ) {
+        if ( find( seen.begin(), seen.end(), item.first ) == seen.end() ) {
+          seen.push_back( item.first );
+          total += gg::hash::size( item.first );
+        }
+      }
+    }
+  }
+
+  return total;
+}
+
+bool rejects( const BatchLimits & limits )
+{
+  try {
+    ThunkBatcher { [] ( vector<Thunk> &&, ExecutionLoop & ) {} }.set_limits( limits );
+  }
+  catch ( const runtime_error & ) {
+    return true;
+  }
+
+  return false;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    check( rejects( { 0, 0, 10ms } ) and rejects( { 2, 0, 0ms } )
+           and not rejects( { 1, 0, 0ms } ), "limits" );
+
+    ExecutionLoop loop;
+    vector<vector<Thunk>> sent;
+    size_t max_fitting_bytes = 0;
+
+    ThunkBatcher batcher {
+      [&sent] ( vector<Thunk> && thunks, ExecutionLoop & ) { sent.push_back( move( thunks ) ); },
+      [&max_fitting_bytes] ( const vector<Thunk> & thunks )
+      { return max_fitting_bytes == 0 or distinct_bytes( thunks ) <= max_fitting_bytes; } };
+
+    const Thunk a1 = make_thunk( "a", "a1" );
+    const Thunk a2 = make_thunk( "a", "a2" );
+    const Thunk a3 = make_thunk( "a", "a3" );
+    const Thunk b1 = make_thunk( "b", "b1" );
+
+    /* runs the loop until the given number of batches is sent, or for a
+       while longer than the linger time */
+    auto wait_for =
+      [&] ( const size_t batches )
+      {
+        const auto deadline = steady_clock::now() + 200ms;
+
+        while ( sent.size() < batches and steady_clock::now() < deadline ) {
+          loop.loop_once( 10 );
+        }
+      };
+
+    /* without batching, every thunk is sent right away */
+    batcher.add( a1, loop );
+    check( sent.size() == 1 and sent.back().size() == 1, "no batching" );
+    sent.clear();
+
+    /* the batch that doesn't fill up is sent after the linger time, and only
+       the thunks that share the executables are batched together */
+    batcher.set_limits( { 3, 0, 20ms } );
+    batcher.add( a1, loop );
+    batcher.add( b1, loop );
+    batcher.add( a2, loop );
+    batcher.add( a2, loop );
+    check( sent.empty(), "lingering" );
+
+    wait_for( 2 );
+    check( sent.size() == 2, "linger" );
+    check( ( sent[ 0 ].size() == 2 and sent[ 1 ].size() == 1 ) or
+           ( sent[ 0 ].size() == 1 and sent[ 1 ].size() == 2 ), "by executable, deduplicated" );
+    sent.clear();
+
+    /* a full batch is sent right away */
+    batcher.add( a1, loop );
+    batcher.add( a2, loop );
+    batcher.add( a3, loop );
+    check( sent.size() == 1 and sent.back().size() == 3, "size" );
+    sent.clear();
+
+    /* the shared executable is counted once: 1000 + 3 * 10 bytes */
+    batcher.set_limits( { 10, 1030, 20ms } );
+    batcher.add( a1, loop );
+    batcher.add( a2, loop );
+    check( sent.empty(), "bytes, shared executable" );
+    batcher.add( a3, loop );
+    check( sent.size() == 1 and sent.back().size() == 3, "bytes, full" );
+    sent.clear();
+
+    batcher.set_limits( { 10, 1020, 20ms } );
+    batcher.add( a1, loop );
+    batcher.add( a2, loop );
+    check( sent.size() == 1 and sent.back().size() == 2, "bytes, at the limit" );
+    batcher.add( a3, loop );
+    check( sent.size() == 1, "bytes, next batch" );
+    wait_for( 2 );
+    check( sent.size() == 2 and sent.back().size() == 1, "bytes, next batch sent" );
+    sent.clear();
+
+    /* a thunk that the engine couldn't run along with the batch starts a
+       new one */
+    batcher.set_limits( { 10, 0, 20ms } );
+    max_fitting_bytes = 1020;
+    batcher.add( a1, loop );
+    batcher.add( a2, loop );
+    check( sent.empty(), "fits" );
+    batcher.add( a3, loop );
+    check( sent.size() == 1 and sent.back().size() == 2, "doesn't fit" );
+    wait_for( 2 );
+    check( sent.size() == 2 and sent.back().size() == 1, "doesn't fit, next batch" );
+    max_fitting_bytes = 0;
+    sent.clear();
+
+    /* a removed thunk isn't sent, and its inputs no longer count */
+    batcher.set_limits( { 10, 1030, 20ms } );
+    batcher.add( a1, loop );
+    batcher.add( a2, loop );
+    check( batcher.remove( a2.hash() ) == 1 and batcher.remove( a2.hash() ) == 0,
+           "remove" );
+    batcher.add( a3, loop );
+    check( sent.empty(), "remove, bytes" );
+    wait_for( 1 );
+    check( sent.size() == 1 and sent.back().size() == 2 and
+           sent.back().back().hash() == a3.hash(), "remove, sent" );
+    sent.clear();
+
+    batcher.add( a1, loop );
+    check( batcher.remove( a1.hash() ) == 1, "remove, last thunk" );
+    wait_for( 1 );
+    check( sent.empty(), "remove, nothing sent" );
+  } );
+}
@@ -0,0 +1,90 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "thunk/blob_gc.hh"
+#include "thunk/ggutils.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+
+/* a blob last used `age` seconds ago */
+void make_blob( const string & name, const time_t age )
+{
+  roost::atomic_create( string( 8192, 'x' ), gg::paths::blob( name ) );
+
+  const timespec times[ 2 ] = { { time( nullptr ) - age, 0 }, { 0, UTIME_OMIT } };
+  CheckSystemCall( "utimensat", utimensat( AT_FDCWD, gg::paths::blob( name ).string().c_str(),
+                                           times, 0 ) );
+}
+
+uint64_t blob_size( const string & name )
+{
+  struct stat blob_stat;
+  CheckSystemCall( "stat", stat( gg::paths::blob( name ).string().c_str(), &blob_stat ) );
+  return blob_stat.st_blocks * 512;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "blob-gc-test" };
+
+    /* b0 is the oldest, b9 the newest */
+    const int blob_count = 10;
+
+    for ( int i = 0; i < blob_count; i++ ) {
+      make_blob( "b" + to_string( i ), 3600 * ( blob_count - i ) );
+    }
+
+    const uint64_t size = blob_size( "b0" );
+
+    /* using b0 makes it the newest; b1 is pinned, and kept even though it's old */
+    blobs::touch( "b0" );
+
+    const uint64_t removed = blobs::collect( 4 * size, { "b1" } );
+    check( removed == 6 * size, "bytes removed" );
+
+    for ( int i = 0; i < blob_count; i++ ) {
+      const bool kept = roost::exists( gg::paths::blob( "b" + to_string( i ) ) );
+      check( kept == ( i == 0 or i == 1 or i >= 8 ), "least recently used removed" );
+    }
+
+    /* nothing is removed while under the budget, or within the grace period */
+    check( blobs::collect( 4 * size ) == 0, "under budget" );
+    check( blobs::collect( 0, {}, chrono::seconds { 3 * 3600 } ) == size, "grace period" );
+    check( roost::exists( gg::paths::blob( "b0" ) ), "just used" );
+    check( roost::exists( gg::paths::blob( "b8" ) ), "used in the grace period" );
+    check( not roost::exists( gg::paths::blob( "b1" ) ), "no longer pinned" );
+
+    /* the budget */
+    unsetenv( "GG_BLOB_BUDGET" );
+    check( not blobs::budget().initialized(), "no budget" );
+
+    setenv( "GG_BLOB_BUDGET", "1000", true );
+    check( blobs::budget().get_or( 0 ) == 1000, "budget in bytes" );
+
+    setenv( "GG_BLOB_BUDGET", "2M", true );
+    check( blobs::budget().get_or( 0 ) == 2 * 1024 * 1024, "budget with a suffix" );
+
+    bool threw = false;
+
+    try {
+      setenv( "GG_BLOB_BUDGET", "lots", true );
+      blobs::budget();
+    }
+    catch ( const runtime_error & ) {
+      threw = true;
+    }
+
+    check( threw, "invalid budget" );
+  } );
+}
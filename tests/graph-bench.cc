@@ -0,0 +1,186 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Loads and reduces a synthetic layered DAG through ExecutionGraph, without
+   executing anything: every thunk in layer k depends on two neighboring thunks
+   in layer k - 1, and a ready thunk is "executed" by handing the graph a
+   made-up value as its output. With SNAPSHOT set to 1, the graph is written
+   to a snapshot first, and loaded from there. With MEMORY-LIMIT (in MiB), the
+   waiting thunks over the limit are spilled to disk. */
+
+#include <cstdlib>
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include <sys/resource.h>
+
+#include "thunk/graph.hh"
+#include "thunk/hash.hh"
+#include "thunk/ggutils.hh"
+#include "thunk/snapshot.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/exception.hh"
+#include "util/path.hh"
+#include "util/temp_dir.hh"
+#include "util/timeit.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+void usage( const char * argv0 )
+{
+  cerr << "Usage: " << argv0 << " [LAYERS [WIDTH [LOADER-THREADS [SNAPSHOT [MEMORY-LIMIT]]]]]" << endl;
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 6 ) {
+      usage( argv[ 0 ] );
+      return EXIT_FAILURE;
+    }
+
+    const size_t layers = ( argc > 1 ) ? stoul( argv[ 1 ] ) : 1000;
+    const size_t width = ( argc > 2 ) ? stoul( argv[ 2 ] ) : 1000;
+    const size_t loader_threads = ( argc > 3 ) ? stoul( argv[ 3 ] ) : 1;
+    const bool use_snapshot = ( argc > 4 ) and stoul( argv[ 4 ] ) != 0;
+    const size_t memory_limit = ( argc > 5 ) ? stoul( argv[ 5 ] ) * 1024 * 1024 : 0;
+
+    if ( layers == 0 or width == 0 ) {
+      usage( argv[ 0 ] );
+      return EXIT_FAILURE;
+    }
+
+    UniqueDirectory gg_dir { "/tmp/gg-graph-bench" };
+    setenv( "GG_DIR", gg_dir.name().c_str(), true );
+
+    const string function_hash = gg::hash::compute( "graph-bench", ObjectType::Value );
+
+    vector<string> previous_layer;
+    vector<string> current_layer;
+
+    auto write_time = time_it<milliseconds>(
+      [&] ()
+      {
+        for ( size_t k = 0; k < layers; k++ ) {
+          for ( size_t j = 0; j < width; j++ ) {
+            vector<Thunk::DataItem> thunks;
+
+            if ( k > 0 ) {
+              thunks.emplace_back( previous_layer[ j ], "" );
+              thunks.emplace_back( previous_layer[ ( j + 1 ) % width ], "" );
+            }
+
+            const Thunk thunk {
+              { function_hash, { "node", to_string( k ), to_string( j ) }, {} },
+              {},
+              move( thunks ),
+              { { function_hash, "" } },
+              { { "out" } }
+            };
+
+            current_layer.emplace_back( ThunkWriter::write( thunk ) );
+          }
+
+          previous_layer.swap( current_layer );
+          current_layer.clear();
+        }
+      } );
+
+    ExecutionGraph graph;
+    graph.set_memory_limit( memory_limit, gg_dir.name() );
+    deque<Hash> ready;
+    const vector<Hash> targets( previous_layer.begin(), previous_layer.end() );
+    const string snapshot_path = gg_dir.name() + "/graph.snapshot";
+
+    auto snapshot_time = time_it<milliseconds>(
+      [&] ()
+      {
+        if ( use_snapshot ) {
+          GraphSnapshot::write( snapshot_path, targets );
+        }
+      } );
+
+    auto load_time = time_it<milliseconds>(
+      [&] ()
+      {
+        if ( use_snapshot ) {
+          graph.set_snapshot( make_shared<const GraphSnapshot>( snapshot_path ) );
+        }
+
+        graph.add_thunks( targets, loader_threads );
+
+        for ( const Hash & hash : graph.take_ready_thunks() ) {
+          ready.push_back( hash );
+        }
+      } );
+
+    const size_t loaded = graph.size();
+    const size_t spilled = graph.spilled_count();
+
+    struct rusage usage;
+    CheckSystemCall( "getrusage", getrusage( RUSAGE_SELF, &usage ) );
+    const size_t loaded_rss = usage.ru_maxrss;
+    size_t reduced = 0;
+
+    auto reduce_time = time_it<milliseconds>(
+      [&] ()
+      {
+        while ( not ready.empty() ) {
+          const Hash hash { ready.front() };
+          ready.pop_front();
+
+          vector<ThunkOutput> outputs;
+          outputs.emplace_back( gg::hash::compute( hash.str(), ObjectType::Value ), "out" );
+
+          Optional<unordered_set<Hash>> next = graph.force_thunk( hash, move( outputs ) );
+
+          if ( not next.initialized() ) {
+            throw runtime_error( "graph lost track of a ready thunk" );
+          }
+
+          ready.insert( ready.end(), next->begin(), next->end() );
+          reduced++;
+        }
+      } );
+
+    if ( reduced != layers * width or graph.size() != 0 ) {
+      throw runtime_error( "graph was not fully reduced: " + to_string( reduced )
+                           + " forced, " + to_string( graph.size() ) + " left" );
+    }
+
+    cout << "nodes:  " << loaded << endl
+         << "write:  " << write_time.count() << " ms" << endl;
+
+    if ( use_snapshot ) {
+      cout << "snap:   " << snapshot_time.count() << " ms (written from the blobs)" << endl;
+    }
+
+    cout << "load:   " << load_time.count() << " ms (" << loader_threads
+         << " thread" << ( ( loader_threads == 1 ) ? "" : "s" ) << ")" << endl
+         << "reduce: " << reduce_time.count() << " ms ("
+         << ( reduce_time.count() * 1000.0 / reduced ) << " us/node)" << endl
+         << "rss:    " << ( loaded_rss / 1024 ) << " MiB (peak, after loading)" << endl;
+
+    if ( memory_limit > 0 ) {
+      cout << "spill:  " << spilled << " nodes (" << ( memory_limit / 1024 / 1024 )
+           << " MiB limit)" << endl;
+    }
+
+    roost::remove_directory( gg_dir.name() );
+  }
+  catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
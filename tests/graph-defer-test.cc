@@ -0,0 +1,88 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/graph.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+vector<ThunkOutput> value_output( const string & name )
+{
+  return { { gg::hash::compute( name, ObjectType::Value ), "out" } };
+}
+
+/* `top` waits on `first`, which returns `second`, which waits on `leaf`.
+   returns the thunk that `top` turns into once it's ready */
+string reduce( const bool deferred, const string & top, const string & first,
+               const string & second, const string & leaf )
+{
+  ExecutionGraph graph;
+  graph.set_deferred_loading( deferred );
+
+  graph.add_thunk( Hash { top } );
+  check( graph.take_ready_thunks() == unordered_set<Hash> { Hash { first } }, "first ready" );
+
+  Optional<unordered_set<Hash>> next =
+    graph.force_thunk( Hash { first }, { { second, "out" } } );
+
+  if ( deferred ) {
+    /* nothing is read until the caller asks for it, one level at a time */
+    check( next.initialized() and next->empty() and graph.is_reading( Hash { second } ),
+           "returned thunk deferred" );
+    check( graph.take_thunks_to_read() == vector<Hash> { Hash { second } }, "read second" );
+
+    graph.add_loaded_thunk( Hash { second }, graph.read_thunk( Hash { second } ) );
+    check( graph.take_ready_thunks().empty(), "second waits" );
+    check( graph.take_thunks_to_read() == vector<Hash> { Hash { leaf } }, "read leaf" );
+
+    /* the leaf has nothing else to read */
+    graph.add_loaded_thunk( Hash { leaf }, graph.read_thunk( Hash { leaf } ) );
+    check( graph.take_thunks_to_read().empty(), "nothing left to read" );
+    next.reset( graph.take_ready_thunks() );
+  }
+
+  check( next.initialized() and *next == unordered_set<Hash> { Hash { leaf } }, "leaf ready" );
+
+  next = graph.force_thunk( Hash { leaf }, value_output( "leaf" ) );
+  check( next.initialized() and next->size() == 1, "second ready" );
+
+  const Hash updated_second = *next->begin();
+  next = graph.force_thunk( updated_second, value_output( "second" ) );
+  check( next.initialized() and next->size() == 1, "top ready" );
+
+  return ThunkWriter::serialize( graph.get_thunk( *next->begin() ) );
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "graph-defer-test" };
+
+    const string function_hash = gg::hash::compute( "graph-defer-test", ObjectType::Value );
+
+    auto write_thunk =
+      [&function_hash] ( const string & name, vector<Thunk::DataItem> && thunks )
+      {
+        return ThunkWriter::write( { { function_hash, { name }, {} }, {}, move( thunks ),
+                                     { { function_hash, "" } }, { "out" } } );
+      };
+
+    const string leaf = write_thunk( "leaf", {} );
+    const string second = write_thunk( "second", { { leaf, "" } } );
+    const string first = write_thunk( "first", {} );
+    const string top = write_thunk( "top", { { first, "" } } );
+
+    check( reduce( true, top, first, second, leaf ) == reduce( false, top, first, second, leaf ),
+           "same reduction" );
+  } );
+}
@@ -0,0 +1,97 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/graph.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "graph-merge-test" };
+
+    const string function_hash = gg::hash::compute( "graph-merge-test", ObjectType::Value );
+    const string output_hash = gg::hash::compute( "output", ObjectType::Value );
+
+    auto write_thunk =
+      [&function_hash] ( const string & name, vector<Thunk::DataItem> && thunks )
+      {
+        return ThunkWriter::write( { { function_hash, { name }, {} }, {}, move( thunks ),
+                                     { { function_hash, "" } }, { "out" } } );
+      };
+
+    /* two different leaves with the same output, so the thunks above them
+       end up the same once the leaves are done */
+    const string first_leaf = write_thunk( "first", {} );
+    const string second_leaf = write_thunk( "second", {} );
+    const string first_top = write_thunk( "top", { { first_leaf, "" } } );
+    const string second_top = write_thunk( "top", { { second_leaf, "" } } );
+
+    ExecutionGraph graph;
+    graph.add_thunk( Hash { first_top } );
+    graph.add_thunk( Hash { second_top } );
+    check( graph.size() == 4 and graph.take_ready_thunks().size() == 2, "graph size" );
+
+    Optional<unordered_set<Hash>> next =
+      graph.force_thunk( Hash { first_leaf }, { { output_hash, "out" } } );
+    check( next.initialized() and next->size() == 1, "first top released" );
+    const Hash top = *next->begin();
+
+    next = graph.force_thunk( Hash { second_leaf }, { { output_hash, "out" } } );
+    check( next.initialized() and next->empty(), "second top not released again" );
+    check( graph.size() == 1 and graph.has_thunk( top ), "one top left" );
+
+    const vector<pair<Hash, Hash>> merged = graph.take_merged_originals();
+    check( merged.size() == 1 and merged[ 0 ].first == Hash { first_top }
+           and merged[ 0 ].second == Hash { second_top }, "merged originals" );
+    check( graph.original_hash( top ) == Hash { second_top }, "original hash" );
+    check( graph.updated_hash( Hash { first_top } ) == top
+           and graph.updated_hash( Hash { second_top } ) == top, "updated hashes" );
+    check( graph.take_merged_originals().empty(), "merged originals taken" );
+
+    next = graph.force_thunk( top, { { output_hash, "out" } } );
+    check( next.initialized() and next->empty() and graph.size() == 0, "graph reduced" );
+
+    /* once the targets are answered, the graph doesn't keep their hashes */
+    graph.forget_original( Hash { first_top } );
+    graph.forget_original( Hash { second_top } );
+    check( graph.updated_hash( Hash { first_top } ) == Hash { first_top }
+           and graph.updated_hash( Hash { second_top } ) == Hash { second_top }
+           and graph.original_hash( top ) == top, "originals forgotten" );
+
+    /* a failed leaf takes the thunk above it out of the graph, but not its
+       other leaf, which can still finish */
+    {
+      const string failed_leaf = write_thunk( "failed", {} );
+      const string other_leaf = write_thunk( "other", {} );
+      const string failed_top = write_thunk( "failed-top", { { failed_leaf, "" },
+                                                             { other_leaf, "" } } );
+
+      ExecutionGraph failing_graph;
+      failing_graph.add_thunk( Hash { failed_top } );
+      check( failing_graph.take_executable_dependencies().size() == 1
+             and failing_graph.take_executable_dependencies().empty(),
+             "dependencies taken once" );
+
+      failing_graph.remove_thunks( { Hash { failed_leaf }, Hash { failed_top } } );
+      check( failing_graph.size() == 1 and failing_graph.has_thunk( Hash { other_leaf } )
+             and failing_graph.referencing_thunks( Hash { other_leaf } ).empty(),
+             "failed subgraph removed" );
+
+      next = failing_graph.force_thunk( Hash { other_leaf }, { { output_hash, "out" } } );
+      check( next.initialized() and next->empty() and failing_graph.size() == 0,
+             "other leaf reduced" );
+    }
+  } );
+}
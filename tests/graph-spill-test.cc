@@ -0,0 +1,90 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <deque>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/graph.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+/* forces the whole graph, giving every thunk a made-up output, and returns
+   the hashes of the thunks in the order they were forced */
+vector<string> reduce( const string & target, const size_t memory_limit,
+                       const string & spill_directory )
+{
+  ExecutionGraph graph;
+  graph.set_memory_limit( memory_limit, spill_directory );
+  graph.add_thunk( Hash { target } );
+
+  check( graph.size() == 4, "graph size" );
+  check( ( memory_limit > 0 ) == ( graph.spilled_count() > 0 ), "spilled thunks" );
+
+  /* the spilled thunks can still be looked at */
+  const Thunk & top = graph.get_thunk( Hash { target } );
+  check( top.thunks().size() == 2, "spilled thunk contents" );
+
+  const unordered_set<Hash> ready_set = graph.take_ready_thunks();
+  deque<Hash> ready { ready_set.begin(), ready_set.end() };
+  vector<string> forced;
+
+  while ( not ready.empty() ) {
+    const Hash hash = ready.front();
+    ready.pop_front();
+
+    const Thunk & thunk = graph.get_thunk( hash );
+    forced.push_back( ThunkWriter::serialize( thunk ) );
+
+    vector<ThunkOutput> outputs;
+    for ( const string & tag : thunk.outputs() ) {
+      outputs.emplace_back( gg::hash::compute( hash.str() + tag, ObjectType::Value ), tag );
+    }
+
+    Optional<unordered_set<Hash>> next = graph.force_thunk( hash, move( outputs ) );
+    check( next.initialized(), "forced thunk" );
+    ready.insert( ready.end(), next->begin(), next->end() );
+  }
+
+  check( graph.size() == 0 and graph.spilled_count() == 0, "graph reduced" );
+  return forced;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "graph-spill-test" };
+
+    const string function_hash = gg::hash::compute( "graph-spill-test", ObjectType::Value );
+
+    auto write_thunk =
+      [&function_hash] ( const string & name, vector<Thunk::DataItem> && thunks )
+      {
+        return ThunkWriter::write( { { function_hash, { name }, {} }, {}, move( thunks ),
+                                     { { function_hash, "" } }, { "out1", "out2" } } );
+      };
+
+    /* a diamond, where one of the thunks uses both outputs of the leaf */
+    const string leaf = write_thunk( "leaf", {} );
+    const string left = write_thunk( "left", { { gg::hash::for_output( leaf, "out1" ), "" },
+                                               { gg::hash::for_output( leaf, "out2" ), "" } } );
+    const string right = write_thunk( "right", { { leaf, "" } } );
+    const string top = write_thunk( "top", { { left, "" }, { gg::hash::for_output( right, "out2" ), "" } } );
+
+    /* with a one-byte limit, every thunk that has to wait is spilled, and the
+       graph has to come out the same */
+    const vector<string> expected = reduce( top, 0, gg_dir.name() );
+    const vector<string> spilled = reduce( top, 1, gg_dir.name() );
+
+    check( expected.size() == 4, "all thunks forced" );
+    check( spilled == expected, "same reduction" );
+  } );
+}
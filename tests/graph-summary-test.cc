@@ -0,0 +1,85 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/graph_summary.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+vector<pair<uint32_t, uint64_t>>
+degrees( const google::protobuf::RepeatedPtrField<protobuf::GraphSummary::DegreeCount> & counts )
+{
+  vector<pair<uint32_t, uint64_t>> result;
+
+  for ( const auto & count : counts ) {
+    result.emplace_back( count.degree(), count.thunks() );
+  }
+
+  return result;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "graph-summary-test" };
+
+    const string function_hash = gg::hash::compute( "graph-summary-test", ObjectType::Value );
+    const string big_input = gg::hash::compute( string( 1000, 'b' ), ObjectType::Value );
+    const string small_input = gg::hash::compute( string( 10, 's' ), ObjectType::Value );
+
+    auto write_thunk =
+      [&function_hash] ( const string & name, vector<Thunk::DataItem> && values,
+                         vector<Thunk::DataItem> && thunks )
+      {
+        return ThunkWriter::write( { { function_hash, { name }, {} }, move( values ), move( thunks ),
+                                     { { function_hash, "" } }, { "out1", "out2" } } );
+      };
+
+    /* a diamond, where one side uses both outputs of the leaf, under a
+       chain that's one thunk longer than the diamond */
+    const string leaf = write_thunk( "leaf", { { big_input, "" } }, {} );
+    const string left = write_thunk( "left", { { small_input, "" } },
+                                     { { gg::hash::for_output( leaf, "out1" ), "" },
+                                       { gg::hash::for_output( leaf, "out2" ), "" } } );
+    const string right = write_thunk( "right", { { big_input, "" } }, { { leaf, "" } } );
+    const string top = write_thunk( "top", {}, { { left, "" }, { right, "" } } );
+    const string above = write_thunk( "above", {}, { { top, "" } } );
+
+    const protobuf::GraphSummary summary = summarize_graph( { Hash { top }, Hash { above } }, 2 );
+
+    check( summary.thunks() == 5 and summary.edges() == 5, "counts" );
+    check( summary.critical_path_length() == 4, "critical path length" );
+    check( vector<string>( summary.critical_path().begin(), summary.critical_path().end() )
+           == vector<string> { above, top, left, leaf }
+           or vector<string>( summary.critical_path().begin(), summary.critical_path().end() )
+           == vector<string> { above, top, right, leaf }, "critical path" );
+    check( vector<uint64_t>( summary.width_per_level().begin(), summary.width_per_level().end() )
+           == vector<uint64_t> { 1, 2, 1, 1 }, "width per level" );
+
+    const uint64_t function_size = gg::hash::size( function_hash );
+    check( summary.total_input_bytes() == 2000 + 10 + 5 * function_size, "total input bytes" );
+    check( summary.unique_input_bytes() == 1000 + 10 + function_size
+           and summary.unique_inputs() == 3, "unique input bytes" );
+
+    check( degrees( summary.fan_in() ) == vector<pair<uint32_t, uint64_t>> { { 0, 1 }, { 1, 3 }, { 2, 1 } },
+           "fan-in" );
+    check( degrees( summary.fan_out() ) == vector<pair<uint32_t, uint64_t>> { { 0, 1 }, { 1, 3 }, { 2, 1 } },
+           "fan-out" );
+
+    check( summary.targets_size() == 2 and summary.targets( 0 ).hash() == top
+           and summary.targets( 0 ).depth() == 3 and summary.targets( 0 ).thunks() == 4
+           and summary.targets( 0 ).unique_input_bytes() == 1000 + 10 + function_size,
+           "target" );
+    check( summary.targets( 1 ).depth() == 4 and summary.targets( 1 ).thunks() == 5, "second target" );
+  } );
+}
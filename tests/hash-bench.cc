@@ -0,0 +1,155 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Hashes files of the given sizes (default: 0 B, 64 B, 4 KiB, 64 KiB,
+   1 MiB, 64 MiB and 512 MiB), both the way gg::hash::file_force() used to, reading the whole
+   file into memory first, and the way it does now, one buffer at a time.
+   Reports the time per file, the throughput and how many bytes each hash
+   allocates. The files are hashed from the page cache. */
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "util/digest.hh"
+#include "util/exception.hh"
+#include "util/path.hh"
+#include "util/temp_dir.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+
+static constexpr size_t MAX_REPEATS = 100'000;
+
+static atomic<size_t> allocated_bytes { 0 };
+
+void * operator new( size_t size )
+{
+  allocated_bytes += size;
+
+  if ( void * ptr = malloc( size ) ) {
+    return ptr;
+  }
+
+  throw bad_alloc();
+}
+
+void operator delete( void * ptr ) noexcept
+{
+  free( ptr );
+}
+
+void operator delete( void * ptr, size_t ) noexcept
+{
+  free( ptr );
+}
+
+void usage( const char * argv0 )
+{
+  cerr << "Usage: " << argv0 << " [SIZE-IN-BYTES...]" << endl;
+}
+
+template<class Callable>
+string measure( const string & name, const size_t size, const size_t repeats,
+                Callable && callable )
+{
+  string hash;
+  const size_t allocated_before = allocated_bytes;
+  const auto start = steady_clock::now();
+
+  for ( size_t r = 0; r < repeats; r++ ) {
+    hash = callable();
+  }
+
+  const double elapsed = duration_cast<nanoseconds>( steady_clock::now() - start ).count();
+
+  cout << setw( 8 ) << name << fixed << setprecision( 2 )
+       << setw( 14 ) << ( elapsed / 1000.0 / repeats )
+       << setw( 14 ) << ( size * repeats * 1000.0 / elapsed )
+       << setw( 16 ) << ( ( allocated_bytes - allocated_before ) / repeats ) << endl;
+
+  return hash;
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    vector<size_t> sizes;
+
+    for ( int i = 1; i < argc; i++ ) {
+      sizes.push_back( stoull( argv[ i ] ) );
+    }
+
+    if ( sizes.empty() ) {
+      sizes = { 0, 64, 4 * 1024, 64 * 1024, 1024 * 1024,
+                64 * 1024 * 1024, 512 * 1024 * 1024 };
+    }
+
+    UniqueDirectory work_dir { "/tmp/gg-hash-bench" };
+
+    cout << "SHA-256 implementation: " << digest::sha256_implementation() << endl;
+
+    for ( const size_t size : sizes ) {
+      const roost::path path = roost::path( work_dir.name() ) / to_string( size );
+
+      {
+        string contents( size, '\0' );
+        uint64_t state = 88172645463325252ULL;
+
+        for ( char & c : contents ) {
+          state ^= state << 13;
+          state ^= state >> 7;
+          state ^= state << 17;
+          c = static_cast<char>( state );
+        }
+
+        roost::atomic_create( contents, path );
+      }
+
+      /* as many times as it takes to go through at least 1 GiB, but no more
+         than 100,000 times, for the small files to finish */
+      const size_t repeats = min<size_t>( MAX_REPEATS,
+        max<size_t>( 3, ( 1ULL << 30 ) / max<size_t>( size, 1 ) ) );
+
+      cout << endl << "file: " << size << " bytes, " << repeats << " times" << endl
+           << "          time(us)        MB/s  allocated(B)" << endl;
+
+      const string whole_hash = measure( "whole", size, repeats,
+        [&path] ()
+        {
+          return gg::hash::compute( roost::read_file( path ), ObjectType::Value );
+        } );
+
+      const string streamed_hash = measure( "stream", size, repeats,
+        [&path] ()
+        {
+          return gg::hash::file_force( path, ObjectType::Value );
+        } );
+
+      if ( whole_hash != streamed_hash ) {
+        throw runtime_error( "different hashes for " + path.string() );
+      }
+
+      roost::remove( path );
+    }
+
+    roost::remove_directory( work_dir.name() );
+  }
+  catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    usage( argv[ 0 ] );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
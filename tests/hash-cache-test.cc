@@ -0,0 +1,118 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "thunk/hash.hh"
+#include "thunk/hash_cache.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::hash;
+
+struct stat make_stat( const size_t inode, const time_t mtime )
+{
+  struct stat file_stat;
+  memset( &file_stat, 0, sizeof( file_stat ) );
+  file_stat.st_dev = 1;
+  file_stat.st_ino = inode;
+  file_stat.st_size = 100;
+  file_stat.st_mtim.tv_sec = mtime;
+  return file_stat;
+}
+
+string make_hash( const size_t i )
+{
+  array<uint8_t, Hash::DIGEST_LENGTH> digest {};
+  memcpy( digest.data(), &i, sizeof( i ) );
+  return Hash( ObjectType::Value, digest, 100 ).str();
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const TestDirectory cache_dir { "hash-cache-test" };
+    const roost::path cache_path = roost::path( cache_dir.name() ) / "hash_cache.db";
+
+    {
+      HashCache cache { cache_path };
+
+      check( not cache.get( "a.c", make_stat( 1, 0 ) ).initialized(), "empty cache" );
+
+      cache.put( "a.c", make_stat( 1, 0 ), make_hash( 1 ) );
+      check( cache.get( "a.c", make_stat( 1, 0 ) ).get_or( "" ) == make_hash( 1 ), "hit" );
+      check( not cache.get( "b.c", make_stat( 1, 0 ) ).initialized(), "other name" );
+      check( not cache.get( "a.c", make_stat( 1, 1 ) ).initialized(), "modified file" );
+
+      cache.put( "a.c", make_stat( 1, 1 ), make_hash( 2 ) );
+      check( cache.get( "a.c", make_stat( 1, 1 ) ).get_or( "" ) == make_hash( 2 ), "updated" );
+    }
+
+    /* several processes with several threads each, updating every entry a
+       few times, which makes the file get compacted along the way */
+    const size_t file_count = 20000;
+    const time_t rounds = 3;
+    vector<pid_t> children;
+
+    for ( size_t process = 0; process < 4; process++ ) {
+      const pid_t pid = CheckSystemCall( "fork", fork() );
+
+      if ( pid == 0 ) {
+        HashCache cache { cache_path };
+        vector<thread> threads;
+
+        for ( size_t t = 0; t < 4; t++ ) {
+          threads.emplace_back(
+            [&cache, file_count, rounds] ()
+            {
+              for ( time_t round = 0; round < rounds; round++ ) {
+                for ( size_t i = 0; i < file_count; i++ ) {
+                  const string name = "file" + to_string( i );
+                  const Optional<string> hash = cache.get( name, make_stat( i, round ) );
+
+                  if ( hash.initialized() and *hash != make_hash( i ) ) {
+                    _exit( EXIT_FAILURE );
+                  }
+
+                  if ( not hash.initialized() ) {
+                    cache.put( name, make_stat( i, round ), make_hash( i ) );
+                  }
+                }
+              }
+            } );
+        }
+
+        for ( auto & thread : threads ) {
+          thread.join();
+        }
+
+        _exit( EXIT_SUCCESS );
+      }
+
+      children.push_back( pid );
+    }
+
+    for ( const pid_t pid : children ) {
+      int status;
+      CheckSystemCall( "waitpid", waitpid( pid, &status, 0 ) );
+      check( WIFEXITED( status ) and WEXITSTATUS( status ) == EXIT_SUCCESS, "concurrent use" );
+    }
+
+    HashCache cache { cache_path };
+
+    for ( size_t i = 0; i < file_count; i++ ) {
+      const Optional<string> hash = cache.get( "file" + to_string( i ), make_stat( i, rounds - 1 ) );
+      check( hash.get_or( "" ) == make_hash( i ), "entries after compaction" );
+    }
+  } );
+}
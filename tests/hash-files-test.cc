@@ -0,0 +1,80 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "thunk/ggutils.hh"
+#include "util/file_descriptor.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "hash-files-test" };
+
+    const roost::path files_dir = roost::path( gg_dir.name() ) / "files";
+    roost::create_directories( files_dir );
+
+    vector<roost::path> paths;
+
+    for ( size_t i = 0; i < 100; i++ ) {
+      paths.push_back( files_dir / ( "file" + to_string( i ) ) );
+      roost::atomic_create( string( i * 37, 'a' + i % 26 ), paths.back() );
+    }
+
+    /* the same file, under another name and through a hard link */
+    paths.push_back( paths.front() );
+    CheckSystemCall( "link", link( paths.front().string().c_str(),
+                                   ( files_dir / "link" ).string().c_str() ) );
+    paths.push_back( files_dir / "link" );
+
+    const vector<string> forced = gg::hash::files_force( paths );
+    const vector<string> cold = gg::hash::files( paths );
+    const vector<string> warm = gg::hash::files( paths );
+
+    check( forced.size() == paths.size(), "one hash per path" );
+
+    for ( size_t i = 0; i < paths.size(); i++ ) {
+      check( forced[ i ] == gg::hash::file_force( paths[ i ] ), "same as file_force" );
+    }
+
+    check( cold == forced, "hashed through the cache" );
+    check( warm == forced, "read from the cache" );
+    check( forced.back() == forced.front(), "hard link" );
+
+    /* a missing file is an error, as it is for file() */
+    bool threw = false;
+
+    try {
+      gg::hash::files( { files_dir / "missing" } );
+    }
+    catch ( const unix_error & ) {
+      threw = true;
+    }
+
+    check( threw, "missing file" );
+
+    /* a file of 4 GiB or more, whose size takes more than 8 digits in its
+       hash; it's sparse, so it takes no space */
+    const roost::path large_path = files_dir / "large";
+    const uint64_t large_size = ( 1ULL << 32 ) + 1;
+
+    {
+      FileDescriptor large { CheckSystemCall( "open", open( large_path.string().c_str(),
+                                                            O_WRONLY | O_CREAT, 0600 ) ) };
+      CheckSystemCall( "ftruncate", ftruncate( large.fd_num(), large_size ) );
+    }
+
+    const string large_hash = gg::hash::file( large_path );
+    check( gg::hash::size( large_hash ) == large_size, "size of a large file" );
+    check( gg::hash::files( { large_path } ).front() == large_hash, "large file from the cache" );
+  } );
+}
@@ -0,0 +1,89 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+
+#include "thunk/ggutils.hh"
+#include "thunk/hash.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    mt19937 generator { 42 };
+    unordered_set<Hash> seen;
+
+    for ( size_t i = 0; i < 1000; i++ ) {
+      const string input( generator() % 4096, static_cast<char>( generator() ) );
+      const ObjectType type = ( i % 2 ) ? ObjectType::Thunk : ObjectType::Value;
+      const string text = gg::hash::compute( input + to_string( i ), type );
+
+      const Hash hash { text };
+      check( hash.str() == text, "round trip of " + text );
+      check( hash.hex() == gg::hash::to_hex( text ), "hex of " + text );
+      check( hash.size() == gg::hash::size( text ), "size of " + text );
+      check( hash.type() == type, "type of " + text );
+      check( not hash.has_tag(), "tag of " + text );
+
+      const string tagged_text = gg::hash::for_output( text, "out" + to_string( i % 3 ) );
+      const Hash tagged { tagged_text };
+      check( tagged.str() == tagged_text, "round trip of " + tagged_text );
+      check( tagged.tag() == "out" + to_string( i % 3 ), "tag of " + tagged_text );
+      check( tagged.base() == hash, "base of " + tagged_text );
+      check( tagged != hash, "tagged and untagged hashes are different" );
+      check( hash.with_tag( tagged.tag() ) == tagged, "with_tag of " + text );
+
+      check( seen.insert( hash ).second, "distinct hashes" );
+    }
+
+    check( seen.count( Hash( *seen.begin() ) ) == 1, "hashes as keys" );
+
+    const string valid = gg::hash::compute( "hash-roundtrip", ObjectType::Value );
+
+    for ( const string & invalid : { string {}, string { "VOBJ1" },
+                                     "X" + valid.substr( 1 ),
+                                     valid.substr( 0, valid.length() - 1 ) + "g",
+                                     valid + "x" } ) {
+      check( not Hash::is_valid( invalid ), "rejects " + invalid );
+    }
+
+    check( Hash::is_valid( valid + "#" ), "accepts an empty tag" );
+
+    /* objects of 4 GiB or more take more than 8 digits for their size */
+    const Hash small { valid };
+
+    for ( const uint64_t size : { 0xffffffffULL, 0x100000000ULL, 0x123456789abULL,
+                                  0xffffffffffffffffULL } ) {
+      const Hash large { ObjectType::Value, small.digest(), size };
+      const string text = large.str();
+
+      char size_text[ 17 ];
+      snprintf( size_text, sizeof( size_text ), "%08llx",
+                static_cast<unsigned long long>( size ) );
+
+      check( text == valid.substr( 0, 44 ) + size_text, "size digits of " + text );
+      check( Hash( text ) == large and Hash( text ).size() == size, "round trip of " + text );
+      check( gg::hash::size( text ) == size, "size of " + text );
+      check( gg::hash::to_hex( text ) == small.hex(), "hex of " + text );
+
+      const Hash tagged { text + "#out" };
+      check( tagged.size() == size and tagged.tag() == "out", "tag of " + text );
+    }
+
+    const string large_size = valid.substr( 0, 44 ) + "100000000";
+
+    for ( const string & invalid : { valid.substr( 0, 44 ) + "0100000000",
+                                     valid.substr( 0, 44 ) + "10000000000000000",
+                                     valid.substr( 0, 51 ),
+                                     large_size + "x" } ) {
+      check( not Hash::is_valid( invalid ), "rejects " + invalid );
+    }
+  } );
+}
@@ -0,0 +1,95 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <chrono>
+#include <string>
+#include <stdexcept>
+
+#include "execution/hedging.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+bool has_threshold( const HedgingPolicy & policy, const string & function,
+                    const milliseconds & expected )
+{
+  const Optional<milliseconds> threshold = policy.threshold( function );
+  return threshold.initialized() and *threshold == expected;
+}
+
+bool rejects( const double percentile, const double budget )
+{
+  try {
+    HedgingPolicy { percentile, budget };
+  }
+  catch ( const runtime_error & ) {
+    return true;
+  }
+
+  return false;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    check( rejects( 0, 0.1 ) and rejects( 101, 0.1 ) and rejects( 50, -1 )
+           and not rejects( 100, 0 ), "arguments" );
+
+    /* there's no threshold until enough jobs of a function have finished */
+    HedgingPolicy median { 50, 0.1 };
+
+    for ( int i = 1; i <= 7; i++ ) {
+      median.job_finished( "f", milliseconds { i } );
+    }
+
+    check( not median.threshold( "f" ).initialized(), "minimum samples" );
+
+    median.job_finished( "f", 8ms );
+    check( has_threshold( median, "f", 4ms ), "median" );
+    check( not median.threshold( "g" ).initialized(), "per function" );
+
+    HedgingPolicy highest { 100, 0.1 };
+
+    for ( int i = 0; i < 8; i++ ) {
+      highest.job_finished( "f", 0ms );
+    }
+
+    check( has_threshold( highest, "f", 1ms ), "at least 1 ms" );
+
+    /* only the most recent runtimes count */
+    for ( int i = 0; i < 256; i++ ) {
+      highest.job_finished( "f", 1000ms );
+    }
+
+    check( has_threshold( highest, "f", 1000ms ), "full window" );
+
+    for ( int i = 0; i < 255; i++ ) {
+      highest.job_finished( "f", 10ms );
+    }
+
+    check( has_threshold( highest, "f", 1000ms ), "window, one left" );
+
+    highest.job_finished( "f", 10ms );
+    check( has_threshold( highest, "f", 10ms ), "window, replaced" );
+
+    /* a duplicate for every ten jobs launched */
+    HedgingPolicy budget { 90, 0.1 };
+    check( not budget.try_duplicate(), "no jobs" );
+
+    for ( int i = 0; i < 10; i++ ) {
+      budget.job_launched();
+    }
+
+    check( budget.try_duplicate(), "first duplicate" );
+    check( not budget.try_duplicate(), "budget spent" );
+
+    for ( int i = 0; i < 10; i++ ) {
+      budget.job_launched();
+    }
+
+    check( budget.try_duplicate() and not budget.try_duplicate(), "second duplicate" );
+    check( budget.duplicated_jobs() == 2, "duplicated jobs" );
+  } );
+}
@@ -0,0 +1,43 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <string>
+#include <vector>
+
+#include "util/iterator.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+
+vector<int> joined( const vector<int> & first, const vector<int> & second )
+{
+  vector<int> result;
+
+  for ( const int i : join_containers( first, second ) ) {
+    result.push_back( i );
+  }
+
+  return result;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    check( joined( { 1 }, { 10, 20 } ) == vector<int> { 1, 10, 20 }, "both" );
+    check( joined( { 1, 2, 3 }, { 10 } ) == vector<int> { 1, 2, 3, 10 }, "one in the second" );
+    check( joined( {}, { 10, 20 } ) == vector<int> { 10, 20 }, "empty first" );
+    check( joined( { 1, 2 }, {} ) == vector<int> { 1, 2 }, "empty second" );
+    check( joined( {}, {} ).empty(), "both empty" );
+
+    /* the items can be changed through a join of mutable containers */
+    vector<int> first { 1, 2 };
+    vector<int> second { 3 };
+
+    for ( int & i : join_containers( first, second ) ) {
+      i *= 10;
+    }
+
+    check( first == vector<int> { 10, 20 } and second == vector<int> { 30 }, "mutable" );
+  } );
+}
@@ -0,0 +1,60 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <stdexcept>
+
+#include "thunk/thunk.hh"
+
+using namespace std;
+using namespace gg::thunk;
+
+string test_path( const string & hash )
+{
+  return "/blobs/" + hash;
+}
+
+void test_strings( const string & test_name,
+                   const vector<string> & actual,
+                   const vector<string> & expected )
+{
+  if ( actual != expected ) {
+    throw runtime_error( "placeholder test failed: " + test_name );
+  }
+}
+
+int main()
+{
+  Function function {
+    "FUNCTIONHASH",
+    { "cc", "@{GGHASH:VAAA}", "-I@{GGHASH:VBBB}/include",
+      "x@{GGHASH:TCCC#out}y@{GGHASH:VAAA}", "@{GGHASH:}", "@{GGHASH:VAAA#a/b}" },
+    { "PATH=@{GGHASH:VBBB}" }
+  };
+
+  test_strings( "substituted args", function.substituted_args( test_path ),
+                { "cc", "/blobs/VAAA", "-I/blobs/VBBB/include",
+                  "x/blobs/TCCCy/blobs/VAAA", "@{GGHASH:}", "@{GGHASH:VAAA#a/b}" } );
+
+  test_strings( "substituted envars", function.substituted_envars( test_path ),
+                { "PATH=/blobs/VBBB" } );
+
+  function.replace_placeholders( "TCCC#out", "VDDD" );
+  function.replace_placeholders( "VAAA", "VEEE" );
+
+  test_strings( "replaced args", function.args(),
+                { "cc", "@{GGHASH:VEEE}", "-I@{GGHASH:VBBB}/include",
+                  "x@{GGHASH:VDDD}y@{GGHASH:VEEE}", "@{GGHASH:}", "@{GGHASH:VAAA#a/b}" } );
+
+  /* a hash that was just put in can be replaced again */
+  function.replace_placeholders( "VDDD", "VFFF" );
+  function.add_envar( "MANIFEST=@{GGHASH:VBBB}" );
+  function.replace_placeholders( "VBBB", "VGGG" );
+
+  test_strings( "replaced envars", function.envars(),
+                { "PATH=@{GGHASH:VGGG}", "MANIFEST=@{GGHASH:VGGG}" } );
+
+  test_strings( "substituted replaced args", function.substituted_args( test_path ),
+                { "cc", "/blobs/VEEE", "-I/blobs/VGGG/include",
+                  "x/blobs/VFFFy/blobs/VEEE", "@{GGHASH:}", "@{GGHASH:VAAA#a/b}" } );
+
+  return 0;
+}
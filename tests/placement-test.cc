@@ -0,0 +1,112 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "execution/placement.hh"
+#include "thunk/ggutils.hh"
+#include "thunk/thunk.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+/* an engine that runs nothing, with as many jobs as it's told */
+class FakeEngine : public ExecutionEngine
+{
+private:
+  string label_;
+  bool can_execute_;
+
+public:
+  size_t running { 0 };
+
+  FakeEngine( const string & label, const size_t max_jobs,
+              const bool can_execute = true )
+    : ExecutionEngine( max_jobs ), label_( label ), can_execute_( can_execute )
+  {}
+
+  void force_thunk( const Thunk &, ExecutionLoop & ) override {}
+  size_t cancel( const string &, ExecutionLoop & ) override { return 0; }
+  bool is_remote() const override { return true; }
+  bool can_execute( const Thunk & ) const override { return can_execute_; }
+  size_t job_count() const override { return running; }
+  string label() const override { return label_; }
+};
+
+FakeEngine & add_engine( vector<unique_ptr<ExecutionEngine>> & engines,
+                         const string & label, const bool can_execute = true )
+{
+  engines.emplace_back( make_unique<FakeEngine>( label, 1, can_execute ) );
+  return static_cast<FakeEngine &>( *engines.back() );
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "placement-test" };
+
+    const string f = gg::hash::compute( "f", ObjectType::Value );
+    const Thunk thunk { { f, { "f" }, {} }, {}, {}, { { f, "" } }, { "out" } };
+
+    /* a slow engine, and a fast one once both have been timed */
+    {
+      EnginePlacement placement { PlacementPolicy::CompletionTime, nullptr };
+      vector<unique_ptr<ExecutionEngine>> engines;
+      FakeEngine & slow = add_engine( engines, "slow" );
+      FakeEngine & fast = add_engine( engines, "fast" );
+
+      placement.job_finished( slow, thunk, {}, 1000ms );
+      placement.job_finished( fast, thunk, {}, 10ms );
+
+      check( placement.place( thunk, engines ) == &fast, "fastest engine" );
+
+      /* the fast engine is full: the job goes to the slow one, rather than
+         waiting for a slot */
+      fast.running = 1;
+      check( placement.place( thunk, engines ) == &slow, "free engine" );
+
+      /* with every engine full, the job waits for the one that frees up
+         first, and isn't counted as placed yet */
+      slow.running = 1;
+      check( placement.place( thunk, engines ) == &fast, "all engines full" );
+      check( placement.placed_jobs( fast ) == 1 and placement.placed_jobs( slow ) == 1,
+             "placed jobs" );
+    }
+
+    /* the engines that can't execute the thunk are left out */
+    {
+      EnginePlacement placement { PlacementPolicy::CompletionTime, nullptr };
+      vector<unique_ptr<ExecutionEngine>> engines;
+      add_engine( engines, "unable", false );
+
+      check( placement.place( thunk, engines ) == nullptr, "no engine" );
+
+      FakeEngine & able = add_engine( engines, "able" );
+      able.running = 1;
+      check( placement.place( thunk, engines ) == &able, "only engine, full" );
+    }
+
+    /* the first engine with a free slot */
+    {
+      EnginePlacement placement { PlacementPolicy::FirstFit, nullptr };
+      vector<unique_ptr<ExecutionEngine>> engines;
+      FakeEngine & first = add_engine( engines, "first" );
+      FakeEngine & second = add_engine( engines, "second" );
+
+      check( placement.place( thunk, engines ) == &first, "first fit" );
+
+      first.running = 1;
+      check( placement.place( thunk, engines ) == &second, "first fit, full" );
+
+      second.running = 1;
+      check( placement.place( thunk, engines ) == &first, "first fit, all full" );
+    }
+  } );
+}
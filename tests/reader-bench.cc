@@ -0,0 +1,149 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Reads every thunk in the given directories, e.g. the blobs directory left
+   behind by a build, and reports how long it takes and how many heap
+   allocations it makes, per thunk: once from the files, as the graph and
+   gg-execute do, and once from serialized thunks that are already in
+   memory, as from a graph snapshot. */
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+
+#include "thunk/thunk.hh"
+#include "thunk/thunk_reader.hh"
+#include "util/exception.hh"
+#include "util/path.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+static atomic<size_t> allocations { 0 };
+
+void * operator new( size_t size )
+{
+  allocations++;
+
+  if ( void * ptr = malloc( size ) ) {
+    return ptr;
+  }
+
+  throw bad_alloc();
+}
+
+void operator delete( void * ptr ) noexcept
+{
+  free( ptr );
+}
+
+void operator delete( void * ptr, size_t ) noexcept
+{
+  free( ptr );
+}
+
+void usage( const char * argv0 )
+{
+  cerr << "Usage: " << argv0 << " DIRECTORY..." << endl;
+}
+
+template<class Callable>
+void measure( const string & name, const size_t count, const size_t bytes,
+              const size_t repeats, Callable && callable )
+{
+  const size_t allocations_before = allocations;
+  const auto start = steady_clock::now();
+
+  for ( size_t r = 0; r < repeats; r++ ) {
+    callable();
+  }
+
+  const double elapsed = duration_cast<nanoseconds>( steady_clock::now() - start ).count();
+  const size_t thunks = count * repeats;
+
+  cout << setw( 8 ) << name << fixed << setprecision( 2 )
+       << setw( 14 ) << ( elapsed / 1000.0 / thunks )
+       << setw( 14 ) << ( 1.0 * ( allocations - allocations_before ) / thunks )
+       << setw( 14 ) << ( bytes * repeats * 1000.0 / elapsed ) << endl;
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc < 2 ) {
+      usage( argv[ 0 ] );
+      return EXIT_FAILURE;
+    }
+
+    vector<string> paths;
+    vector<string> contents;
+    size_t bytes = 0;
+
+    for ( int i = 1; i < argc; i++ ) {
+      for ( const string & name : roost::list_directory( argv[ i ] ) ) {
+        const roost::path path = roost::path( argv[ i ] ) / name;
+
+        if ( roost::is_directory( path ) ) {
+          continue;
+        }
+
+        string data = roost::read_file( path );
+
+        if ( data.compare( 0, MAGIC_NUMBER.length(), MAGIC_NUMBER ) != 0 ) {
+          continue;
+        }
+
+        bytes += data.length();
+        paths.push_back( path.string() );
+        contents.emplace_back( move( data ) );
+      }
+    }
+
+    if ( paths.empty() ) {
+      throw runtime_error( "no thunks found" );
+    }
+
+    cout << "thunks: " << paths.size() << ", "
+         << ( bytes / paths.size() ) << " bytes on average" << endl
+         << "          time(us)  allocations        MB/s" << endl;
+
+    const size_t repeats = max<size_t>( 1, 200000 / paths.size() );
+    size_t sink = 0;
+
+    measure( "read", paths.size(), bytes, repeats,
+             [&] ()
+             {
+               for ( const string & path : paths ) {
+                 sink += ThunkReader::read( path ).outputs().size();
+               }
+             } );
+
+    measure( "parse", paths.size(), bytes, repeats,
+             [&] ()
+             {
+               for ( const string & data : contents ) {
+                 sink += ThunkReader::parse( data ).outputs().size();
+               }
+             } );
+
+    if ( sink == 0 ) {
+      throw runtime_error( "nothing was read" );
+    }
+  }
+  catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
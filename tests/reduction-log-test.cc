@@ -0,0 +1,121 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "thunk/hash.hh"
+#include "thunk/reduction_index.hh"
+#include "util/file_descriptor.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::cache;
+
+Hash make_hash( const ObjectType type, const int i )
+{
+  array<uint8_t, Hash::DIGEST_LENGTH> digest {};
+  memcpy( digest.data(), &i, sizeof( i ) );
+  return Hash( type, digest, 100 );
+}
+
+Hash thunk_hash( const int i ) { return make_hash( ObjectType::Thunk, i ); }
+Hash value_hash( const int i ) { return make_hash( ObjectType::Value, i ); }
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const TestDirectory reductions_dir { "reduction-log-test" };
+    const roost::path reductions { reductions_dir.name() };
+
+    /* entries in the old format, one file each */
+    const int legacy_count = 100;
+
+    for ( int i = 0; i < legacy_count; i++ ) {
+      roost::atomic_create( value_hash( -1 - i ).str(), reductions / thunk_hash( -1 - i ).str() );
+    }
+
+    /* several processes, some writing right away and some in batches, each
+       updating its own entries a few times, so the log gets compacted */
+    const int entry_count = 20000;
+    const int rounds = 3;
+    vector<pid_t> children;
+
+    for ( int process = 0; process < 4; process++ ) {
+      const pid_t pid = CheckSystemCall( "fork", fork() );
+
+      if ( pid == 0 ) {
+        ReductionIndex index { reductions };
+        index.set_batch_size( process % 2 ? 0 : 64 );
+
+        for ( int round = 0; round < rounds; round++ ) {
+          for ( int i = process; i < entry_count; i += 4 ) {
+            index.insert( thunk_hash( i ), value_hash( i + round ) );
+          }
+        }
+
+        index.flush();
+        _exit( EXIT_SUCCESS );
+      }
+
+      children.push_back( pid );
+    }
+
+    for ( const pid_t pid : children ) {
+      int status;
+      CheckSystemCall( "waitpid", waitpid( pid, &status, 0 ) );
+      check( WIFEXITED( status ) and WEXITSTATUS( status ) == EXIT_SUCCESS, "concurrent use" );
+    }
+
+    /* a writer that died in the middle of a line */
+    {
+      FileDescriptor log { CheckSystemCall( "open", open( ( reductions / "log" ).string().c_str(),
+                                                          O_WRONLY | O_APPEND ) ) };
+      log.write( thunk_hash( -1000 ).str() + " " + value_hash( -1000 ).str().substr( 0, 10 ) );
+    }
+
+    {
+      ReductionIndex index { reductions };
+
+      for ( int i = 0; i < entry_count; i++ ) {
+        check( index.check( thunk_hash( i ) ).get_or( {} ) == value_hash( i + rounds - 1 ),
+               "latest entry" );
+      }
+
+      for ( int i = 0; i < legacy_count; i++ ) {
+        check( index.check( thunk_hash( -1 - i ) ).get_or( {} ) == value_hash( -1 - i ),
+               "old entry" );
+      }
+
+      check( not index.check( thunk_hash( -1000 ) ).initialized(), "cut-short line" );
+
+      /* the first lookup moved the old entries into the log */
+      check( roost::list_directory( reductions ).size() < legacy_count, "old entries moved" );
+
+      index.insert( thunk_hash( -1001 ), value_hash( -1001 ) );
+    }
+
+    {
+      ReductionIndex index { reductions };
+      check( index.check( thunk_hash( -1001 ) ).get_or( {} ) == value_hash( -1001 ),
+             "after cut-short line" );
+
+      index.clear();
+      check( not index.check( thunk_hash( 0 ) ).initialized(), "cleared" );
+    }
+
+    {
+      ReductionIndex index { reductions };
+      check( not index.check( thunk_hash( 0 ) ).initialized(), "cleared on disk" );
+    }
+  } );
+}
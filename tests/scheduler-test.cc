@@ -0,0 +1,94 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "execution/scheduler.hh"
+#include "thunk/ggutils.hh"
+#include "thunk/graph.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+Thunk make_thunk( const string & function_hash, const string & name,
+                  vector<Thunk::DataItem> && thunks, const milliseconds & timeout )
+{
+  Thunk thunk { { function_hash, { name }, {} }, {}, move( thunks ),
+                { { function_hash, "" } }, { "out" } };
+  thunk.set_timeout( timeout );
+  return thunk;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "scheduler-test" };
+
+    const string f = gg::hash::compute( "f", ObjectType::Value );
+    const string g = gg::hash::compute( "g", ObjectType::Value );
+
+    /* a long chain of short thunks, and a single longer thunk, under one
+       target; the chain is the critical path */
+    {
+      const size_t chain_length = 2000;
+      vector<string> chain { ThunkWriter::write( make_thunk( f, "c0", {}, 0ms ) ) };
+
+      for ( size_t i = 1; i < chain_length; i++ ) {
+        chain.push_back( ThunkWriter::write(
+          make_thunk( f, "c" + to_string( i ), { { chain.back(), "" } }, 0ms ) ) );
+      }
+
+      const string single = ThunkWriter::write( make_thunk( f, "single", {}, 1s ) );
+      const string target = ThunkWriter::write(
+        make_thunk( f, "target", { { chain.back(), "" }, { single, "" } }, 0ms ) );
+
+      ExecutionGraph graph;
+      graph.add_thunk( Hash { target } );
+
+      auto scheduler = JobScheduler::create( SchedulingPolicy::CriticalPath, graph );
+      scheduler->push( Hash { single } );
+      scheduler->push( Hash { chain.front() } );
+
+      check( scheduler->pop() == Hash { chain.front() }, "longest path first" );
+      check( scheduler->pop() == Hash { single }, "shorter path next" );
+    }
+
+    /* two thunks whose order flips once their functions have been timed,
+       although they were queued before that */
+    {
+      const Thunk slow_looking = make_thunk( f, "slow-looking", {}, 100s );
+      const Thunk fast_looking = make_thunk( g, "fast-looking", {}, 1s );
+      const string slow_hash = ThunkWriter::write( slow_looking );
+      const string fast_hash = ThunkWriter::write( fast_looking );
+      const string target = ThunkWriter::write(
+        make_thunk( f, "target", { { slow_hash, "" }, { fast_hash, "" } }, 0ms ) );
+
+      for ( const bool measured : { false, true } ) {
+        ExecutionGraph graph;
+        graph.add_thunk( Hash { target } );
+
+        auto scheduler = JobScheduler::create( measured ? SchedulingPolicy::MeasuredCriticalPath
+                                                        : SchedulingPolicy::CriticalPath,
+                                               graph );
+        scheduler->push( Hash { fast_hash } );
+        scheduler->push( Hash { slow_hash } );
+
+        scheduler->job_finished( slow_looking, 10ms );
+        scheduler->job_finished( fast_looking, 500s );
+
+        const Hash first = scheduler->pop();
+        check( first == Hash { measured ? fast_hash : slow_hash },
+               measured ? "measured runtimes" : "timeouts" );
+      }
+    }
+  } );
+}
@@ -0,0 +1,100 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/graph.hh"
+#include "thunk/snapshot.hh"
+#include "thunk/thunk.hh"
+#include "thunk/thunk_writer.hh"
+#include "util/path.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace gg;
+using namespace gg::thunk;
+
+Thunk make_thunk( const string & name, vector<Thunk::DataItem> && thunks,
+                  const uint8_t version )
+{
+  const string function_hash = gg::hash::compute( "snapshot-test", ObjectType::Value );
+
+  Thunk thunk { { function_hash, { name }, {} }, {}, move( thunks ),
+                { { function_hash, "" } }, { "out1", "out2" } };
+
+  thunk.set_version( version );
+  return thunk;
+}
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "snapshot-test" };
+
+    /* a v1 leaf, a v2 thunk that uses both of its outputs, and one on top */
+    const Thunk leaf = make_thunk( "leaf", {}, 1 );
+    const string leaf_hash = ThunkWriter::write( leaf );
+
+    const Thunk middle = make_thunk( "middle", { { gg::hash::for_output( leaf_hash, "out1" ), "" },
+                                                 { gg::hash::for_output( leaf_hash, "out2" ), "" } }, 2 );
+    const string middle_hash = ThunkWriter::write( middle );
+
+    const Thunk top = make_thunk( "top", { { middle_hash, "" } }, 2 );
+    const string top_hash = ThunkWriter::write( top );
+
+    const string path = gg_dir.name() + "/graph.snapshot";
+    GraphSnapshot::write( path, { Hash { top_hash } } );
+
+    auto snapshot = make_shared<const GraphSnapshot>( path );
+
+    check( snapshot->size() == 3, "size" );
+    check( snapshot->has( Hash { leaf_hash } ) and snapshot->has( Hash { middle_hash } )
+           and snapshot->has( Hash { top_hash } ), "has" );
+    check( not snapshot->has( Hash { gg::hash::compute( "missing", ObjectType::Thunk ) } ),
+           "missing thunk" );
+
+    check( snapshot->dependencies( Hash { middle_hash } ) == vector<Hash> { Hash { leaf_hash } },
+           "two outputs are one edge" );
+    check( snapshot->dependencies( Hash { top_hash } ) == vector<Hash> { Hash { middle_hash } },
+           "dependencies" );
+    check( snapshot->dependencies( Hash { leaf_hash } ).empty(), "no dependencies" );
+
+    auto check_stored =
+      [&snapshot] ( const Thunk & thunk, const string & hash )
+      {
+        /* the output tag doesn't matter */
+        Optional<Thunk> stored = snapshot->thunk( Hash { gg::hash::for_output( hash, "out2" ) } );
+        check( stored.initialized() and *stored == thunk, "thunk contents" );
+        check( stored->hash() == hash and stored->version() == thunk.version(), "thunk hash" );
+      };
+
+    check_stored( leaf, leaf_hash );
+    check_stored( middle, middle_hash );
+
+    /* the graph takes what it can from the snapshot */
+    ExecutionGraph graph;
+    graph.set_snapshot( snapshot );
+    check( graph.add_thunk( Hash { top_hash } ) == Hash { top_hash }, "graph target" );
+    check( graph.size() == 3 and graph.get_thunk( Hash { leaf_hash } ) == leaf, "graph" );
+
+    /* a changed byte anywhere is caught */
+    string contents = roost::read_file( path );
+    contents[ contents.length() - 10 ] ^= 1;
+    roost::atomic_create( contents, path );
+
+    bool rejected = false;
+
+    try {
+      GraphSnapshot corrupted { path };
+    }
+    catch ( const runtime_error & ) {
+      rejected = true;
+    }
+
+    check( rejected, "corrupted snapshot" );
+  } );
+}
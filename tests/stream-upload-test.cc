@@ -0,0 +1,49 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "execution/engine_local.hh"
+#include "execution/reductor.hh"
+#include "storage/backend.hh"
+#include "util/child_process.hh"
+
+#include "test-util.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+/* a backend that never moves anything */
+class NullStorageBackend : public StorageBackend
+{
+public:
+  void put( const vector<storage::PutRequest> &, const PutCallback & ) override {}
+  void get( const vector<storage::GetRequest> &, const GetCallback & ) override {}
+};
+
+int main( int argc, char * argv[] )
+{
+  return run_test( argc, argv, [] ()
+  {
+    const GGTestDirectory gg_dir { "stream-upload-test" };
+
+    /* a mixed local engine next to a storage backend, with the dependencies
+       to be uploaded in the background */
+    vector<unique_ptr<ExecutionEngine>> engines;
+    engines.emplace_back( make_unique<LocalExecutionEngine>( true, 1 ) );
+
+    Reductor reductor { {}, move( engines ), {}, make_unique<NullStorageBackend>(),
+                        milliseconds { 0 }, 1, false, SchedulingPolicy::FIFO, 1,
+                        0, 0.1, PlacementPolicy::CompletionTime, true };
+
+    /* the local engine still has to be able to fork its jobs */
+    ChildProcess job { "job", [] () { return 0; } };
+
+    while ( not job.terminated() ) {
+      job.wait();
+    }
+
+    check( job.exit_status() == 0, "fork" );
+  } );
+}
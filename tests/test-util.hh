@@ -0,0 +1,74 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TEST_UTIL_HH
+#define TEST_UTIL_HH
+
+#include <cstdlib>
+#include <string>
+#include <stdexcept>
+#include <functional>
+
+#include "util/exception.hh"
+#include "util/path.hh"
+#include "util/temp_dir.hh"
+
+/* The scaffolding that the unit tests share. A test is a function that
+   throws on the first check that fails; run_test() turns that into the exit
+   status of the program, and prints what failed. */
+
+inline void check( const bool condition, const std::string & test_name )
+{
+  if ( not condition ) {
+    throw std::runtime_error( "test failed: " + test_name );
+  }
+}
+
+inline int run_test( const int argc, char * argv[], const std::function<void()> & test )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    test();
+  }
+  catch ( const std::exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* a directory of the test's own, under /tmp, which is removed with
+   everything in it once the test is done */
+class TestDirectory : public UniqueDirectory
+{
+public:
+  TestDirectory( const std::string & test_name )
+    : UniqueDirectory( "/tmp/gg-" + test_name )
+  {}
+
+  ~TestDirectory()
+  {
+    try {
+      roost::remove_directory( name() );
+    }
+    catch ( const std::exception & e ) {
+      print_exception( "test directory", e );
+    }
+  }
+};
+
+/* ... that is also the GG_DIR of the test */
+class GGTestDirectory : public TestDirectory
+{
+public:
+  GGTestDirectory( const std::string & test_name )
+    : TestDirectory( test_name )
+  {
+    setenv( "GG_DIR", name().c_str(), true );
+  }
+};
+
+#endif /* TEST_UTIL_HH */
@@ -0,0 +1,189 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Times the basic operations on thunks with a growing number of inputs: half
+   of them values and half of them thunks. update_data is timed by replacing
+   every thunk input with a value, one at a time, as the graph does when the
+   dependencies of a thunk are reduced. Like a link command, the function
+   references every input with a placeholder in its args. */
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+#include "thunk/ggutils.hh"
+#include "thunk/thunk.hh"
+#include "util/exception.hh"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gg;
+using namespace gg::thunk;
+
+void usage( const char * argv0 )
+{
+  cerr << "Usage: " << argv0 << " [INPUTS...]" << endl;
+}
+
+template<class Callable>
+nanoseconds time_ns( Callable && callable )
+{
+  const auto start = steady_clock::now();
+  callable();
+  return duration_cast<nanoseconds>( steady_clock::now() - start );
+}
+
+template<class Callable>
+double time_per_op( const size_t repeats, Callable && callable )
+{
+  const nanoseconds elapsed = time_ns(
+    [&] ()
+    {
+      for ( size_t i = 0; i < repeats; i++ ) {
+        callable();
+      }
+    } );
+
+  return elapsed.count() / 1000.0 / repeats;
+}
+
+void benchmark( const size_t inputs )
+{
+  const string function_hash = gg::hash::compute( "thunk-bench", ObjectType::Value );
+
+  vector<Thunk::DataItem> values;
+  vector<Thunk::DataItem> thunks;
+  vector<string> reduced;
+  vector<string> args { "link", "-o", "output" };
+
+  for ( size_t i = 0; i < inputs; i++ ) {
+    const string name = "input/" + to_string( i ) + ".o";
+
+    if ( i % 2 ) {
+      thunks.emplace_back( gg::hash::compute( name, ObjectType::Thunk ), name );
+      reduced.emplace_back( gg::hash::compute( name, ObjectType::Value ) );
+    }
+    else {
+      values.emplace_back( gg::hash::compute( name, ObjectType::Value ), name );
+    }
+  }
+
+  for ( const auto & item : values ) { args.push_back( data_placeholder( item.first ) ); }
+  for ( const auto & item : thunks ) { args.push_back( data_placeholder( item.first ) ); }
+
+  auto make_thunk =
+    [&] ()
+    {
+      vector<Thunk::DataItem> thunk_values { values };
+      vector<Thunk::DataItem> thunk_thunks { thunks };
+
+      return Thunk { { function_hash, args, {} },
+                     move( thunk_values ), move( thunk_thunks ),
+                     { { function_hash, "link" } }, { "output" } };
+    };
+
+  const size_t repeats = max<size_t>( 1, 200000 / max<size_t>( inputs, 1 ) );
+
+  const Thunk original = make_thunk();
+  const Thunk copy = make_thunk();
+  size_t sink = 0;
+
+  const double construct = time_per_op( repeats, [&] { sink += make_thunk().thunks().size(); } );
+  const double compare = time_per_op( repeats, [&] { sink += ( original == copy ); } );
+  const double protobuf = time_per_op( repeats, [&] { sink += original.to_protobuf().values_size(); } );
+
+  /* what execute() does to the args before exec'ing */
+  auto blob_path = []( const string & hash ) { return gg::paths::blob( hash ).string(); };
+  const double substitute = time_per_op( repeats, [&] { sink += original.function().substituted_args( blob_path ).size(); } );
+
+  /* every thunk input is reduced, one at a time */
+  nanoseconds update_total { 0 };
+
+  for ( size_t r = 0; r < repeats; r++ ) {
+    Thunk thunk { make_thunk() };
+
+    update_total += time_ns(
+      [&] ()
+      {
+        for ( size_t i = 0; i < thunks.size(); i++ ) {
+          thunk.update_data( thunks[ i ].first, { { reduced[ i ], "output" } } );
+        }
+      } );
+
+    if ( not thunk.can_be_executed() ) {
+      throw runtime_error( "update_data left thunk inputs behind" );
+    }
+
+    sink += thunk.values().size();
+  }
+
+  const double update = update_total.count() / 1000.0 / repeats;
+
+  /* what the graph does when one dependency is reduced: the thunk is updated
+     and hashed again, to be written out. The v1 hash covers the whole
+     serialized thunk; the v2 hash only the sections that changed. */
+  auto rehash =
+    [&] ( const uint8_t version )
+    {
+      const size_t updates = min<size_t>( thunks.size(), 100 );
+      Thunk thunk { make_thunk() };
+      thunk.set_version( version );
+      thunk.hash();
+
+      const nanoseconds elapsed = time_ns(
+        [&] ()
+        {
+          for ( size_t i = 0; i < updates; i++ ) {
+            thunk.update_data( thunks[ i ].first, { { reduced[ i ], "output" } } );
+            thunk.set_version( version );
+            sink += thunk.hash().length();
+          }
+        } );
+
+      return elapsed.count() / 1000.0 / max<size_t>( updates, 1 );
+    };
+
+  const double rehash_v1 = rehash( 1 );
+  const double rehash_v2 = rehash( 2 );
+
+  cout << setw( 8 ) << inputs << fixed << setprecision( 2 )
+       << setw( 14 ) << construct << setw( 14 ) << compare
+       << setw( 14 ) << protobuf << setw( 14 ) << update
+       << setw( 14 ) << substitute
+       << setw( 14 ) << rehash_v1 << setw( 14 ) << rehash_v2
+       << ( sink == 0 ? " " : "" ) << endl;
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    vector<size_t> sizes { 10, 1000, 100000 };
+
+    if ( argc > 1 ) {
+      sizes.clear();
+
+      for ( int i = 1; i < argc; i++ ) {
+        sizes.push_back( stoul( argv[ i ] ) );
+      }
+    }
+
+    cout << "  inputs  construct(us)   compare(us)  protobuf(us)    update(us)"
+            "  argsubst(us)  rehashv1(us)  rehashv2(us)" << endl;
+
+    for ( const size_t inputs : sizes ) {
+      benchmark( inputs );
+    }
+  }
+  catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -5,10 +5,14 @@
 #include <iostream>
 #include <chrono>
 #include <google/protobuf/text_format.h>
+#include <crypto++/filters.h>
+#include <crypto++/hex.h>
+#include <crypto++/sha.h>
 
 #include "thunk/thunk_reader.hh"
 #include "thunk/thunk_writer.hh"
 #include "thunk/thunk.hh"
+#include "thunk/ggutils.hh"
 #include "util/exception.hh"
 #include "util/temp_file.hh"
 
@@ -17,6 +21,19 @@ using namespace std::chrono;
 using namespace google::protobuf;
 using namespace gg::thunk;
 
+string sha256_hex( const string & contents )
+{
+  using namespace CryptoPP;
+
+  SHA256 hash_function;
+  string output;
+  StringSource s( contents, true,
+                  new HashFilter( hash_function,
+                  new HexEncoder(
+                  new StringSink( output ), false ) ) );
+  return output;
+}
+
 void usage( const char * argv0 )
 {
   cerr << argv0 << endl;
@@ -60,10 +77,77 @@ int main( int argc, char * argv[] )
     // Now reading it back
     Thunk thunk { move( ThunkReader::read( temp_file.name() ) ) };
 
-    if ( thunk == original_thunk ) {
-      return EXIT_SUCCESS;
+    if ( thunk != original_thunk or thunk.hash() != original_thunk.hash() ) {
+      return EXIT_FAILURE;
+    }
+
+    // The hash of the contents is the hash of the thunk
+    if ( gg::hash::compute( contents, gg::ObjectType::Thunk ) != thunk.hash() ) {
+      return EXIT_FAILURE;
+    }
+
+    // Version 1 thunks are still read, and keep their hashes
+    Thunk v1_thunk { original_thunk };
+    v1_thunk.set_version( 1 );
+    const string v1_contents = ThunkWriter::serialize( v1_thunk );
+    const Thunk v1_read = ThunkReader::parse( v1_contents );
+
+    if ( v1_read != original_thunk or v1_read.version() != 1 or
+         v1_read.hash() != gg::hash::compute( v1_contents, gg::ObjectType::Thunk ) or
+         v1_read.hash() == thunk.hash() ) {
+      return EXIT_FAILURE;
+    }
+
+    // Uploads are signed with the sha256 of what's uploaded, which for a
+    // version 2 thunk isn't the digest in its hash
+    if ( gg::hash::content_sha256( thunk.hash(), temp_file.name() ) != sha256_hex( contents ) or
+         gg::hash::to_hex( thunk.hash() ) == sha256_hex( contents ) ) {
+      return EXIT_FAILURE;
+    }
+
+    TempFile v1_file { "output" };
+    roost::atomic_create( v1_contents, v1_file.name() );
+
+    if ( gg::hash::content_sha256( v1_read.hash(), v1_file.name() ) != sha256_hex( v1_contents ) ) {
+      return EXIT_FAILURE;
+    }
+
+    // Unknown fields are skipped, and the links and the timeout survive
+    Thunk linked { original_thunk };
+    linked.add_link( "link1", "VOBJ1" );
+    const string unknown_field = { 15 << 3, 1 }; /* field 15, varint 1 */
+    const Thunk linked_read = ThunkReader::parse( ThunkWriter::serialize( linked ) + unknown_field );
+
+    if ( linked_read != linked or linked_read.links() != linked.links() or
+         linked_read.timeout() != 537ms ) {
+      return EXIT_FAILURE;
+    }
+
+    // A truncated thunk isn't read
+    try {
+      ThunkReader::parse( contents.substr( 0, contents.length() - 1 ) );
+      return EXIT_FAILURE;
+    }
+    catch ( const runtime_error & ) {}
+
+    // Updating a dependency rehashes only some of the sections, which must
+    // come out the same as hashing the whole thunk again
+    Thunk updated { { "FUNCTIONHASH", { "f", "@{GGHASH:TOBJ1}" }, {} },
+                    { { "VOBJ1", "A" }, { "TOBJ1", "B" }, { "TOBJ2", "C" } },
+                    { { "VOBJ4", "" } }, { "output" } };
+    updated.set_version( 1 );
+    updated.hash();
+
+    for ( const auto & update : { make_pair( "TOBJ1", "VOBJ7" ), make_pair( "TOBJ2", "TOBJ8" ) } ) {
+      updated.update_data( update.first, { { update.second, "output" } } );
+      const Thunk rehashed = ThunkReader::parse( ThunkWriter::serialize( updated ) );
+
+      if ( updated.version() != 2 or updated.hash() != rehashed.hash() ) {
+        return EXIT_FAILURE;
+      }
     }
-    else {
+
+    if ( updated.function().args().back() != data_placeholder( "VOBJ7" ) ) {
       return EXIT_FAILURE;
     }
 